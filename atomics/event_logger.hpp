@@ -0,0 +1,120 @@
+#ifndef EVENTLOGGER_HPP
+#define EVENTLOGGER_HPP
+
+/*
+Sink for the logging messages of subV (SubV_defs::logging_out) that writes them to a binary columnar
+event log (see utilities/event_log.hpp and event_log.py) instead of going through the text loggers.
+Never produces outputs or internal events. Checkpoints keep its clock and count, a restarted run logs to a new file.
+*/
+
+#include <cadmium/modeling/ports.hpp>
+#include <cadmium/modeling/message_bag.hpp>
+
+#include <limits>
+#include <assert.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "../test/tags.hpp"  // debug tags
+#include "../utilities/checkpoint.hpp"  // checkpoint and restart
+#include "../utilities/checkpoint_clock.hpp"
+#include "../utilities/event_log.hpp"
+
+#include "../data_structures/message.hpp"
+
+using namespace cadmium;
+using namespace std;
+
+// Port definition
+struct EventLogger_defs {
+    struct logging_in : public in_port<logging_message_t> {};
+};
+
+template<typename TIME> class EventLogger {
+    public:
+        // ports definition
+        using input_ports = tuple<typename EventLogger_defs::logging_in>;
+        using output_ports = tuple<>;
+
+        struct state_type {
+            TIME current_time;
+            uint32_t next_event;  // index of the next bag received
+            resume_t<TIME> resume;  // time of the last transition (for checkpoints), and the restored times until the first transition
+        };
+        state_type state;
+
+        EventLogger () {
+            if (DEBUG_EL) cout << "EventLogger default constructor called" << endl;
+        }
+
+        // an index interval of 0 writes no index or keyframes, the particle index is written when the log is closed
+        EventLogger (string log_path, int dim, float index_interval, bool particle_index) {
+            if (DEBUG_EL) cout << "EventLogger constructor received path: " << log_path << ", index interval: " << index_interval << endl;
+            log = make_shared<EventLogWriter>(log_path, dim, 4096, index_interval, particle_index);
+            this->dim = dim;
+            state.current_time = TIME();
+            state.next_event = 0;
+        }
+
+        // internal transition
+        void internal_transition () {
+            assert(false && "event logger has no internal events");
+        }
+
+        // external transition
+        void external_transition (TIME e, typename make_message_bags<input_ports>::type mbs) {
+            if (state.resume.active) e = state.resume.elapsed();
+            state.resume.transition();
+            state.current_time += e;
+            const vector<logging_message_t>& messages = get_messages<typename EventLogger_defs::logging_in>(mbs);
+            if (DEBUG_EL) cout << "event logger writing " << messages.size() << " message(s) at " << state.current_time << endl;
+            for (const logging_message_t& x : messages) {
+                assert((int)x.position.size() == dim && (int)x.velocity.size() == dim && "event logger: message does not match the dimensions of the log");
+                log->write(state.current_time, state.next_event, x.particle_id, x.subV_id, (uint8_t)x.purpose, x.position.begin(), x.velocity.begin());
+            }
+            ++state.next_event;
+        }
+
+        // confluence transition
+        void confluence_transition (TIME e, typename make_message_bags<input_ports>::type mbs) {
+            external_transition(e, move(mbs));
+        }
+
+        // output function
+        typename make_message_bags<output_ports>::type output () const {
+            typename make_message_bags<output_ports>::type bags;
+            return bags;
+        }
+
+        // time advance function
+        TIME time_advance () const {
+            return numeric_limits<TIME>::infinity();
+        }
+
+        void save_checkpoint (CheckpointWriter& out) const {
+            out.put(state.current_time);
+            out.put(state.next_event);
+        }
+
+        void restore_checkpoint (CheckpointReader& in) {
+            in.get(state.current_time);
+            in.get(state.next_event);
+        }
+
+        // finish the log once the run is over (throws runtime_error if it could not be written)
+        void close () {
+            log->close();
+        }
+
+        friend ostringstream& operator<<(ostringstream& os, const typename EventLogger<TIME>::state_type& i) {
+            os << "events logged: " << i.next_event;
+            return os;
+        }
+
+    private:
+        shared_ptr<EventLogWriter> log;  // closed by close(), or when the last copy of the model is destroyed
+        int dim;
+};
+
+#endif
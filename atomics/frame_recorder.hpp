@@ -0,0 +1,118 @@
+#ifndef FRAMERECORDER_HPP
+#define FRAMERECORDER_HPP
+
+/*
+Writes the positions of every particle at regular times (0, interval, 2 * interval, ...) to a frame log
+(see utilities/frame_log.hpp and frame_log.py). Positions are extrapolated from the kinematic state subV
+keeps in the particle store, so the recorder needs no couplings and never produces outputs.
+*/
+
+#include <cadmium/modeling/ports.hpp>
+#include <cadmium/modeling/message_bag.hpp>
+
+#include <limits>
+#include <assert.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+
+#include "../test/tags.hpp"  // debug tags
+#include "../utilities/frame_log.hpp"
+#include "../utilities/checkpoint.hpp"  // checkpoint and restart
+#include "../utilities/checkpoint_clock.hpp"
+
+#include "../data_structures/particle_store.hpp"
+
+using namespace cadmium;
+using namespace std;
+
+template<typename TIME> class FrameRecorder {
+    public:
+        // ports definition
+        using input_ports = tuple<>;
+        using output_ports = tuple<>;
+
+        struct state_type {
+            TIME current_time;
+            uint64_t next_frame;  // index of the next frame written
+            resume_t<TIME> resume;  // time of the last transition (for checkpoints), and the restored times until the first transition
+        };
+        state_type state;
+
+        FrameRecorder () {
+            if (DEBUG_FR) cout << "FrameRecorder default constructor called" << endl;
+        }
+
+        FrameRecorder (shared_ptr<ParticleStore> store, TIME interval, string log_path) {
+            if (DEBUG_FR) cout << "FrameRecorder constructor received interval: " << interval << ", path: " << log_path << endl;
+            assert(interval > 0 && "frame recorder: interval must be positive");
+            particle_store = store;
+            this->interval = interval;
+            log = make_shared<FrameLogWriter>(log_path, store->ids(), store->dimensions());
+            positions.resize(store->size() * store->dimensions());
+            state.current_time = TIME();
+            state.next_frame = 0;
+        }
+
+        // internal transition
+        void internal_transition () {
+            state.resume.transition();
+            state.current_time = frame_time(state.next_frame);
+            if (DEBUG_FR) cout << "frame recorder writing frame " << state.next_frame << " at " << state.current_time << endl;
+            particle_store->positions_at(state.current_time, positions.data());
+            log->write(state.current_time, positions.data());
+            ++state.next_frame;
+        }
+
+        // external transition
+        void external_transition ([[maybe_unused]] TIME e, [[maybe_unused]] typename make_message_bags<input_ports>::type mbs) {
+            assert(false && "frame recorder has no inputs");
+        }
+
+        // confluence transition
+        void confluence_transition ([[maybe_unused]] TIME e, [[maybe_unused]] typename make_message_bags<input_ports>::type mbs) {
+            internal_transition();
+        }
+
+        // output function
+        typename make_message_bags<output_ports>::type output () const {
+            typename make_message_bags<output_ports>::type bags;
+            return bags;
+        }
+
+        // time advance function
+        TIME time_advance () const {
+            if (state.resume.active) return state.resume.advance();
+            // frame times are multiples of the interval so that rounding errors do not accumulate
+            return frame_time(state.next_frame) - state.current_time;
+        }
+
+        friend ostringstream& operator<<(ostringstream& os, const typename FrameRecorder<TIME>::state_type& i) {
+            os << "frames written: " << i.next_frame;
+            return os;
+        }
+
+        // frames after the checkpoint go to the log of the restored run
+        void save_checkpoint (CheckpointWriter& out) const {
+            out.put(state.current_time);
+            out.put(state.next_frame);
+        }
+
+        void restore_checkpoint (CheckpointReader& in) {
+            in.get(state.current_time);
+            in.get(state.next_frame);
+        }
+
+    private:
+        shared_ptr<ParticleStore> particle_store;
+        shared_ptr<FrameLogWriter> log;  // closed when the last copy of the model is destroyed
+        TIME interval;
+        vector<float> positions;  // frame buffer
+
+        TIME frame_time (uint64_t frame) const {
+            return TIME(frame * interval);
+        }
+};
+
+#endif
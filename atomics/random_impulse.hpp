@@ -17,27 +17,50 @@ TODO:
 #include <random>
 #include <math.h>
 #include <map>
-#include <nlohmann/json.hpp>
 #include <utility>  // contains pair
 #include <queue>  // contains priority queue
+#include <array>
+#include <algorithm>  // make_heap
+#include <unordered_map>
+#include <unordered_set>
+#include <type_traits>  // is_same
+#include <memory>
 
 #include "../test/tags.hpp"  // debug tags
 #include "../utilities/vector_utils.hpp"  // vector functions
+#include "../utilities/philox.hpp"  // counter-based random streams
+#include "../utilities/impulse_tape.hpp"  // recording of sent impulses
+#include "../utilities/checkpoint.hpp"  // checkpoint and restart
+#include "../utilities/checkpoint_clock.hpp"
 
 #include "../data_structures/message.hpp"
+#include "../data_structures/calendar_queue.hpp"
+#include "../data_structures/particle_store.hpp"
 //#include "../data_structures/species.hpp"  // TODO: Get this data from a JSON
 
 using namespace cadmium;
 using namespace std;
 
-using json = nlohmann::json;
-
 // Port definition
 struct RandomImpulse_defs {
     struct impulse_out : public out_port<message_t> {};
 };
 
-template<typename TIME> class RandomImpulse {
+// comparator for int, TIME pair
+// events with the same time come out in order of id, as from the calendar queue (ties are common with float
+// times and the order they are popped in changes the rest of the run)
+template<typename TIME>
+struct ComparePair {
+    bool operator() (pair<int, TIME> const& p1, pair<int, TIME> const& p2) const {
+        return p2.second < p1.second || (p2.second == p1.second && p2.first < p1.first);
+    }
+};
+
+// queues of the next impulse time of every particle
+template<typename TIME> using ri_heap_t = priority_queue<pair<int, TIME>, vector<pair<int, TIME>>, ComparePair<TIME>>;  // binary heap
+template<typename TIME> using ri_calendar_t = CalendarQueue<int, TIME>;  // calendar queue (amortized O(1) with many particles)
+
+template<typename TIME, typename QUEUE = ri_heap_t<TIME>> class RandomImpulse {
     public:
         // temporary assignments
         // TODO: get from particle information (species)
@@ -49,21 +72,41 @@ template<typename TIME> class RandomImpulse {
         using input_ports = tuple<>;
         using output_ports = tuple<typename RandomImpulse_defs::impulse_out>;
 
-        // comparator for int, TIME pair
-        struct ComparePair {
-            bool operator() (pair<int, TIME> const& p1, pair<int, TIME> const& p2) {
-                return p2.second < p1.second;
-            }
+        // queue of the next impulse time of every particle (ri_heap_t or ri_calendar_t)
+        using particle_queue_t = QUEUE;
+
+        // impulses are generated this many at a time for each particle (a batched scalar refill: the gamma,
+        // uniform and trig calls are still made one value at a time, the batch only amortizes the setup per particle)
+        static constexpr int batch_size = 8;
+
+        // distributions shared by every particle of a species (indexed like the species table of the particle store)
+        // particles draw from their own streams, so sharing the distributions does not couple them
+        struct ri_species_t {
+            exponential_distribution<float> interval;  // time between impulses
+            gamma_distribution<float> magnitude;  // momentum magnitude of an impulse
+            ri_species_t (float tau, float mean, float shape) : interval(tau), magnitude(mean, shape) {}
+        };
+
+        // random streams and pre-generated impulses of one particle
+        struct ri_particle_t {
+            int species;  // index in state.species (and in the species table)
+            PhiloxStream time_stream;
+            PhiloxStream impulse_stream;
+            vector<float> impulses;  // batch of pre-generated impulses (batch_size * dim)
+            int next_impulse;  // index of the next unused impulse in the batch
         };
 
         struct state_type {
-            json particle_data;
+            shared_ptr<ParticleStore> particle_store;  // shared with the other models (only species parameters are read)
             int dim;  // specifies the number of dimensions
             bool do_ri;  // whether or not to generate random impulses
             TIME next_internal;
             message_t impulse;
-            priority_queue<pair<int, TIME>, vector<pair<int, TIME>>, ComparePair> particle_times;
+            particle_queue_t particle_times;
             TIME current_time;
+            vector<ri_species_t> species;
+            unordered_map<int, ri_particle_t> particles;  // formatted: {pID, streams}
+            resume_t<TIME> resume;  // time of the last transition (for checkpoints), and the restored times until the first transition
         };
         state_type state;
 
@@ -76,24 +119,48 @@ template<typename TIME> class RandomImpulse {
             if (DEBUG_RI) cout << "RandomImpulse non-default constructor called with value: " << test << endl;
         }
 
-        RandomImpulse (json j, int dim, bool do_ri) {
-            if (DEBUG_RI) cout << "RandomImpulse constructor received JSON and dim: " << j << " --- " << dim << endl;
-            state.particle_data = j;
-            state.dim = dim;
+        // impulses every particle of the store
+        RandomImpulse (shared_ptr<ParticleStore> store, bool do_ri) : RandomImpulse(store, store->ids(), do_ri, default_random_engine::default_seed) {}
+
+        RandomImpulse (shared_ptr<ParticleStore> store, vector<int> p_ids, bool do_ri, unsigned int seed) : RandomImpulse(store, p_ids, do_ri, seed, "") {}
+
+        // every particle draws from its own streams (keyed by the seed and its ID), so the impulses it receives
+        // do not depend on the other particles or on how particles are split between several RI models (shards)
+        // p_ids are the particles impulsed by this model, if tape_path is not empty every impulse sent is recorded there (replay with RandomImpulseReplay)
+        RandomImpulse (shared_ptr<ParticleStore> store, vector<int> p_ids, bool do_ri, unsigned int seed, string tape_path) {
+            if (DEBUG_RI) cout << "RandomImpulse constructor received particles: " << VectorUtils::get_string<int>(p_ids) << endl;
+            state.particle_store = store;
+            state.dim = store->dimensions();
+            if (tape_path.size() > 0) {
+                tape = make_shared<ImpulseTapeWriter>(tape_path, state.dim);
+            }
             state.do_ri = do_ri;
-            state.impulse.purpose = "ri";
+            state.impulse.purpose = purpose_t::ri;
             state.next_internal = TIME();
             state.current_time = TIME();
 
+            // cache the random streams and distributions of every particle
+            for (const species_t& species : store->species_table()) {
+                state.species.push_back(ri_species_t(species.tau, species.mean, species.shape));
+            }
+            for (int p_id : p_ids) {
+                ri_particle_t& particle = state.particles[p_id];
+                particle.species = store->species_of(p_id);
+                particle.time_stream = PhiloxStream(seed, p_id, 0);
+                particle.impulse_stream = PhiloxStream(seed, p_id, 1);
+                particle.next_impulse = batch_size;  // generate the first batch when it is needed
+            }
+
             // go through particles and get the times at which they should receive RIs
-            for (auto it = state.particle_data.begin(); it != state.particle_data.end(); ++it) {
-                state.particle_times.push(pair<int, TIME>(stoi(it.key()), generate_next_time(state.particle_data[it.key()]["tau"])));
+            for (int p_id : p_ids) {
+                state.particle_times.push(pair<int, TIME>(p_id, generate_next_time(p_id)));
             }
         }
 
         // internal transition
         void internal_transition () {
             if (DEBUG_RI) cout << "ri internal transition called" << endl;
+            state.resume.transition();
             state.current_time += state.next_internal;
             if (DEBUG_RI) cout << "ri internal transition: current_time set: " << state.current_time << endl;
 
@@ -103,74 +170,28 @@ template<typename TIME> class RandomImpulse {
                 return;
             }
 
-            state.particle_times.pop();  // remove current particle from queue
-
-            int currId = state.particle_times.top().first;  // note the current particle's ID
-            state.next_internal = state.particle_times.top().second - state.current_time;  // note the current particle's impulse time
-            if (DEBUG_RI) cout << "ri internal transition: next_internal set: " << state.particle_times.top().second << " - " << state.current_time << " = " << state.next_internal << endl;
-
-            json currParticle = state.particle_data[to_string(state.particle_times.top().first)];
-
-            state.particle_times.push(pair<int, TIME>(currId, generate_next_time(state.particle_data[to_string(currId)]["tau"]) + state.current_time));  // add current particle back with new time
-
-            vector<float> next_impulse;
-            float momentum_magnitude;
-            float factor;
-            vector<float> direction;
-            float z_component;
-            float xy_factor;
-
-            gamma_distribution<float> gamma_dist(currParticle["mean"], currParticle["shape"]);  // mean, shape
-            momentum_magnitude = gamma_dist(generator);
-
-            // TODO: attempt to correct the below inefficiencies (possibly move them to the state)
-            // These are created/destroyed every time the internal transition is called
-            uniform_real_distribution<float> uniform_dist_neg1_1(-1, 1);
-            uniform_real_distribution<float> uniform_dist_0_1(0, 1);
-            uniform_real_distribution<float> uniform_dist_0_2(0, 2);
-            uniform_real_distribution<float> uniform_dist_0_2pi(0, 2 * pi);
-            switch (state.dim) {
-                case 1:
-                    factor = 1;
-                    direction.push_back(2 * (int)uniform_dist_0_2(generator) - 1);
-                    break;
-                case 2:
-                    factor = sqrt(pow(1 - uniform_dist_0_1(generator), 2));
-                    direction.push_back(cos(uniform_dist_0_2pi(generator)));
-                    direction.push_back(sin(uniform_dist_0_2pi(generator)));
-                    break;
-                case 3:
-                    factor = sqrt(uniform_dist_0_1(generator));
-                    z_component = uniform_dist_neg1_1(generator);
-                    xy_factor = sqrt(1 - pow(z_component, 2));
-                    direction.push_back(xy_factor * cos(uniform_dist_0_2pi(generator)));
-                    direction.push_back(xy_factor * sin(uniform_dist_0_2pi(generator)));
-                    direction.push_back(z_component);
-                    break;
-                default:
-                    assert(false && "random_impulse: unsupported number of dimensions");
-                    break;
-            }
-
-            for (auto i : direction) {
-                next_impulse.push_back(i * momentum_magnitude * factor);
+            // the impulse prepared by the previous call has just been sent, schedule that particle's next impulse
+            // (nothing has been sent on the first call, every particle is still queued with its initial time)
+            if (state.impulse.particle_ids.size() != 0) {
+                int sentId = state.particle_times.top().first;
+                if (tape != nullptr) tape->write(state.particle_times.top().second, sentId, state.impulse.data);
+                state.particle_times.pop();
+                state.particle_times.push(pair<int, TIME>(sentId, generate_next_time(sentId) + state.current_time));
             }
 
-            // finish the impulse message
-            state.impulse.data = next_impulse;
-            state.impulse.particle_ids = {currId};
+            prepare_impulse();
             if (DEBUG_RI) cout << "ri internal transition finishing" << endl;
         }
 
         // external transition
         // receives messages regarding changes to particle mass
-        void external_transition (TIME e, typename make_message_bags<input_ports>::type mbs) {
+        void external_transition ([[maybe_unused]] TIME e, [[maybe_unused]] typename make_message_bags<input_ports>::type mbs) {
             assert(false && "RI module must not receive inputs");
         }
 
         // confluence transition
         // should never happen
-        void confluence_transition (TIME e, typename make_message_bags<input_ports>::type mbs) {
+        void confluence_transition ([[maybe_unused]] TIME e, [[maybe_unused]] typename make_message_bags<input_ports>::type mbs) {
             if (DEBUG_RI) cout << "ri confluence transition called" << endl;
             internal_transition();
             if (DEBUG_RI) cout << "ri confluence transition finishing" << endl;
@@ -196,24 +217,238 @@ template<typename TIME> class RandomImpulse {
         // time advance function
         TIME time_advance () const {
             if (DEBUG_RI) cout << "ri time advance called/returning" << endl;
+            if (state.resume.active) return state.resume.advance();
             return state.next_internal < 0 ? 0 : state.next_internal;
         }
 
-        friend ostringstream& operator<<(ostringstream& os, const typename RandomImpulse<TIME>::state_type& i) {
+        friend ostringstream& operator<<(ostringstream& os, const typename RandomImpulse<TIME, QUEUE>::state_type& i) {
             if (DEBUG_RI) cout << "ri << called" << endl;
-            os << "impulse [(p_id:" << VectorUtils::get_string<int>(i.impulse.particle_ids) << "): imp" << VectorUtils::get_string<float>(i.impulse.data, true) << "]";
+            TextBuffer& text = TextBuffer::local();
+            size_t start = text.size();
+            text << "impulse [(p_id:";
+            text.append_values(i.impulse.particle_ids.begin(), i.impulse.particle_ids.end(), false);
+            text << "): imp";
+            text.append_values(i.impulse.data.begin(), i.impulse.data.end(), true);
+            text << "]";
+            text.flush_to(os, start);
             if (DEBUG_RI) cout << "ri << returning" << endl;
             return os;
         }
 
+        // the species distributions are rebuilt from the config (and reset before every use), so they are not saved
+        void save_checkpoint (CheckpointWriter& out) const {
+            out.put(state.next_internal);
+            out.put(state.current_time);
+            out.put(state.impulse);
+            out.put(queued_times());
+            out.put(uint64_t(state.particles.size()));
+            for (const auto& particle : state.particles) {
+                out.put(particle.first);
+                out.put(particle.second.time_stream);
+                out.put(particle.second.impulse_stream);
+                out.put(particle.second.impulses);
+                out.put(particle.second.next_impulse);
+            }
+        }
+
+        void restore_checkpoint (CheckpointReader& in) {
+            in.get(state.next_internal);
+            in.get(state.current_time);
+            in.get(state.impulse);
+            vector<pair<int, TIME>> times;
+            in.get(times);
+            restore_queued_times(times);
+            uint64_t count;
+            in.get(count);
+            if (count != state.particles.size()) throw runtime_error("RandomImpulse: the checkpoint impulses other particles than the config");
+            for (uint64_t i = 0; i < count; ++i) {
+                int p_id;
+                in.get(p_id);
+                auto it = state.particles.find(p_id);
+                if (it == state.particles.end()) throw runtime_error("RandomImpulse: the checkpoint impulses other particles than the config");
+                in.get(it->second.time_stream);
+                in.get(it->second.impulse_stream);
+                in.get(it->second.impulses);
+                in.get(it->second.next_impulse);
+            }
+        }
+
+        // particles handed to or taken from the RI model of another domain between two steps (see test/main_domain_test.cpp)
+        // a particle keeps its streams, its batch of impulses and the time of its next impulse, so it receives the same
+        // impulses whichever model sends them
+        struct ri_migrant_t {
+            ri_particle_t particle;
+            TIME next_time;  // time of its next impulse
+        };
+
+        // the queue is rebuilt without the particles (once for all of them)
+        unordered_map<int, ri_migrant_t> remove_particles (const unordered_set<int>& p_ids) {
+            unprepare_impulse();
+            unordered_map<int, ri_migrant_t> result;
+            vector<pair<int, TIME>> kept;
+            for (const pair<int, TIME>& time : queued_times()) {
+                auto it = state.particles.find(time.first);
+                if (p_ids.count(time.first) == 0) {
+                    kept.push_back(time);
+                    continue;
+                }
+                result[time.first] = {move(it->second), time.second};
+                state.particles.erase(it);
+            }
+            if constexpr (is_same<particle_queue_t, ri_heap_t<TIME>>::value) {
+                make_heap(kept.begin(), kept.end(), ComparePair<TIME>());
+            }
+            restore_queued_times(kept);
+            if (state.do_ri) prepare_impulse();
+            state.resume.reschedule();
+            return result;
+        }
+
+        void add_particle (int p_id, const ri_migrant_t& migrant) {
+            state.dim = state.particle_store->dimensions();  // a store made without particles takes the dimensions of the first one inserted
+            unprepare_impulse();
+            state.particles[p_id] = migrant.particle;
+            state.particle_times.push(pair<int, TIME>(p_id, migrant.next_time));
+            if (state.do_ri) prepare_impulse();
+            state.resume.reschedule();
+        }
+
     private:
-        default_random_engine generator;  // used to generate numbers from gamma distribution
         const float pi = 3.14159265359;
+        shared_ptr<ImpulseTapeWriter> tape;  // NULL unless recording
+
+        // gives access to the heap of a priority_queue (only instantiated for ri_heap_t)
+        struct heap_access : particle_queue_t {
+            template <typename HEAP>
+            static vector<pair<int, TIME>>& of (HEAP& queue) {
+                return queue.*(&heap_access::c);
+            }
+        };
+
+        // the queued impulse times, in an order from which restore_queued_times rebuilds the same queue
+        // (the heap is saved as laid out, its order decides which of two particles with the same time goes first)
+        vector<pair<int, TIME>> queued_times () const {
+            particle_queue_t queue = state.particle_times;
+            if constexpr (is_same<particle_queue_t, ri_heap_t<TIME>>::value) {
+                return heap_access::of(queue);
+            }
+            else {
+                vector<pair<int, TIME>> times;
+                for (; !queue.empty(); queue.pop()) times.push_back(queue.top());
+                return times;
+            }
+        }
+
+        void restore_queued_times (const vector<pair<int, TIME>>& times) {
+            if constexpr (is_same<particle_queue_t, ri_heap_t<TIME>>::value) {
+                heap_access::of(state.particle_times) = times;
+            }
+            else {
+                state.particle_times = particle_queue_t();
+                for (const pair<int, TIME>& time : times) state.particle_times.push(time);
+            }
+        }
+
+        // take the next impulse of the particle at the top of the queue, it is sent at the next internal transition
+        void prepare_impulse () {
+            // a shard may own no particles
+            if (state.particle_times.empty()) {
+                state.next_internal = numeric_limits<TIME>::infinity();
+                state.impulse.particle_ids = {};
+                if (DEBUG_RI) cout << "ri prepare_impulse: no particles to impulse" << endl;
+                return;
+            }
+
+            int currId = state.particle_times.top().first;  // note the current particle's ID
+            state.next_internal = state.particle_times.top().second - state.current_time;  // note the current particle's impulse time
+            if (DEBUG_RI) cout << "ri prepare_impulse: next_internal set: " << state.particle_times.top().second << " - " << state.current_time << " = " << state.next_internal << endl;
+
+            ri_particle_t& particle = state.particles[currId];
+            if (particle.next_impulse == batch_size) {
+                generate_impulses(particle);
+            }
+            const float* next_impulse = &particle.impulses[particle.next_impulse * state.dim];
+            ++particle.next_impulse;
+
+            // finish the impulse message
+            state.impulse.data.assign(next_impulse, next_impulse + state.dim);
+            state.impulse.particle_ids = {currId};
+        }
 
-        float generate_next_time (float tau) {
-            exponential_distribution<float> exponential_dist(tau);
-            return exponential_dist(generator);
+        // give the prepared impulse back to its particle (the top of the queue may change before it is sent)
+        void unprepare_impulse () {
+            if (state.impulse.particle_ids.size() == 0) return;
+            --state.particles[state.impulse.particle_ids[0]].next_impulse;
+            state.impulse.particle_ids = {};
+        }
+
+        float generate_next_time (int p_id) {
+            ri_particle_t& particle = state.particles[p_id];
+            return state.species[particle.species].interval(particle.time_stream);
+        }
+
+        // fill a particle's batch of impulses
+        // all magnitudes are drawn first, then the uniform numbers for the directions (recorded tapes and checkpoints rely on this order)
+        void generate_impulses (ri_particle_t& particle) {
+            gamma_distribution<float>& magnitude_dist = state.species[particle.species].magnitude;
+            float magnitude[batch_size];
+            for (int i = 0; i < batch_size; ++i) {
+                magnitude_dist.reset();  // drop values cached from another particle's stream
+                magnitude[i] = magnitude_dist(particle.impulse_stream);
+            }
+
+            float uniform[3][batch_size];
+            for (int k = 0; k < state.dim; ++k) {
+                for (int i = 0; i < batch_size; ++i) {
+                    uniform[k][i] = particle.impulse_stream.uniform();
+                }
+            }
+
+            // scale * direction components (direction is a unit vector)
+            float scale[batch_size];
+            float direction[3][batch_size];
+            switch (state.dim) {
+                case 1:
+                    for (int i = 0; i < batch_size; ++i) {
+                        scale[i] = magnitude[i];
+                        direction[0][i] = (uniform[0][i] < 0.5f) ? -1.0f : 1.0f;
+                    }
+                    break;
+                case 2:
+                    for (int i = 0; i < batch_size; ++i) {
+                        float angle = 2 * pi * uniform[1][i];
+                        scale[i] = magnitude[i] * (1 - uniform[0][i]);
+                        direction[0][i] = cos(angle);
+                        direction[1][i] = sin(angle);
+                    }
+                    break;
+                case 3:
+                    for (int i = 0; i < batch_size; ++i) {
+                        float z_component = 2 * uniform[1][i] - 1;
+                        float xy_factor = sqrt(1 - z_component * z_component);
+                        float angle = 2 * pi * uniform[2][i];
+                        scale[i] = magnitude[i] * sqrt(uniform[0][i]);
+                        direction[0][i] = xy_factor * cos(angle);
+                        direction[1][i] = xy_factor * sin(angle);
+                        direction[2][i] = z_component;
+                    }
+                    break;
+                default:
+                    assert(false && "random_impulse: unsupported number of dimensions");
+                    break;
+            }
+
+            particle.impulses.resize(batch_size * state.dim);
+            for (int i = 0; i < batch_size; ++i) {
+                for (int k = 0; k < state.dim; ++k) {
+                    particle.impulses[i * state.dim + k] = direction[k][i] * scale[i];
+                }
+            }
+            particle.next_impulse = 0;
         }
 };
 
+// RandomImpulse scheduling its impulses with a calendar queue (config key ri_queue)
+template<typename TIME> using CalendarRandomImpulse = RandomImpulse<TIME, ri_calendar_t<TIME>>;
+
 #endif
\ No newline at end of file
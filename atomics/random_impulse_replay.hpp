@@ -0,0 +1,128 @@
+#ifndef RANDOMIMPULSEREPLAY_HPP
+#define RANDOMIMPULSEREPLAY_HPP
+
+/*
+Sends the impulses recorded on a tape (see RandomImpulse and utilities/impulse_tape.hpp) at the times
+they were recorded, one impulse per transition like RandomImpulse. Uses the same output port as
+RandomImpulse so it can be coupled in its place.
+*/
+
+#include <cadmium/modeling/ports.hpp>
+#include <cadmium/modeling/message_bag.hpp>
+
+#include <limits>
+#include <assert.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "../test/tags.hpp"  // debug tags
+#include "../utilities/vector_utils.hpp"  // vector functions
+#include "../utilities/impulse_tape.hpp"
+#include "../utilities/checkpoint.hpp"  // checkpoint and restart
+#include "../utilities/checkpoint_clock.hpp"
+
+#include "../data_structures/message.hpp"
+#include "random_impulse.hpp"  // port definition
+
+using namespace cadmium;
+using namespace std;
+
+template<typename TIME> class RandomImpulseReplay {
+    public:
+        // ports definition
+        using input_ports = tuple<>;
+        using output_ports = tuple<typename RandomImpulse_defs::impulse_out>;
+
+        struct state_type {
+            TIME next_internal;
+            TIME current_time;
+            size_t next_record;  // record sent by the next output
+            resume_t<TIME> resume;  // time of the last transition (for checkpoints), and the restored times until the first transition
+        };
+        state_type state;
+
+        RandomImpulseReplay () {
+            if (DEBUG_RI) cout << "RandomImpulseReplay default constructor called" << endl;
+        }
+
+        RandomImpulseReplay (string tape_path) {
+            if (DEBUG_RI) cout << "RandomImpulseReplay constructor received tape: " << tape_path << endl;
+            tape = make_shared<ImpulseTapeReader>(tape_path);
+            state.current_time = TIME();
+            state.next_record = 0;
+            schedule_record();
+        }
+
+        // internal transition
+        void internal_transition () {
+            if (DEBUG_RI) cout << "ri replay internal transition called" << endl;
+            state.resume.transition();
+            state.current_time += state.next_internal;
+            ++state.next_record;
+            schedule_record();
+        }
+
+        // external transition
+        void external_transition ([[maybe_unused]] TIME e, [[maybe_unused]] typename make_message_bags<input_ports>::type mbs) {
+            assert(false && "RI replay module must not receive inputs");
+        }
+
+        // confluence transition
+        // should never happen
+        void confluence_transition ([[maybe_unused]] TIME e, [[maybe_unused]] typename make_message_bags<input_ports>::type mbs) {
+            internal_transition();
+        }
+
+        // output function
+        typename make_message_bags<output_ports>::type output () const {
+            if (DEBUG_RI) cout << "ri replay output called" << endl;
+            typename make_message_bags<output_ports>::type bags;
+            vector<message_t> bag_port_out;
+            if (state.next_record < tape->size()) {
+                bag_port_out.push_back(message_t(tape->impulse(state.next_record), {tape->particle_id(state.next_record)}, purpose_t::ri));
+            }
+            get_messages<typename RandomImpulse_defs::impulse_out>(bags) = bag_port_out;
+            return bags;
+        }
+
+        // time advance function
+        TIME time_advance () const {
+            if (state.resume.active) return state.resume.advance();
+            return state.next_internal < 0 ? 0 : state.next_internal;
+        }
+
+        friend ostringstream& operator<<(ostringstream& os, const typename RandomImpulseReplay<TIME>::state_type& i) {
+            os << "tape record " << i.next_record;
+            return os;
+        }
+
+        // the tape itself is read again from the config
+        void save_checkpoint (CheckpointWriter& out) const {
+            out.put(state.next_internal);
+            out.put(state.current_time);
+            out.put(uint64_t(state.next_record));
+        }
+
+        void restore_checkpoint (CheckpointReader& in) {
+            uint64_t next_record;
+            in.get(state.next_internal);
+            in.get(state.current_time);
+            in.get(next_record);
+            state.next_record = next_record;
+        }
+
+    private:
+        shared_ptr<ImpulseTapeReader> tape;
+
+        // the tape holds the time each impulse was scheduled for, so the time advances are the same as in the recorded run
+        void schedule_record () {
+            if (state.next_record >= tape->size()) {
+                state.next_internal = numeric_limits<TIME>::infinity();
+                return;
+            }
+            state.next_internal = TIME(tape->time(state.next_record)) - state.current_time;
+        }
+};
+
+#endif
@@ -24,20 +24,24 @@ Notes:
 #include <random>
 #include <math.h>
 #include <map>
-#include <nlohmann/json.hpp>
-#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
 
 #include "../test/tags.hpp"  // debug tags
 #include "../utilities/vector_utils.hpp"  // vector functions
+#include "../utilities/checkpoint.hpp"  // checkpoint and restart
+#include "../utilities/checkpoint_clock.hpp"
 
 #include "../data_structures/message.hpp"
 #include "../data_structures/node.hpp"
+#include "../data_structures/node_pool.hpp"
+#include "../data_structures/indexed_heap.hpp"
+#include "../data_structures/particle_store.hpp"
 
 using namespace cadmium;
 using namespace std;
 
-using json = nlohmann::json;
-
 // Port definition
 struct Responder_defs {
     //struct transition_in : public in_port<___> {};
@@ -51,7 +55,7 @@ struct Responder_defs {
     struct response_out : public out_port<message_t> {};
 };
 
-// comparator for sorting node pointers
+// comparator for ordering node pointers in the restitution queue
 // sort by time first (this is what we really want)
 // to prevent nodes with the same time being considered duplicates, sort by the first collider then the second collider as well
 struct NodePtrComp {
@@ -70,6 +74,19 @@ struct NodePtrComp {
     }
 };
 
+// loaded cluster owned by the responder
+// a shard is created when isolated particles are loaded, merges with another shard when a collision joins their clusters
+// and splits when restitution separates them, so the work done for an event only touches the shards involved
+// (shards only bound the work of an event: the events of a transition are still resolved one after another, in order)
+// mass, members and velocity are maintained incrementally (every member of a loaded cluster shares one velocity)
+struct responder_shard_t {
+    vector<int> members;  // particles of the cluster
+    float mass;  // total mass of the cluster
+    vector<float> velocity;  // velocity shared by every member
+    Node* root;  // root of the cluster's loading order tree (NULL only while the cluster is being merged or split)
+    responder_shard_t () : mass(0), root(NULL) {}
+};
+
 template<typename TIME> class Responder {
     public:
         // temporary assignments
@@ -92,26 +109,30 @@ template<typename TIME> class Responder {
         using output_ports = tuple<typename Responder_defs::response_out>;
 
         struct state_type {
-            // particle mass, position, velocity
-            //map
-            json particle_data;
+            // particle mass and velocity (the responder owns the response velocity column of the store)
+            shared_ptr<ParticleStore> particle_store;
             TIME next_internal;
-            vector<message_t> collision_messages;
-            vector<message_t> ri_messages;
+            vector<message_t> collision_messages;  // velocities to send (from restitution, loading and impulses)
             TIME current_time;
             //bool received_collision;  // whether or not the last event was a collision being received
-            bool sending_ri;
             Node* buffer;  // storage for the node being restituted (will be released in the int that follows restitution velocities being sent)
 
-            // ID_loaded
-            // this is a property of each particle in the thesis
-            unordered_map<int, unordered_set<int>> id_loaded;  // formatted: {pID, {directly loaded particles}}
+            // loading order tree storage (also stores impulses and restitution times), partitioned into shards
+            shared_ptr<NodePool> node_pool = make_shared<NodePool>();  // owns every node of every loading tree
+            unordered_map<int, responder_shard_t> shards;  // formatted: {shard_id, shard}
+            unordered_map<int, int> shard_of;  // formatted: {pID, shard_id} (isolated particles do not belong to a shard)
+                                               // together with responder_shard_t::root this indexes the loading tree of every particle
+            int next_shard_id;
 
-            // loading order tree storage (also stores impulses and restitution times)
-            set<Node*, NodePtrComp> loading_trees;
+            // root nodes of every shard ordered by restitution time
+            // handles allow trees to be removed without searching for them
+            IndexedHeap<Node*, NodePtrComp> restitution_queue;
+            unordered_map<Node*, IndexedHeap<Node*, NodePtrComp>::handle_t> restitution_handles;  // formatted: {root node, handle in restitution_queue}
 
             // restitution impulses ("loaded" particle property)
             //unordered_map<int, vector<int>> restitution_impulses;  // formatted: {pID, {impulses of directly loaded particles}}
+
+            resume_t<TIME> resume;  // time of the last transition (for checkpoints), and the restored times until the first transition
         };
         state_type state;
 
@@ -119,13 +140,13 @@ template<typename TIME> class Responder {
             //
         }
 
-        Responder (json j) {
-            if (DEBUG_RE) cout << "Responder constructor received JSON: " << j << endl;
-            state.particle_data = j;
+        Responder (shared_ptr<ParticleStore> store) {
+            if (DEBUG_RE) cout << "Responder constructor received " << store->size() << " particles" << endl;
+            state.particle_store = store;
             state.next_internal = TIME();
             state.current_time = TIME();
-            state.sending_ri = false;
             state.buffer = NULL;
+            state.next_shard_id = 0;
             //cout << "finished ctor" << endl;
         }
 
@@ -139,80 +160,56 @@ template<typename TIME> class Responder {
         // internal transition
         void internal_transition () {
             if (DEBUG_RE) cout << "resp internal transition called" << endl;
+            state.resume.transition();
             state.current_time += state.next_internal;
             // TODO: simulate particle decay (possibly in another module)
-            state.ri_messages.clear();
 
             // set this before the following check (to make sure that it gets set before returning)
-            if (state.loading_trees.size() > 0) {
-                state.next_internal = (*state.loading_trees.begin())->getRest() - state.current_time;
+            if (state.restitution_queue.size() > 0) {
+                state.next_internal = next_restitution()->getRest() - state.current_time;
                 if (DEBUG_RE) cout << "resp internal_transition: setting next_internal to: " << state.next_internal << endl;
-                cout << "1st: " << (*state.loading_trees.begin())->getRest() << " - " << state.current_time << " = " << (*state.loading_trees.begin())->getRest() - state.current_time << endl;
+                if (DEBUG_RE) cout << "1st: " << next_restitution()->getRest() << " - " << state.current_time << " = " << next_restitution()->getRest() - state.current_time << endl;
             }
             else {
                 if (DEBUG_RE) cout << "resp internal_transition: passivating (no restitutions to perform)" << endl;
                 state.next_internal = numeric_limits<TIME>::infinity();
             }
 
-            // if we are here because of an RI, we just need to set next_internal and change the flag
-            if (state.sending_ri) {
-                if (DEBUG_RE) cout << "resp internal_transition: prematurely returning (received RI)" << endl;
-                state.sending_ri = false;
-                return;
-            }
-
             // if the buffer is not empty, preform destructive operations on the loading tree and set buffer to NULL
             // also change the velocities of particles to be the post-restitution velocities
             // this is where restitution happens in the responder
             if (state.buffer != NULL) {
                 if (DEBUG_RE) cout << "resp internal_transition: buffer is not NULL (perform restitution from previous internal transition)" << endl;
 
-                // add children back into tree (they have the same restitutionTime as parent (set in Node.addChild))
-                if (DEBUG_RE) cout << "resp internal_transition: adding child nodes of buffer:" << endl;
-                for (Node* child : state.buffer->getChildren()) {
-                    if (DEBUG_RE) cout << "| " << *child << endl;
-                    auto insertion_result = state.loading_trees.insert(child);
-                    if (DEBUG_RE) cout << "| item added: " << (insertion_result.second ? "true" : "false") << endl;
-                }
-
-                if (DEBUG_RE) cout << "resp internal_transition: loading_trees size before buffer removal (after child addition): " << state.loading_trees.size() << endl;
-                if (DEBUG_RE) display_loading_trees_debug("internal_transition");
+                int shard_id = state.shard_of[state.buffer->getColliders().first];
 
                 if (DEBUG_RE) cout << "resp internal_transition: removing buffer from loading_trees: ptr: " << state.buffer << ", val: " << *state.buffer << endl;
 
                 // remove buffer node from tree
-                int successes = 0;//state.loading_trees.erase(state.buffer);
-                if (DEBUG_RE) cout << "resp internal_transition: number of values removed: " << successes << endl;  // TODO: figure out why this is removing more than one node
-                // if removal fails, do so manually
-                if (successes != 1) {
-                    if (DEBUG_RE) cout << "resp internal_transition: removing node manually" << endl;
-                    state.loading_trees.erase(searchSet(state.buffer));  // see searchSet function comments for explanation
-                }
+                unqueue_tree(state.shards[shard_id]);
+
+                // the two sides of the restituted node are no longer loaded together
+                // children are added back into tree as the roots of their clusters (they inherit the restitutionTime of the parent until it is released (Node.detachChildren))
+                split_shard(shard_id, state.buffer);
 
-                if (DEBUG_RE) cout << "resp internal_transition: loading_trees size after buffer removal: " << state.loading_trees.size() << endl;
                 if (DEBUG_RE) display_loading_trees_debug("internal_transition");
 
                 // change velocities of involved particles (from messages)
+                // each message covers exactly one side of the restituted node
                 for (message_t message : state.collision_messages) {
-                    for (int p_id : message.particle_ids) {
-                        state.particle_data[to_string(p_id)]["velocity"] = message.data;
-                    }
+                    set_velocity(message.particle_ids[0], message.data);
                 }
 
-                // remove associations in state.id_loaded
-                state.id_loaded[state.buffer->getColliders().first].erase(state.buffer->getColliders().second);
-                state.id_loaded[state.buffer->getColliders().second].erase(state.buffer->getColliders().first);
-
                 // remove now restituted node
-                delete state.buffer;
+                state.node_pool->release(state.buffer);
 
                 // clear buffer
                 state.buffer = NULL;
             }
 
             // this must be set again since the loading_tree has been updated
-            if (state.loading_trees.size() > 0) {
-                state.next_internal = (*state.loading_trees.begin())->getRest() - state.current_time;
+            if (state.restitution_queue.size() > 0) {
+                state.next_internal = next_restitution()->getRest() - state.current_time;
                 if (DEBUG_RE) cout << "resp internal_transition: setting next_internal to: " << state.next_internal << endl;
                 //cout << "2nd: " << (*state.loading_trees.begin())->getRest() << " - " << state.current_time << " = " << (*state.loading_trees.begin())->getRest() - state.current_time << endl;
             }
@@ -222,7 +219,6 @@ template<typename TIME> class Responder {
             }
 
             // this must be done after the above tree/velocity operations as the messages as used
-            // this will not happen if state.sending_ri is true (since, if true, the function returns earlier)
             state.collision_messages.clear();  // can be done here since output is called before internal transition in Cadmium
 
             // print state of state.loading_trees before additions or removals
@@ -230,28 +226,28 @@ template<typename TIME> class Responder {
 
             // if there are no restitutions in the future, resp is passivated (earlier in the function)
             // otherwise, prepare the next restitution
-            if (state.loading_trees.size() > 0) {
+            if (state.restitution_queue.size() > 0) {
                 // the following should happen on the internal transition AFTER output sends the messages pertaining to the node in the buffer
                 // here, we find the next node to be restituted and store that information (messages and buffer)
 
                 if (DEBUG_RE) cout << "resp internal_transition: calculating/preparing next restitution" << endl;
 
-                Node* curr_node = *state.loading_trees.begin();  // get the node with the nearest restitution time
+                Node* curr_node = next_restitution();  // get the node with the nearest restitution time
                 state.buffer = curr_node;  // store so that modifications can be made to the tree after the messages are sent
                 if (DEBUG_RE) cout << "resp internal_transition: messages being prepared for node: " << *curr_node << endl;
 
-                // get loading group data
+                // get loading group data (the sides of the node are its child trees or single particles)
                 vector<int> p_ids = {curr_node->getColliders().first, curr_node->getColliders().second};
-                vector<scan_result_t> group_data;
-                group_data.push_back(scan_branch(p_ids[0], p_ids[1]));
-                group_data.push_back(scan_branch(p_ids[1], p_ids[0]));
+                vector<cluster_data_t> group_data;
+                group_data.push_back(side_data(curr_node, p_ids[0]));
+                group_data.push_back(side_data(curr_node, p_ids[1]));
 
                 // calculate new velocities for children
                 vector<vector<float>> velocities;
-                velocities.push_back(VectorUtils::element_op(state.particle_data[to_string(p_ids[0])]["velocity"],
+                velocities.push_back(VectorUtils::element_op(velocity_of(p_ids[0]),
                                                              VectorUtils::element_dist(curr_node->getImpulse(), group_data[0].mass, VectorUtils::divide),
                                                              VectorUtils::add));
-                velocities.push_back(VectorUtils::element_op(state.particle_data[to_string(p_ids[1])]["velocity"],
+                velocities.push_back(VectorUtils::element_op(velocity_of(p_ids[1]),
                                                              VectorUtils::element_dist(curr_node->getImpulse(), group_data[1].mass, VectorUtils::divide),
                                                              VectorUtils::subtract));
 
@@ -259,7 +255,7 @@ template<typename TIME> class Responder {
                 // no velocities should be changed until restitution occurs
                 // these messages will be sent to the detector and also used to set the velocities in the responder
                 for (unsigned int i = 0; i < velocities.size(); ++i) {
-                    state.collision_messages.push_back(message_t(velocities[i], group_data[i].ids, "rest"));  // string is for the message's purpose attribute (mainly logging purposes)
+                    state.collision_messages.push_back(message_t(velocities[i], group_data[i].ids, purpose_t::rest));  // purpose is mainly for logging
                 }
 
                 if (DEBUG_RE) {
@@ -277,170 +273,45 @@ template<typename TIME> class Responder {
         // external transition
         void external_transition (TIME e, typename make_message_bags<input_ports>::type mbs) {
             if (DEBUG_RE) cout << "resp external transition called" << endl;
+            if (state.resume.active) e = state.resume.elapsed();
+            state.resume.transition();
 
             state.current_time += e;
 
-            if (get_messages<typename Responder_defs::impulse_in>(mbs).size() > 1) {
-                assert(false && "Responder received more than one concurrent message");
-            }
-            // Handle impulse messages from RI
-            for (const auto &x : get_messages<typename Responder_defs::impulse_in>(mbs)) {
-                if (DEBUG_RE) cout << "NOTE: responder received impulse: " << x << endl;
-
-                if (x.particle_ids.size() == 0) continue;  // received an uninitialized message
-
-                // get data on the particles that are loaded with the particle receiving the impulse (they must all be changed as well)
-                scan_result_t group_data = scan_branch(x.particle_ids[0], -1);
-
-                // calculate the new velocity (since all particles effected have the same velocity, we can use any of them for velocity)
-                vector<float> newVelocity;
-                //float particle_mass = state.particle_data[to_string(x.particle_ids[0])]["mass"];
-                newVelocity = VectorUtils::element_op(state.particle_data[to_string(x.particle_ids[0])]["velocity"],
-                                                      VectorUtils::element_dist(x.data, group_data.mass, VectorUtils::divide),
-                                                      VectorUtils::add);
-
-                for (int id : group_data.ids) {
-                    state.particle_data[to_string(id)]["velocity"] = newVelocity;  // record velocity change in resp particle model
-                }
-                state.ri_messages.push_back(message_t(newVelocity, group_data.ids, "ri"));  // string is for the message purpose (mainly logging purposes)
-
-                state.sending_ri = true;
+            // every velocity change made by this transition, in the order they are made
+            vector<message_t> responses;
 
-                // set next internal (adjust it to keep stay accurate for the next restitution)
-                // if there is a collision message, this value may be overridden
-                //state.next_internal -= e;
-                state.next_internal = 0;  // immediately respond to impulse
+            // Handle impulse messages from RI
+            // impulses are applied in order of particle ID (concurrent impulses on the same cluster add up in the same order every run)
+            vector<message_t> impulses = get_messages<typename Responder_defs::impulse_in>(mbs);
+            stable_sort(impulses.begin(), impulses.end(), [](const message_t& lhs, const message_t& rhs) {
+                return first_id(lhs.particle_ids) < first_id(rhs.particle_ids);
+            });
+            for (const auto &x : impulses) {
+                apply_impulse(x, responses);
             }
 
             // Handle collision messages
-            for (const auto &x : get_messages<typename Responder_defs::collision_in>(mbs)) {
-                if (DEBUG_RE) cout << "resp external transition: responder received collision: " << x << endl;
+            // collisions are resolved in order of their particle IDs, after the impulses
+            // (a collision involving a cluster made by an earlier collision of the same bag uses the merged cluster)
+            vector<collision_message_t> collisions = get_messages<typename Responder_defs::collision_in>(mbs);
+            stable_sort(collisions.begin(), collisions.end());
+            for (const auto &x : collisions) {
+                resolve_collision(x, responses);
+            }
 
-                // reset since we have received a new collision
+            if (responses.size() > 0) {
+                // reset since velocities have changed (a restitution prepared earlier is prepared again from the new velocities)
                 state.buffer = NULL;  // do not manipulate the tree for this node
-                state.collision_messages.clear();  // prepare messages buffer for next set of velocities
-
-                vector<vector<float>> msg_positions;
-                vector<int> p_ids;
-                vector<scan_result_t> group_data;
-
-                // grab the particle positions (must happen before impulses are calculated)
-                // grab the particle IDs
-                // calculate branch data
-                for (const auto& [key, val] : x.positions) {
-                    msg_positions.push_back(val);
-                    p_ids.push_back(key);  // store particle IDs
-                    group_data.push_back(scan_branch(key, -1));
-                }
-
-                if (p_ids.size() != 2) continue;  // received an uninitialized or malformed message
-
-                // calculate full impulse
-                // we keep this impulse in order to calculate the resitution impulse
-                vector<float> full_impulse = calc_impulse(p_ids[0], p_ids[1], group_data[0].mass, group_data[1].mass, msg_positions[0], msg_positions[1]);
-
-                // calculate loading impulse
-                vector<float> loading_impulse = calc_loading_impulse(p_ids[0], p_ids[1], group_data[0].mass, group_data[1].mass);
-
-                // calculate loading velocity
-                vector<float> loading_velocity = calc_loading_velocity(p_ids[0], p_ids[1], group_data[0].mass, group_data[1].mass);
-
-                // calculate restitution impulse
-                vector<float> restitution_impulse = VectorUtils::element_op(full_impulse, loading_impulse, VectorUtils::subtract);
-
-                // calculate restitution time
-                // TODO: should be calculated
-                float restitution_time = state.current_time + 3;
-
-                if (DEBUG_RE) {
-                    cout << "resp external_transition: impulses/velocities calculated:" << endl;
-                    cout << "| p1_id: " << p_ids[0] << endl;
-                    cout << "| p1_group_ids: " << VectorUtils::get_string<int>(group_data[0].ids) << endl;
-                    cout << "| p1_group_vel: " << VectorUtils::get_string<float>(state.particle_data[to_string(p_ids[0])]["velocity"]) << endl;
-                    cout << "| p1_group_mass: " << group_data[0].mass << endl;
-                    cout << "|" << endl;
-                    cout << "| p2_id: " << p_ids[1] << endl;
-                    cout << "| p2_group_ids: " << VectorUtils::get_string<int>(group_data[1].ids) << endl;
-                    cout << "| p2_group_vel: " << VectorUtils::get_string<float>(state.particle_data[to_string(p_ids[1])]["velocity"]) << endl;
-                    cout << "| p2_group_mass: " << group_data[1].mass << endl;
-                    cout << "|" << endl;
-                    cout << "|        full impulse: " << VectorUtils::get_string<float>(full_impulse) << endl;
-                    cout << "|     loading impulse: " << VectorUtils::get_string<float>(loading_impulse) << endl;
-                    cout << "|    loading velocity: " << VectorUtils::get_string<float>(loading_velocity) << endl;
-                    cout << "| restitution impulse: " << VectorUtils::get_string<float>(restitution_impulse) << endl;
-                }
-
-                // manage loading trees
-                // get the trees of the colliding nodes (if there are any)
-                vector<Node*> child_trees;
-                for (int i = 0; i <= 1; ++i) {
-                    if (group_data[i].ids.size() > 1) {
-                        for (Node* node : state.loading_trees) {
-                            auto result = node->getParticles().find(p_ids[i]);
-                            if (result != node->getParticles().end()) {
-                                child_trees.push_back(node);
-                            }
-                        }
-                    }
-                }
-
-                // print state of state.loading_trees before additions or removals
-                if (DEBUG_RE) display_loading_trees_debug("external_transition");
-
-                // create new node and remove older pointers
-                Node* newNode = new Node(p_ids[0], p_ids[1], group_data[0].mass + group_data[1].mass, restitution_time, restitution_impulse);
-                if (DEBUG_RE) cout << "resp external_transition: adding children to new node" << endl;
-                newNode->addChildren(child_trees);
-                // print state of state.loading_trees before additions or removals but after children have been added to node
-                if (DEBUG_RE) display_loading_trees_debug("external_transition");
-                state.loading_trees.insert(newNode);
-                for (Node* child : child_trees) {
-                    if (DEBUG_RE) cout << "resp external_transition: removing node from loading_trees (added as child): ptr: " << child << ", val: " << *child << endl;
-                    if (DEBUG_RE) cout << "resp external_transition: find node result (in set): " << (state.loading_trees.find(child) == state.loading_trees.end() ? "false" : "true") << endl;
-                    int successes = 0;//state.loading_trees.erase(child);
-                    if (DEBUG_RE) cout << "resp external_transition: number of values removed: " << successes << endl;
-                    // if removal fails, do so manually
-                    if (successes != 1) {
-                        if (DEBUG_RE) cout << "resp external_transition: removing node manually" << endl;
-                        state.loading_trees.erase(searchSet(child));  // see searchSet function comments for explanation
-                    }
-                }
-
-                if (DEBUG_RE) cout << "resp external_transition: added node to state.loading_trees: " << *newNode << endl;
-
-                // print state of state.loading_trees after additions or removals
-                if (DEBUG_RE) display_loading_trees_debug("external_transition");
-
-                // update loading relations
-                state.id_loaded[p_ids[0]].insert(p_ids[1]);
-                state.id_loaded[p_ids[1]].insert(p_ids[0]);
-
-                if (DEBUG_RE) {
-                    cout << "impulse calculation and application:" << endl;
-                    cout << "| resp external transition: before setting calculated velocities: (p_id: " << p_ids[0] << ") " << VectorUtils::get_string<float>(state.particle_data[to_string(p_ids[0])]["velocity"]) << endl;
-                    cout << "| resp external transition: before setting calculated velocities: (p_id: " << p_ids[1] << ") " << VectorUtils::get_string<float>(state.particle_data[to_string(p_ids[1])]["velocity"]) << endl;
-                    cout << "| resp external transition: calculated full impulse: " << VectorUtils::get_string<float>(full_impulse) << endl;
-                    //cout << "| resp external transition: new velocity: (p_id: " << p_ids[0] << ") " << VectorUtils::get_string<float>(p1_vel) << endl;
-                    //cout << "| resp external transition: new velocity: (p_id: " << p_ids[1] << ") " << VectorUtils::get_string<float>(p2_vel) << endl;
-                }
-
-                // all involved particles
-                vector<int> involved_ids = VectorUtils::concat<int>(group_data[0].ids, group_data[1].ids);
-
-                // set velocities
-                for (int id : involved_ids) {
-                    state.particle_data[to_string(id)]["velocity"] = loading_velocity;
-                }
-
-                // prepare messages
-                state.collision_messages.push_back(message_t(loading_velocity, involved_ids, "load"));  // string is for the message purpose (mainly logging purposes)
+                state.collision_messages = latest_responses(responses);  // every particle gets only its final velocity
 
                 // immediately send new velocities to subVs
                 state.next_internal = 0;
             }
-
-            // set next internal
-            //state.next_internal = 0;
+            else {
+                // nothing changed, keep the time of the next restitution
+                state.next_internal -= e;
+            }
 
             if (DEBUG_RE) cout << "resp external transition finish" << endl;
         }
@@ -448,6 +319,7 @@ template<typename TIME> class Responder {
         // confluence transition
         void confluence_transition (TIME e, typename make_message_bags<input_ports>::type mbs) {
             if (DEBUG_RE) cout << "resp confluence transition called" << endl;
+            if (state.resume.active) e = state.resume.elapsed();  // before internal_transition ends the resume
             internal_transition();
             external_transition(e, move(mbs));
             if (DEBUG_RE) cout << "resp confluence transition finishing" << endl;
@@ -457,14 +329,7 @@ template<typename TIME> class Responder {
         typename make_message_bags<output_ports>::type output () const {
             if (DEBUG_RE) cout << "resp output called" << endl;
             typename make_message_bags<output_ports>::type bags;
-            vector<message_t> bag_port_out;
-            if (state.sending_ri) {
-                bag_port_out = state.ri_messages;
-            }
-            else {
-                bag_port_out = state.collision_messages;
-            }
-            get_messages<typename Responder_defs::response_out>(bags) = bag_port_out;
+            get_messages<typename Responder_defs::response_out>(bags) = state.collision_messages;
             if (DEBUG_RE) {
                 cout << "resp output sending: ";
                 for (auto i : state.collision_messages) {
@@ -479,6 +344,7 @@ template<typename TIME> class Responder {
         // time advance function
         TIME time_advance () const {
             if (DEBUG_RE) cout << "resp time advance called/returning" << endl;
+            if (state.resume.active) return state.resume.advance();
             return state.next_internal < 0 ? 0 : state.next_internal;
         }
 
@@ -505,21 +371,114 @@ template<typename TIME> class Responder {
 
         friend ostringstream& operator<<(ostringstream& os, const typename Responder<TIME>::state_type& i) {
             if (DEBUG_RE) cout << "resp << called" << endl;
-            string result = "num particles: " + i.particle_data.size();
-            result += ", num collision velocity messages: " + i.collision_messages.size();
-            os << result;
+            TextBuffer& text = TextBuffer::local();
+            size_t start = text.size();
+            text << "num particles: " << i.particle_store->size();
+            text << ", num collision velocity messages: " << i.collision_messages.size();
+            text.flush_to(os, start);
             if (DEBUG_RE) cout << "resp << returning" << endl;
             return os;
         }
 
+        // response velocities of isolated particles are saved with the store
+        // every shard is saved with its loading tree, which is rebuilt node by node (a tree lays out its particles
+        // from its structure alone, so the rebuilt clusters list their particles in the same order)
+        void save_checkpoint (CheckpointWriter& out) const {
+            out.put(state.next_internal);
+            out.put(state.current_time);
+            out.put(state.collision_messages);
+            out.put(state.next_shard_id);
+            out.put(uint64_t(state.shards.size()));
+            for (const auto& [shard_id, shard] : state.shards) {
+                out.put(shard_id);
+                out.put(shard.members);
+                out.put(shard.mass);
+                out.put(shard.velocity);
+                out.put(shard.root->getRest());
+                save_tree(out, shard.root);
+                out.put(shard.root == state.buffer);
+            }
+        }
+
+        void restore_checkpoint (CheckpointReader& in) {
+            assert(state.shards.size() == 0 && "Responder: restoring a checkpoint into a responder that has been run");
+            uint64_t count;
+            in.get(state.next_internal);
+            in.get(state.current_time);
+            in.get(state.collision_messages);
+            in.get(state.next_shard_id);
+            in.get(count);
+            for (uint64_t i = 0; i < count; ++i) {
+                int shard_id;
+                float restitution_time;
+                bool buffered;
+                in.get(shard_id);
+                responder_shard_t& shard = state.shards[shard_id];
+                in.get(shard.members);
+                in.get(shard.mass);
+                in.get(shard.velocity);
+                in.get(restitution_time);
+                Node* root = restore_tree(in, restitution_time);
+                in.get(buffered);
+                for (int p_id : shard.members) {
+                    state.shard_of[p_id] = shard_id;
+                }
+                queue_tree(shard, root);
+                if (buffered) state.buffer = root;
+            }
+        }
+
+        // whether a particle belongs to a loaded cluster (only particles that do not can be handed to another domain)
+        bool loaded (int p_id) const {
+            return state.shard_of.count(p_id) > 0;
+        }
+
+        // particles handed to or taken from the responder of another domain between two steps (see test/main_domain_test.cpp)
+        // a particle that is not loaded has no state in the responder but its response velocity, and no restitution scheduled
+        void remove_particle (int p_id) {
+            assert(!loaded(p_id) && "Responder: a loaded particle cannot leave its responder");
+        }
+
+        // the particle has been inserted into the store
+        void add_particle (int p_id, vector_view_t response_velocity) {
+            state.particle_store->set_response_velocity(p_id, response_velocity);
+        }
+
     private:
 
-        struct scan_result_t {
+        // a node followed by its children (only the restitution time of the root is used, it is saved with the shard)
+        void save_tree (CheckpointWriter& out, const Node* node) const {
+            out.put(node->getColliders());
+            out.put(node->getMass());
+            out.put(node->getImpulse());
+            out.put(uint64_t(node->getChildren().size()));
+            for (const Node* child : node->getChildren()) {
+                save_tree(out, child);
+            }
+        }
+
+        Node* restore_tree (CheckpointReader& in, float restitution_time) {
+            pair<int, int> colliders;
+            float mass;
+            vector<float> impulse;
+            uint64_t num_children;
+            in.get(colliders);
+            in.get(mass);
+            in.get(impulse);
+            in.get(num_children);
+            vector<Node*> children;
+            for (uint64_t i = 0; i < num_children; ++i) {
+                children.push_back(restore_tree(in, restitution_time));
+            }
+            Node* node = state.node_pool->create(colliders.first, colliders.second, mass, restitution_time, impulse);
+            node->addChildren(children);
+            return node;
+        }
+
+        struct cluster_data_t {
             float mass;
             vector<int> ids;
-            vector<pair<int, int>> pairs;
-            scan_result_t (float i_mass, vector<int> i_ids, vector<pair<int, int>> i_pairs) :
-                mass(i_mass), ids(i_ids), pairs(i_pairs) {}
+            cluster_data_t (float i_mass, vector<int> i_ids) : mass(i_mass), ids(i_ids) {}
         };
 
         // get the impulse after a collision
@@ -534,8 +493,8 @@ template<typename TIME> class Responder {
             float c_restitute = 0.9;  // coefficient of restitution (0: completely inelastic collisions, 1: completely elastic collisions)
 
             // relative velocity of p1 and p2
-            vector<float> v_1_2 = VectorUtils::element_op(state.particle_data[to_string(p2_id)]["velocity"],
-                                                          state.particle_data[to_string(p1_id)]["velocity"],
+            vector<float> v_1_2 = VectorUtils::element_op(velocity_of(p2_id),
+                                                          velocity_of(p1_id),
                                                           VectorUtils::subtract);
 
             // unit vector pointing from p1 to p2
@@ -559,12 +518,12 @@ template<typename TIME> class Responder {
         vector<float> calc_loading_velocity (int p1_id, int p2_id, float p1_mass, float p2_mass) {
             return VectorUtils::element_op(
                 VectorUtils::element_dist(
-                    state.particle_data[to_string(p1_id)]["velocity"],
+                    velocity_of(p1_id),
                     (1 / (1 + (p2_mass / p1_mass))),
                     VectorUtils::multiply
                 ),
                 VectorUtils::element_dist(
-                    state.particle_data[to_string(p2_id)]["velocity"],
+                    velocity_of(p2_id),
                     (1 / (1 + (p1_mass / p2_mass))),
                     VectorUtils::multiply
                 ),
@@ -576,8 +535,8 @@ template<typename TIME> class Responder {
         vector<float> calc_loading_impulse (int p1_id, int p2_id, float p1_mass, float p2_mass) {
             return VectorUtils::element_dist(
                 VectorUtils::element_op(
-                    state.particle_data[to_string(p2_id)]["velocity"],
-                    state.particle_data[to_string(p1_id)]["velocity"],
+                    velocity_of(p2_id),
+                    velocity_of(p1_id),
                     VectorUtils::subtract
                 ),
                 1 / ((1 / p1_mass) + (1 / p2_mass)),  // this differs from the thesis (originally detailed on p118)
@@ -585,50 +544,327 @@ template<typename TIME> class Responder {
             );
         }
 
-        // scan branch
-        // adapted from original TPS code (v1.4)
-        scan_result_t scan_branch (int id_a, int id_src) {
-            float mass_a = state.particle_data[to_string(id_a)]["mass"];
-            vector<int> ids_a = {id_a};
-            vector<pair<int, int>> pairs_a;
-            for (int id_b : state.id_loaded[id_a]) {
-                if (id_b != id_src) {
-                    scan_result_t result = scan_branch(id_b, id_a);
-                    mass_a = mass_a + result.mass;
-                    for (int id : result.ids) {
-                        ids_a.push_back(id);
-                    }
-                    for (pair<int, int> id_pair : result.pairs) {
-                        pairs_a.push_back(id_pair);
+        // apply an impulse from RI to the cluster of the particle receiving it
+        void apply_impulse (const message_t& x, vector<message_t>& responses) {
+            if (DEBUG_RE) cout << "NOTE: responder received impulse: " << x << endl;
+
+            if (x.particle_ids.size() == 0) return;  // received an uninitialized message
+
+            // get data on the particles that are loaded with the particle receiving the impulse (they must all be changed as well)
+            cluster_data_t group_data = cluster_data(x.particle_ids[0]);
+
+            // calculate the new velocity (since all particles effected have the same velocity, we can use any of them for velocity)
+            vector<float> newVelocity;
+            //float particle_mass = state.particle_data[to_string(x.particle_ids[0])]["mass"];
+            newVelocity = VectorUtils::element_op(velocity_of(x.particle_ids[0]),
+                                                  VectorUtils::element_dist(x.data, group_data.mass, VectorUtils::divide),
+                                                  VectorUtils::add);
+
+            set_velocity(x.particle_ids[0], newVelocity);  // record velocity change in resp particle model (once for the whole cluster)
+            responses.push_back(message_t(newVelocity, group_data.ids, purpose_t::ri));  // purpose is mainly for logging
+        }
+
+        // load the clusters of two colliding particles together
+        void resolve_collision (const collision_message_t& x, vector<message_t>& responses) {
+            if (DEBUG_RE) cout << "resp external transition: responder received collision: " << x << endl;
+
+            vector<vector<float>> msg_positions;
+            vector<int> p_ids;
+            vector<cluster_data_t> group_data;
+
+            // grab the particle positions (must happen before impulses are calculated)
+            // grab the particle IDs
+            // get cluster data
+            for (size_t i = 0; i < x.size(); ++i) {
+                msg_positions.push_back(x.positions[i]);
+                p_ids.push_back(x.particle_ids[i]);  // store particle IDs
+                group_data.push_back(cluster_data(x.particle_ids[i]));
+            }
+
+            if (p_ids.size() != 2) return;  // received an uninitialized or malformed message
+
+            // particles of the same cluster share a velocity and cannot approach each other
+            // (this can only come from a stale prediction) so the cluster keeps its loading and velocity
+            if (in_same_cluster(p_ids[0], p_ids[1])) {
+                if (DEBUG_RE) cout << "resp external_transition: ignoring collision within a loaded cluster" << endl;
+                responses.push_back(message_t(velocity_of(p_ids[0]), group_data[0].ids, purpose_t::load));
+                return;
+            }
+
+            // calculate full impulse
+            // we keep this impulse in order to calculate the resitution impulse
+            vector<float> full_impulse = calc_impulse(p_ids[0], p_ids[1], group_data[0].mass, group_data[1].mass, msg_positions[0], msg_positions[1]);
+
+            // calculate loading impulse
+            vector<float> loading_impulse = calc_loading_impulse(p_ids[0], p_ids[1], group_data[0].mass, group_data[1].mass);
+
+            // calculate loading velocity
+            vector<float> loading_velocity = calc_loading_velocity(p_ids[0], p_ids[1], group_data[0].mass, group_data[1].mass);
+
+            // calculate restitution impulse
+            vector<float> restitution_impulse = VectorUtils::element_op(full_impulse, loading_impulse, VectorUtils::subtract);
+
+            // calculate restitution time
+            // TODO: should be calculated
+            float restitution_time = state.current_time + 3;
+
+            if (DEBUG_RE) {
+                cout << "resp external_transition: impulses/velocities calculated:" << endl;
+                cout << "| p1_id: " << p_ids[0] << endl;
+                cout << "| p1_group_ids: " << VectorUtils::get_string<int>(group_data[0].ids) << endl;
+                cout << "| p1_group_vel: " << VectorUtils::get_string<float>(velocity_of(p_ids[0])) << endl;
+                cout << "| p1_group_mass: " << group_data[0].mass << endl;
+                cout << "|" << endl;
+                cout << "| p2_id: " << p_ids[1] << endl;
+                cout << "| p2_group_ids: " << VectorUtils::get_string<int>(group_data[1].ids) << endl;
+                cout << "| p2_group_vel: " << VectorUtils::get_string<float>(velocity_of(p_ids[1])) << endl;
+                cout << "| p2_group_mass: " << group_data[1].mass << endl;
+                cout << "|" << endl;
+                cout << "|        full impulse: " << VectorUtils::get_string<float>(full_impulse) << endl;
+                cout << "|     loading impulse: " << VectorUtils::get_string<float>(loading_impulse) << endl;
+                cout << "|    loading velocity: " << VectorUtils::get_string<float>(loading_velocity) << endl;
+                cout << "| restitution impulse: " << VectorUtils::get_string<float>(restitution_impulse) << endl;
+            }
+
+            // print state of state.loading_trees before additions or removals
+            if (DEBUG_RE) display_loading_trees_debug("external_transition");
+
+            // manage loading trees
+            // get the trees of the colliding nodes (if there are any)
+            // remove older pointers (before their restitution times are changed by becoming children)
+            Node* child_trees[2] = {NULL, NULL};  // the tree of each collider (NULL if it is not loaded)
+            for (int i = 0; i <= 1; ++i) {
+                if (group_data[i].ids.size() > 1) {
+                    Node* child = tree_of(p_ids[i]);
+                    if (DEBUG_RE) cout << "resp external_transition: removing node from loading_trees (added as child): ptr: " << child << ", val: " << *child << endl;
+                    child_trees[i] = child;
+                    unqueue_tree(state.shards[state.shard_of[p_ids[i]]]);
+                }
+            }
+
+            // the colliding clusters now belong to the same shard
+            int shard_id = merge_shards(p_ids[0], p_ids[1]);
+            responder_shard_t& shard = state.shards[shard_id];
+
+            // create new node
+            Node* newNode = state.node_pool->create(p_ids[0], p_ids[1], group_data[0].mass + group_data[1].mass, restitution_time, restitution_impulse);
+            if (DEBUG_RE) cout << "resp external_transition: adding children to new node" << endl;
+            newNode->addColliderChildren(child_trees[0], child_trees[1]);
+            // print state of state.loading_trees before additions or removals but after children have been added to node
+            if (DEBUG_RE) display_loading_trees_debug("external_transition");
+            queue_tree(shard, newNode);
+
+            if (DEBUG_RE) cout << "resp external_transition: added node to state.loading_trees: " << *newNode << endl;
+
+            // print state of state.loading_trees after additions or removals
+            if (DEBUG_RE) display_loading_trees_debug("external_transition");
+
+            if (DEBUG_RE) {
+                cout << "impulse calculation and application:" << endl;
+                cout << "| resp external transition: before setting calculated velocities: (p_id: " << p_ids[0] << ") " << VectorUtils::get_string<float>(velocity_of(p_ids[0])) << endl;
+                cout << "| resp external transition: before setting calculated velocities: (p_id: " << p_ids[1] << ") " << VectorUtils::get_string<float>(velocity_of(p_ids[1])) << endl;
+                cout << "| resp external transition: calculated full impulse: " << VectorUtils::get_string<float>(full_impulse) << endl;
+                //cout << "| resp external transition: new velocity: (p_id: " << p_ids[0] << ") " << VectorUtils::get_string<float>(p1_vel) << endl;
+                //cout << "| resp external transition: new velocity: (p_id: " << p_ids[1] << ") " << VectorUtils::get_string<float>(p2_vel) << endl;
+            }
+
+            // all involved particles
+            vector<int> involved_ids = VectorUtils::concat<int>(group_data[0].ids, group_data[1].ids);
+
+            // set velocities (once for the merged cluster)
+            set_velocity(p_ids[0], loading_velocity);
+
+            // prepare messages
+            responses.push_back(message_t(loading_velocity, involved_ids, purpose_t::load));  // purpose is mainly for logging
+        }
+
+        // drop messages that are overwritten by a later message of the same transition
+        // clusters only grow during an external transition, so a later message that shares a particle with an earlier one covers all of its particles
+        vector<message_t> latest_responses (const vector<message_t>& responses) const {
+            vector<message_t> result;
+            unordered_set<int> covered;
+            for (auto it = responses.rbegin(); it != responses.rend(); ++it) {
+                bool superseded = false;
+                for (int p_id : it->particle_ids) {
+                    if (covered.count(p_id) > 0) {
+                        superseded = true;
+                        break;
                     }
-                    pairs_a.push_back({id_a, id_b});
                 }
+                if (!superseded) result.push_back(*it);
+                covered.insert(it->particle_ids.begin(), it->particle_ids.end());
+            }
+            reverse(result.begin(), result.end());
+            return result;
+        }
+
+        // sort key for messages that may be uninitialized (these come first)
+        static int first_id (const id_list_t& particle_ids) {
+            return (particle_ids.size() > 0) ? particle_ids[0] : numeric_limits<int>::min();
+        }
+
+        // mass and members of the cluster a particle belongs to (an isolated particle is its own cluster)
+        cluster_data_t cluster_data (int p_id) const {
+            auto it = state.shard_of.find(p_id);
+            if (it == state.shard_of.end()) {
+                return cluster_data_t(state.particle_store->mass(p_id), {p_id});
+            }
+            const responder_shard_t& shard = state.shards.at(it->second);
+            return cluster_data_t(shard.mass, shard.members);
+        }
+
+        // mass and members of the side of a node that contains p_id (its child tree or p_id alone)
+        cluster_data_t side_data (Node* node, int p_id) {
+            Node* side = node->getChildOf(p_id);
+            if (side == NULL) {
+                return cluster_data_t(state.particle_store->mass(p_id), {p_id});
+            }
+            ParticleView side_particles = side->getParticles();
+            return cluster_data_t(side->getMass(), vector<int>(side_particles.begin(), side_particles.end()));
+        }
+
+        bool in_same_cluster (int p1_id, int p2_id) const {
+            auto it1 = state.shard_of.find(p1_id);
+            auto it2 = state.shard_of.find(p2_id);
+            return it1 != state.shard_of.end() && it2 != state.shard_of.end() && it1->second == it2->second;
+        }
+
+        // velocity of a particle (loaded particles take their cluster's velocity)
+        vector<float> velocity_of (int p_id) const {
+            auto it = state.shard_of.find(p_id);
+            if (it == state.shard_of.end()) {
+                return state.particle_store->response_velocity(p_id);
+            }
+            return state.shards.at(it->second).velocity;
+        }
+
+        // set the velocity of a particle and every particle loaded with it
+        void set_velocity (int p_id, const vector<float>& velocity) {
+            auto it = state.shard_of.find(p_id);
+            if (it == state.shard_of.end()) {
+                state.particle_store->set_response_velocity(p_id, velocity);
+            }
+            else {
+                state.shards[it->second].velocity = velocity;
             }
-            return scan_result_t(mass_a, ids_a, pairs_a);
         }
 
         void display_loading_trees_debug (string function_name) {
-            cout << "resp " << function_name << ": nodes in state.loading_trees (size: " << state.loading_trees.size() << "):" << endl;
-            for (Node* node : state.loading_trees) {
-                cout << "| ptr: " << node << ", val: ";
-                cout.flush();
-                cout << *node << endl;
+            cout << "resp " << function_name << ": nodes in state.shards (shards: " << state.shards.size() << "):" << endl;
+            for (auto& [shard_id, shard] : state.shards) {
+                cout << "| shard " << shard_id << " (particles: " << shard.members.size() << ", mass: " << shard.mass << "):" << endl;
+                if (shard.root != NULL) {
+                    cout << "| | ptr: " << shard.root << ", val: ";
+                    cout.flush();
+                    cout << *shard.root << endl;
+                }
             }
-            if (state.loading_trees.size() == 0) {
-                cout << "| state.loading_trees reported size=0" << endl;
+            if (state.shards.size() == 0) {
+                cout << "| state.shards reported size=0" << endl;
             }
         }
 
-        // this should not be needed since searching an ordered set should be trivial
-        // despite this, removing child nodes proved unreliable when erasing by value
-        // instead, it became necessary to erase by an iterator that is obtained manually
-        set<Node*, NodePtrComp>::iterator searchSet (Node* child) {
-            for (auto it = state.loading_trees.begin(); it != state.loading_trees.end(); ++it) {
-                if ((*it)->getColliders().first == child->getColliders().first && (*it)->getColliders().second == child->getColliders().second) {
-                    return it;
+        // the node with the nearest restitution time over all shards
+        Node* next_restitution () {
+            return state.restitution_queue.top();
+        }
+
+        // the root of the loading tree that contains a particle (NULL for isolated particles)
+        Node* tree_of (int p_id) {
+            auto it = state.shard_of.find(p_id);
+            if (it == state.shard_of.end()) return NULL;
+            return state.shards[it->second].root;
+        }
+
+        // make a node the root of a shard's tree and add it to the restitution queue
+        void queue_tree (responder_shard_t& shard, Node* node) {
+            assert(shard.root == NULL && "Responder: a cluster can only have one loading tree");
+            shard.root = node;
+            state.restitution_handles[node] = state.restitution_queue.push(node);
+        }
+
+        // remove the root of a shard's tree from the restitution queue
+        void unqueue_tree (responder_shard_t& shard) {
+            auto it = state.restitution_handles.find(shard.root);
+            assert(it != state.restitution_handles.end() && "Responder: removing a loading tree that is not queued");
+            state.restitution_queue.erase(it->second);
+            state.restitution_handles.erase(it);
+            shard.root = NULL;
+        }
+
+        // get the shard of a particle, creating a shard for it if it is isolated
+        int shard_for (int p_id) {
+            auto it = state.shard_of.find(p_id);
+            if (it != state.shard_of.end()) return it->second;
+            int shard_id = state.next_shard_id++;
+            responder_shard_t& shard = state.shards[shard_id];
+            shard.members = {p_id};
+            shard.mass = state.particle_store->mass(p_id);
+            shard.velocity = velocity_of(p_id);
+            state.shard_of[p_id] = shard_id;
+            return shard_id;
+        }
+
+        // the particle no longer belongs to a cluster, its velocity is stored with the particle again
+        void release_particle (int p_id, const vector<float>& velocity) {
+            state.particle_store->set_response_velocity(p_id, velocity);
+            state.shard_of.erase(p_id);
+        }
+
+        // join the shards of two colliding particles (the smaller shard is moved into the larger)
+        // called once the trees of both shards have been removed from the restitution queue
+        int merge_shards (int p1_id, int p2_id) {
+            int keep_id = shard_for(p1_id);
+            int drop_id = shard_for(p2_id);
+            if (keep_id == drop_id) return keep_id;
+            if (state.shards[keep_id].members.size() < state.shards[drop_id].members.size()) {
+                swap(keep_id, drop_id);
+            }
+            responder_shard_t& keep = state.shards[keep_id];
+            responder_shard_t& drop = state.shards[drop_id];
+            if (DEBUG_RE) cout << "resp merge_shards: merging shard " << drop_id << " into shard " << keep_id << endl;
+            for (int p_id : drop.members) {
+                keep.members.push_back(p_id);
+                state.shard_of[p_id] = keep_id;
+            }
+            keep.mass = keep.mass + drop.mass;
+            state.shards.erase(drop_id);
+            return keep_id;
+        }
+
+        // separate the two sides of a restituted node into their own clusters (called once their loading has been removed)
+        // every side is either one of the node's child trees (which becomes the root of the side's cluster) or a single particle
+        void split_shard (int shard_id, Node* node) {
+            responder_shard_t& shard = state.shards[shard_id];
+            Node* kept_tree = node->getChildOf(node->getColliders().first);
+            Node* moved_tree = node->getChildOf(node->getColliders().second);
+
+            if (moved_tree != NULL) {
+                int new_id = state.next_shard_id++;
+                responder_shard_t& moved = state.shards[new_id];
+                ParticleView moved_particles = moved_tree->getParticles();
+                moved.members.assign(moved_particles.begin(), moved_particles.end());
+                for (int id : moved.members) {
+                    state.shard_of[id] = new_id;
                 }
+                moved.mass = moved_tree->getMass();
+                moved.velocity = shard.velocity;
+                queue_tree(moved, moved_tree);
+            }
+            else {
+                release_particle(node->getColliders().second, shard.velocity);
+            }
+
+            if (kept_tree != NULL) {
+                ParticleView kept_particles = kept_tree->getParticles();
+                shard.members.assign(kept_particles.begin(), kept_particles.end());
+                shard.mass = kept_tree->getMass();
+                queue_tree(shard, kept_tree);
+            }
+            else {
+                release_particle(node->getColliders().first, shard.velocity);
+                state.shards.erase(shard_id);
             }
-            return state.loading_trees.end();
         }
 };
 
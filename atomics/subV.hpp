@@ -18,21 +18,24 @@ Responsibilities
 //#include <algorithm>  // max
 #include <map>
 #include <unordered_map>
-#include <nlohmann/json.hpp>
+#include <unordered_set>
+#include <memory>
 #include <boost/functional/hash.hpp>
 
 #include "../test/tags.hpp"  // debug tags
 #include "../utilities/vector_utils.hpp"  // vector functions
+#include "../utilities/checkpoint.hpp"  // checkpoint and restart
+#include "../utilities/checkpoint_clock.hpp"
 
 #include "../data_structures/message.hpp"
+#include "../data_structures/particle_store.hpp"
+#include "../data_structures/log_filter.hpp"
 
 #define DELTA_T_MAX 10000000  // value larger than any reasonable simulation runtime
 
 using namespace cadmium;
 using namespace std;
 
-using json = nlohmann::json;
-
 // Port definition
 struct SubV_defs {
     struct response_in : public in_port<tracker_message_t> {};
@@ -59,16 +62,19 @@ template<typename TIME> class SubV {
 
         struct state_type {
             // state information
-            json particle_data;  // particle_id, {postition, velocity, radius}  // needs information on last collision
+            shared_ptr<ParticleStore> particle_store;  // position, velocity and radius (subV owns the position, velocity and time columns)
             int subV_id;
             TIME next_internal;
             TIME current_time;  // current time within a subV module
-            map<int, float> particle_times;  // particle_id, time  // last event for each particle in a subV module
+            // the time of the last event of each particle (when its position was last set) is kept in the store
             collision_message_t next_collision;
             bool awaiting_response;  // whether or not subV has received a response from the responder (if not, do not preform further calculations until received)
             bool sending_collision;  // whether or not to send a collision (stop message sending is receiving an RI or a response message)
             unordered_map<pair<int, int>, float, boost::hash<pair<int, int>>> collisions_cache;  // cache collision times for non-inf times
+            vector<int> changed_velocities;  // particles whose velocity was set since the cache was last updated
             vector<logging_message_t> logging_messages;  // messages that store position for logging purposes
+            shared_ptr<LogFilter> log_filter;  // which logging messages to produce (every message if null)
+            resume_t<TIME> resume;  // time of the last transition (for checkpoints), and the restored times until the first transition
         };
         state_type state;
 
@@ -76,28 +82,30 @@ template<typename TIME> class SubV {
             if (DEBUG_SV) cout << "SubV default constructor called" << endl;
         }
 
-        SubV (json j) {
+        SubV (shared_ptr<ParticleStore> store, shared_ptr<LogFilter> log_filter = nullptr) {
             if (DEBUG_SV) cout << "SubV constructor called" << endl;
 
-            state.particle_data = j;
+            state.particle_store = store;
+            state.log_filter = log_filter;
+
+            // initialization (subV_id first, the init logging messages carry it)
+            // TODO: subV_id should be initialized or calculated from arguments
+            state.subV_id = 1;
 
             // for logging purposes, send messages reporting the initial states of every particle
             // one message for every particle
-            for (auto it = state.particle_data.begin(); it != state.particle_data.end(); ++it) {
-                state.logging_messages.push_back(
-                    logging_message_t(state.subV_id, stoi(it.key()), state.particle_data[it.key()]["velocity"], state.particle_data[it.key()]["position"], "init")
-                );
+            for (int p_id : store->ids()) {
+                log_particle(p_id, store->velocity(p_id), purpose_t::init);
             }
 
-            // initialization
-            // TODO: subV_id should be initialized or calculated from arguments
-            state.subV_id = 1;
             state.current_time = TIME();
             state.next_internal = TIME();
+            state.awaiting_response = false;
+            state.sending_collision = false;
 
             // initialize particle times
-            for (auto it = state.particle_data.begin(); it != state.particle_data.end(); ++it) {
-                state.particle_times[stoi(it.key())] = state.current_time;
+            for (int p_id : store->ids()) {
+                store->set_time(p_id, state.current_time);
             }
 
             // populate collision cache
@@ -107,6 +115,7 @@ template<typename TIME> class SubV {
         // internal transition
         void internal_transition () {
             if (DEBUG_SV) cout << "subV internal transition called" << endl;
+            state.resume.transition();
 
             // update the current time before doing work
             state.current_time += state.next_internal;  // next_internal was set by the previous call to int/ext transition
@@ -121,10 +130,15 @@ template<typename TIME> class SubV {
                 return;
             }
 
-            if (state.next_collision.positions.size() == 2) {
-                // update collision cache to incorporate new velocities from set of messages from the responder (do this before updating next_collision_data)
-                update_collision_cache(get_keys(state.next_collision.positions));  // TODO: account for walls (maybe use negative numbers?)
+            // update collision cache to incorporate new velocities from set of messages from the responder (do this before updating next_collision_data)
+            // the pair of the last collision was taken out of the cache, it is found again even if the collision did not happen
+            vector<int> updated = state.changed_velocities;
+            for (size_t i = 0; i < state.next_collision.size(); ++i) {
+                int p_id = state.next_collision.particle_ids[i];
+                if (find(updated.begin(), updated.end(), p_id) == updated.end()) updated.push_back(p_id);
             }
+            if (updated.size() > 0) update_collision_cache(updated);  // TODO: account for walls (maybe use negative numbers?)
+            state.changed_velocities.clear();
 
             // get the next collision
             next_collision_t next_collision_data = get_next_collision();
@@ -134,11 +148,11 @@ template<typename TIME> class SubV {
 
             // calculate positions but don't incorporate them until new velocities received
             // can't set until next_int (rather, when we get the corresponding velocity message back) in case RI sends a message (in which case, we throw away this calculation)
-            for (auto it = state.next_collision.positions.begin(); it != state.next_collision.positions.end(); ++it) {
-                state.next_collision.positions[it->first] = position(it->first, state.current_time + next_collision_data.time);
-                if (DEBUG_SV) cout << "subV internal transition: setting message position: " << VectorUtils::get_string<float>(state.next_collision.positions[it->first]) << endl;
+            for (size_t i = 0; i < state.next_collision.size(); ++i) {
+                state.next_collision.positions[i] = position(state.next_collision.particle_ids[i], state.current_time + next_collision_data.time);
+                if (DEBUG_SV) cout << "subV internal transition: setting message position: " << VectorUtils::get_string<float>(state.next_collision.positions[i]) << endl;
             }
-            assert(state.next_collision.positions.size() == 2 || state.next_collision.positions.size() == 0);  // 0 if inital call without receiving first
+            assert(state.next_collision.size() == 2 || state.next_collision.size() == 0);  // 0 if inital call without receiving first
 
             // set next_internal
             state.next_internal = next_collision_data.time;
@@ -151,6 +165,8 @@ template<typename TIME> class SubV {
         // external transition
         void external_transition (TIME e, typename make_message_bags<input_ports>::type mbs) {
             if (DEBUG_SV) cout << "subV external transition called" << endl;
+            if (state.resume.active) e = state.resume.elapsed();
+            state.resume.transition();
 
             state.awaiting_response = false;
             state.sending_collision = false;  // do not output a collision message if an external event is called between calls to internal transition and output
@@ -174,39 +190,40 @@ template<typename TIME> class SubV {
                     applicable_message_processed = true;
 
                     // Calculations should not be done here because, for collisions, there will be two associated messages received (one for each particle involved)
-                    // - Only particle_data information should be changed
+                    // - Only particle information should be changed
 
-                    if (DEBUG_SV) cout << "subV external transition: handling impulse: " << (x.purpose == "ri" ? "true" : "false") << endl;
+                    if (DEBUG_SV) cout << "subV external transition: handling impulse: " << (x.purpose == purpose_t::ri ? "true" : "false") << endl;
                     if (DEBUG_SV) cout << "subV external transition: handling type: " << x.purpose << endl;
                     if (DEBUG_SV) cout << "subV external transition: current time (subV_id: " << state.subV_id << "): " << state.current_time << endl;
 
                     // process each particle involved in the message
                     for (int particle_id : x.particle_ids) {
                         // set the position
-                        state.particle_data[to_string(particle_id)]["position"] = position(particle_id);
+                        state.particle_store->set_position(particle_id, position(particle_id));
                         //state.particle_data[to_string(x.particle_id)]["position"] = state.next_collision.positions[x.particle_id];  // cannot do this (RI messages will break this)
                         if (DEBUG_SV) cout << "subV external transition: received velocity: " << VectorUtils::get_string<float>(x.data)
-                                        << ", set position: " << VectorUtils::get_string<float>(state.particle_data[to_string(particle_id)]["position"]) << endl;
+                                        << ", set position: " << VectorUtils::get_string<float>(state.particle_store->position(particle_id)) << endl;
 
                         // update related time value for particle (last time position changed)
                         // must be updated after position is calculated
-                        state.particle_times[particle_id] = state.current_time;
+                        state.particle_store->set_time(particle_id, state.current_time);
 
                         if (DEBUG_SV && false) {
                             // report position to the command line
                             cout << "subV external transition: subV_id: " << state.subV_id
                                 << ", time: " << state.current_time
                                 << ", p_id: " << particle_id
-                                << ", position: " << VectorUtils::get_string<float>(state.particle_data[to_string(particle_id)]["position"]) <<endl;
+                                << ", position: " << VectorUtils::get_string<float>(state.particle_store->position(particle_id)) <<endl;
                         }
 
                         // incorporate newly received velocity
-                        state.particle_data[to_string(particle_id)]["velocity"] = x.data;
+                        state.particle_store->set_velocity(particle_id, x.data);
+                        if (find(state.changed_velocities.begin(), state.changed_velocities.end(), particle_id) == state.changed_velocities.end()) {
+                            state.changed_velocities.push_back(particle_id);
+                        }
 
                         // prepare logging messages
-                        state.logging_messages.push_back(
-                            logging_message_t(state.subV_id, particle_id, state.particle_data[to_string(particle_id)]["velocity"], state.particle_data[to_string(particle_id)]["position"], x.purpose)
-                        );
+                        log_particle(particle_id, x.data, x.purpose);
 
                         if (DEBUG_SV) cout << "subV external transition: new velocity set: (p_id: " << particle_id << ") " << VectorUtils::get_string<float>(x.data) << endl;
                     }
@@ -229,6 +246,7 @@ template<typename TIME> class SubV {
         // confluence transition
         void confluence_transition (TIME e, typename make_message_bags<input_ports>::type mbs) {
             if (DEBUG_SV) cout << "subV confluence transition called" << endl;
+            if (state.resume.active) e = state.resume.elapsed();  // before internal_transition ends the resume
             internal_transition();
             external_transition(e, move(mbs));
             if (DEBUG_SV) cout << "subV confluence transition finishing" << endl;
@@ -263,22 +281,133 @@ template<typename TIME> class SubV {
         // time advance function
         TIME time_advance () const {
             if (DEBUG_SV) cout << "subV time advance called/returning" << endl;
+            if (state.resume.active) return state.resume.advance();
             return state.next_internal;
         }
 
         friend ostringstream& operator<<(ostringstream& os, const typename SubV<TIME>::state_type& i) {
             if (DEBUG_SV) cout << "subV << called" << endl;
-            string result = "(sv_id:" + to_string(i.subV_id) + ") particles: ";
-            for (auto p_id = i.particle_data.begin(); p_id != i.particle_data.end(); ++p_id) {
-                result += "[(p_id:" + p_id.key() + "): ";
-                result += "pos" + VectorUtils::get_string<float>(i.particle_data[p_id.key()]["position"], true) + ", ";
-                result += "vel" + VectorUtils::get_string<float>(i.particle_data[p_id.key()]["velocity"], true) + "]";
+            TextBuffer& text = TextBuffer::local();
+            size_t start = text.size();
+            text << "(sv_id:" << i.subV_id << ") particles: ";
+            for (int p_id : i.particle_store->ids()) {
+                vector_view_t position = i.particle_store->position(p_id);
+                vector_view_t velocity = i.particle_store->velocity(p_id);
+                text << "[(p_id:" << p_id << "): pos";
+                text.append_values(position.data(), position.data() + position.size(), true);
+                text << ", vel";
+                text.append_values(velocity.data(), velocity.data() + velocity.size(), true);
+                text << "]";
             }
-            os << result;
+            text.flush_to(os, start);
             if (DEBUG_SV) cout << "subV << returning" << endl;
             return os;
         }
 
+        // the particles are saved with the store
+        // the collision cache is saved in iteration order with its number of buckets and restored by inserting in reverse,
+        // which gives the same iteration order
+        void save_checkpoint (CheckpointWriter& out) const {
+            out.put(state.subV_id);
+            out.put(state.next_internal);
+            out.put(state.current_time);
+            out.put(state.next_collision);
+            out.put(state.awaiting_response);
+            out.put(state.sending_collision);
+            out.put(state.logging_messages);
+            out.put(uint64_t(state.collisions_cache.bucket_count()));
+            out.put(vector<pair<pair<int, int>, float>>(state.collisions_cache.begin(), state.collisions_cache.end()));
+            out.put(state.changed_velocities);
+            if (state.log_filter) state.log_filter->save_checkpoint(out);
+        }
+
+        void restore_checkpoint (CheckpointReader& in) {
+            in.get(state.subV_id);
+            in.get(state.next_internal);
+            in.get(state.current_time);
+            in.get(state.next_collision);
+            in.get(state.awaiting_response);
+            in.get(state.sending_collision);
+            in.get(state.logging_messages);
+            uint64_t bucket_count;
+            vector<pair<pair<int, int>, float>> collisions;
+            in.get(bucket_count);
+            in.get(collisions);
+            state.collisions_cache = decltype(state.collisions_cache)(bucket_count);
+            for (auto it = collisions.rbegin(); it != collisions.rend(); ++it) state.collisions_cache.insert(*it);
+            in.get(state.changed_velocities);
+            if (state.log_filter) state.log_filter->restore_checkpoint(in);
+        }
+
+        // particles handed to or taken from the subV of another domain between two steps (see test/main_domain_test.cpp)
+        // both are an external event at the time of the step being simulated (CheckpointClock) that drops the collision
+        // subV was waiting for, the next collision is found again right away (as after a velocity message)
+        void remove_particles (const unordered_set<int>& p_ids) {
+            interrupt();
+            for (auto it = state.collisions_cache.begin(); it != state.collisions_cache.end();) {
+                if (p_ids.count(it->first.first) > 0 || p_ids.count(it->first.second) > 0) {
+                    it = state.collisions_cache.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+            if (state.next_collision.size() == 2 && (p_ids.count(state.next_collision.particle_ids[0]) > 0 || p_ids.count(state.next_collision.particle_ids[1]) > 0)) {
+                state.next_collision = collision_message_t();  // its pair has already been taken out of the cache
+            }
+            state.changed_velocities.erase(remove_if(state.changed_velocities.begin(), state.changed_velocities.end(),
+                                                     [&p_ids](int p_id) { return p_ids.count(p_id) > 0; }),
+                                           state.changed_velocities.end());
+        }
+
+        // the particle has been inserted into the store (with its position at its time)
+        void add_particle (int p_id) {
+            interrupt();
+            update_collision_cache({p_id});
+        }
+
+        // time until two particles at positions u moving at velocities v come within delta_blocking of each other
+        // (-1 if they do not), shared with the domain driver for particles of neighbouring domains
+        static TIME contact_time (const float* p1_u, const float* p1_v, const float* p2_u, const float* p2_v, size_t dim, float delta_blocking) {
+            if (delta_blocking == 0) return -1;  // check that both particles are not points
+
+            // assuming vector multiplication per element
+            // (summed in the same order as VectorUtils::sum, without allocating the intermediate vectors)
+            float a = 0;
+            float b = 0;
+            float c = 0;
+            for (size_t i = 0; i < dim; ++i) {
+                float p2_v_sub_p1_v = p2_v[i] - p1_v[i];
+                float p2_u_sub_p1_u = p2_u[i] - p1_u[i];
+                a += p2_v_sub_p1_v * p2_v_sub_p1_v;
+                b += p2_u_sub_p1_u * p2_v_sub_p1_v;
+                c += p2_u_sub_p1_u * p2_u_sub_p1_u;
+            }
+            b = 2 * b;
+            c = c - (delta_blocking * delta_blocking);
+
+            // assuming vector multiplication is the dot product
+            //float a = VectorUtils::sum(VectorUtils::dot_prod(p2_v_sub_p1_v, p2_v_sub_p1_v));
+            //float b = 2 * VectorUtils::sum(VectorUtils::dot_prod(p2_u_sub_p1_u, p2_v_sub_p1_v));
+            //float c = VectorUtils::sum(VectorUtils::dot_prod(p2_u_sub_p1_u, p2_u_sub_p1_u)) - (delta_blocking * delta_blocking);
+
+            if (DEBUG_SV) cout << "| a: " << a << ", b: " << b << ", c: " << c << endl;
+
+            float d = (b * b) - (4 * a * c);
+
+            // postive b indicates the particles are not heading toward each other while a negative d means there are no real solutions indicating the particles never cross paths
+            if (b >= 0 || d < 0) return -1;
+
+            float numer = max((-b) - sqrt(d), float(0));
+            float denom = 2 * a;
+
+            if (numer >= denom * DELTA_T_MAX) return -1;  // DELTA_T_MAX used to avoid divide-by-zero errors (needs to be larger than any reasonable simulation runtime)
+
+            if (DEBUG_SV) cout << "| next collision between particles: " << numer / denom << endl;
+
+            return numer / denom;  // time until the particles touch
+        }
+
     private:
 
         // contains information on the collision and the time at which it will happen
@@ -291,13 +420,12 @@ template<typename TIME> class SubV {
         void populate_collision_cache () {
             if (DEBUG_SV) cout << "subV populate_collision_cache called" << endl;
             TIME next_collision_time;
-            for (auto it1 = state.particle_data.begin(); it1 != state.particle_data.end(); ++it1) {
-                for (auto it2 = it1; it2 != state.particle_data.end(); ++it2) {
-                    if (*it1 != *it2) {
-                        next_collision_time = detect(stoi(it1.key()), stoi(it2.key()));
-                        if (next_collision_time < DELTA_T_MAX) {  // effectively checks that the time is not inf
-                            state.collisions_cache[make_pair(stoi(it1.key()), stoi(it2.key()))] = next_collision_time;  // do not need to add since this only happens in constructor
-                        }
+            const vector<int>& p_ids = state.particle_store->ids();
+            for (size_t i = 0; i < p_ids.size(); ++i) {
+                for (size_t j = i + 1; j < p_ids.size(); ++j) {
+                    next_collision_time = detect(p_ids[i], p_ids[j]);
+                    if (next_collision_time < DELTA_T_MAX) {  // effectively checks that the time is not inf
+                        state.collisions_cache[make_pair(p_ids[i], p_ids[j])] = next_collision_time;  // do not need to add since this only happens in constructor
                     }
                 }
             }
@@ -311,10 +439,10 @@ template<typename TIME> class SubV {
             pair<int, int> curr_ids;
 
             for (auto& it1 : p_ids) {
-                for (auto& it2 : state.particle_data.items()) {
-                    if (it1 == stoi(it2.key())) continue;
-                    next_collision_time = detect(it1, stoi(it2.key()));
-                    curr_ids = make_pair(it1, stoi(it2.key()));
+                for (int it2 : state.particle_store->ids()) {
+                    if (it1 == it2) continue;
+                    next_collision_time = detect(it1, it2);
+                    curr_ids = make_pair(it1, it2);
                     if (next_collision_time >= 0 && next_collision_time < DELTA_T_MAX) {
                         if (DEBUG_SV) cout << "subV update_collision_cache: adding pair: " << pair_string(curr_ids) << " with time " << state.current_time << " + " << next_collision_time << endl;
                         state.collisions_cache[curr_ids] = state.current_time + next_collision_time;
@@ -342,11 +470,11 @@ template<typename TIME> class SubV {
             int p1_id;
             int p2_id;
 
+            // collisions at the same time are taken in order of their particle IDs (whatever the order of the cache)
             for (auto& it : state.collisions_cache) {
-                if (it.second >= 0 && it.second - state.current_time < next_collision.time) {
-                    next_collision.collision.positions.clear();
-                    next_collision.collision.positions[it.first.first] = {};
-                    next_collision.collision.positions[it.first.second] = {};
+                bool tie = it.second - state.current_time == next_collision.time && it.first < make_pair(p1_id, p2_id);
+                if (it.second >= 0 && (it.second - state.current_time < next_collision.time || tie)) {
+                    next_collision.collision = collision_message_t(it.first.first, it.first.second);
                     if (DEBUG_SV) cout << "subV get_next_collision: next_collision_between: " << it.first.first << ", " << it.first.second << endl;
                     if (DEBUG_SV) cout << "subV get_next_collision: setting next_collision.time to: " << it.second << " - " << state.current_time << endl;
                     next_collision.time = it.second - state.current_time;
@@ -362,63 +490,62 @@ template<typename TIME> class SubV {
 
         // returns the time until a collision between p1_id and p2_id
         TIME detect (int p1_id, int p2_id) {
-            float delta_blocking = (float)state.particle_data[to_string(p1_id)]["radius"] + (float)state.particle_data[to_string(p2_id)]["radius"];
-            if (delta_blocking == 0) return -1;  // check that both particles are not points
-
-            vector<float> p1_u = position(p1_id);
-            vector<float> p2_u = position(p2_id);
-            vector<float> p1_v = state.particle_data[to_string(p1_id)]["velocity"];
-            vector<float> p2_v = state.particle_data[to_string(p2_id)]["velocity"];
-
-            vector<float> p2_v_sub_p1_v = VectorUtils::element_op(p2_v, p1_v, VectorUtils::subtract);
-            vector<float> p2_u_sub_p1_u = VectorUtils::element_op(p2_u, p1_u, VectorUtils::subtract);
-
-            // assuming vector multiplication per element
-            float a = VectorUtils::sum(VectorUtils::element_op(p2_v_sub_p1_v, p2_v_sub_p1_v, VectorUtils::multiply));
-            float b = 2 * VectorUtils::sum(VectorUtils::element_op(p2_u_sub_p1_u, p2_v_sub_p1_v, VectorUtils::multiply));
-            float c = VectorUtils::sum(VectorUtils::element_op(p2_u_sub_p1_u, p2_u_sub_p1_u, VectorUtils::multiply)) - (delta_blocking * delta_blocking);
-
-            // assuming vector multiplication is the dot product
-            //float a = VectorUtils::sum(VectorUtils::dot_prod(p2_v_sub_p1_v, p2_v_sub_p1_v));
-            //float b = 2 * VectorUtils::sum(VectorUtils::dot_prod(p2_u_sub_p1_u, p2_v_sub_p1_v));
-            //float c = VectorUtils::sum(VectorUtils::dot_prod(p2_u_sub_p1_u, p2_u_sub_p1_u)) - (delta_blocking * delta_blocking);
+            inline_vector_t p1_u = position(p1_id);
+            inline_vector_t p2_u = position(p2_id);
+            vector_view_t p1_v = state.particle_store->velocity(p1_id);
+            vector_view_t p2_v = state.particle_store->velocity(p2_id);
 
             if (DEBUG_SV) {
                 cout << "detection information:" << endl;
                 cout << "| IDs: p1: " << p1_id << ", p2: " << p2_id << endl;
                 cout << "| p1_u: " << VectorUtils::get_string<float>(p1_u) << ", p2_u: " << VectorUtils::get_string<float>(p2_u) << endl;
                 cout << "| p1_v: " << VectorUtils::get_string<float>(p1_v) << ", p2_v: " << VectorUtils::get_string<float>(p2_v) << endl;
-                cout << "| a: " << a << ", b: " << b << ", c: " << c << endl;
             }
 
-            float d = (b * b) - (4 * a * c);
-
-            // postive b indicates the particles are not heading toward each other while a negative d means there are no real solutions indicating the particles never cross paths
-            if (b >= 0 || d < 0) return -1;
-
-            float numer = max((-b) - sqrt(d), float(0));
-            float denom = 2 * a;
-
-            if (numer >= denom * DELTA_T_MAX) return -1;  // DELTA_T_MAX used to avoid divide-by-zero errors (needs to be larger than any reasonable simulation runtime)
-
-            if (DEBUG_SV) cout << "| next collision between particles: " << numer / denom << endl;
+            float delta_blocking = state.particle_store->radius(p1_id) + state.particle_store->radius(p2_id);
+            return contact_time(p1_u.data(), p1_v.data(), p2_u.data(), p2_v.data(), p1_u.size(), delta_blocking);
+        }
 
-            return numer / denom;  // time until next collision between p1_id and p2_id
+        // an external event without velocity messages
+        void interrupt () {
+            TIME e = state.resume.elapsed();
+            state.resume.transition();
+            state.current_time += e;
+            state.sending_collision = false;
+            // a collision already sent keeps subV waiting for its response, which finds the next collision
+            bool sent = state.awaiting_response && state.next_collision.size() == 2 && isinf(state.next_internal);
+            if (sent) return;
+            state.awaiting_response = false;
+            state.next_internal = 0;
         }
 
         // retrieve the position of a particle at a certain amount of time in the future
         // time is the time at which we want to know the particle's position
-        vector<float> position (int p_id, TIME time) {
-            TIME desired_time = time - state.particle_times[p_id];
-            vector <float> temp = VectorUtils::element_dist(state.particle_data[to_string(p_id)]["velocity"], desired_time, VectorUtils::multiply);
-            return VectorUtils::element_op(state.particle_data[to_string(p_id)]["position"], temp, VectorUtils::add);
+        inline_vector_t position (int p_id, TIME time) {
+            TIME desired_time = time - state.particle_store->time(p_id);
+            vector_view_t stored_position = state.particle_store->position(p_id);
+            vector_view_t velocity = state.particle_store->velocity(p_id);
+            inline_vector_t result;
+            result.dim = stored_position.size();
+            for (size_t i = 0; i < stored_position.size(); ++i) {
+                float temp = velocity[i] * desired_time;
+                result[i] = stored_position[i] + temp;
+            }
+            return result;
         }
 
         // retrieve the position of a particle at the current time
-        vector<float> position (int p_id) {
+        inline_vector_t position (int p_id) {
             return position(p_id, state.current_time);
         }
 
+        // queue a logging message with the stored position of a particle, unless the log filter rejects it
+        void log_particle (int p_id, const inline_vector_t& velocity, purpose_t purpose) {
+            vector_view_t stored_position = state.particle_store->position(p_id);
+            if (state.log_filter && !state.log_filter->accept(p_id, purpose, stored_position)) return;
+            state.logging_messages.push_back(logging_message_t(state.subV_id, p_id, velocity, stored_position, purpose));
+        }
+
         pair<int, int> make_pair (int p1_id, int p2_id) {
             return pair<int, int>(min(p1_id, p2_id), max(p1_id, p2_id));
         }
@@ -426,15 +553,6 @@ template<typename TIME> class SubV {
         string pair_string (pair<int, int>& p) {
             return "(" + to_string(p.first) + ", " + to_string(p.second) + ")";
         }
-
-        template<typename T, typename S>
-        vector<T> get_keys (map<T, S>& test) {
-            vector<T> results;
-            for (const auto& it : test) {
-                results.push_back(it.first);
-            }
-            return results;
-        }
 };
 
 #endif
\ No newline at end of file
@@ -18,6 +18,8 @@ Responsibilities
 
 #include "../test/tags.hpp"  // debug tags
 #include "../utilities/vector_utils.hpp"  // vector functions
+#include "../utilities/checkpoint.hpp"  // checkpoint and restart
+#include "../utilities/checkpoint_clock.hpp"
 
 #include "../data_structures/message.hpp"
 
@@ -61,6 +63,7 @@ template<typename TIME> class Tracker {
             //map<int, vector<int>> particle_data;
             vector<tracker_message_t> messages;
             map<int, vector<int>> particle_locations;  // particle_id, {subV_id}
+            resume_t<TIME> resume;  // time of the last transition (for checkpoints), and the restored times until the first transition
         };
         state_type state;
 
@@ -73,19 +76,22 @@ template<typename TIME> class Tracker {
                 {2, {1}},
                 {3, {1}}
             };
+            state.next_internal = numeric_limits<TIME>::infinity();  // passive until a velocity message arrives
         }
 
         // internal transition
         void internal_transition () {
             if (DEBUG_TR) cout << "tracker internal transition called" << endl;
+            state.resume.transition();
             state.messages.clear();
             state.next_internal = numeric_limits<TIME>::infinity();
             if (DEBUG_TR) cout << "tracker internal transition finishing" << endl;
         }
 
         // external transition
-        void external_transition (TIME e, typename make_message_bags<input_ports>::type mbs) {
+        void external_transition ([[maybe_unused]] TIME e, typename make_message_bags<input_ports>::type mbs) {
             if (DEBUG_TR) cout << "tracker external transition called" << endl;
+            state.resume.transition();
             if (DEBUG_TR && get_messages<typename Tracker_defs::response_in>(mbs).size() > 1) {
                 cout << "NOTE: Tracker received more than one concurrent message" << endl;
             }
@@ -122,21 +128,40 @@ template<typename TIME> class Tracker {
         // time advance function
         TIME time_advance () const {
             if (DEBUG_TR) cout << "tracker time advance called/returning" << endl;
+            if (state.resume.active) return state.resume.advance();
             return state.next_internal;
         }
 
         friend ostringstream& operator<<(ostringstream& os, const typename Tracker<TIME>::state_type& i) {
             if (DEBUG_TR) cout << "tracker << called" << endl;
-            string result = "";
+            TextBuffer& text = TextBuffer::local();
+            size_t start = text.size();
+            text << "velocity messages: ";
             // include information on which subV a particle is located in
-            for (auto msg : i.messages) {
-                result += "[(p_id:" + VectorUtils::get_string<int>(msg.particle_ids) + ", sv_ids:[" + VectorUtils::get_string<int>(msg.subV_ids) + "]) ";
-                result += VectorUtils::get_string<float>(msg.data, true) + "] ";
+            for (const auto& msg : i.messages) {
+                text << "[(p_id:";
+                text.append_values(msg.particle_ids.begin(), msg.particle_ids.end(), false);
+                text << ", sv_ids:[";
+                text.append_values(msg.subV_ids.begin(), msg.subV_ids.end(), false);
+                text << "]) ";
+                text.append_values(msg.data.begin(), msg.data.end(), true);
+                text << "] ";
             }
-            os << "velocity messages: " << result;
+            text.flush_to(os, start);
             if (DEBUG_TR) cout << "tracker << returning" << endl;
             return os;
         }
+
+        // particle_locations is rebuilt by the constructor
+        void save_checkpoint (CheckpointWriter& out) const {
+            out.put(state.next_internal);
+            out.put(state.messages);
+        }
+
+        void restore_checkpoint (CheckpointReader& in) {
+            in.get(state.next_internal);
+            in.get(state.messages);
+        }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,115 @@
+#ifndef TRAJECTORYLOGGER_HPP
+#define TRAJECTORYLOGGER_HPP
+
+/*
+Sink for the logging messages of subV (SubV_defs::logging_out) that writes them to a compact trajectory
+log (see utilities/trajectory.hpp and trajectory.py), optionally quantizing velocities and positions.
+Never produces outputs or internal events. Checkpoints keep its clock and count, a restarted run logs to a new file.
+*/
+
+#include <cadmium/modeling/ports.hpp>
+#include <cadmium/modeling/message_bag.hpp>
+
+#include <limits>
+#include <assert.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "../test/tags.hpp"  // debug tags
+#include "../utilities/checkpoint.hpp"  // checkpoint and restart
+#include "../utilities/checkpoint_clock.hpp"
+#include "../utilities/trajectory.hpp"
+
+#include "../data_structures/message.hpp"
+
+using namespace cadmium;
+using namespace std;
+
+// Port definition
+struct TrajectoryLogger_defs {
+    struct logging_in : public in_port<logging_message_t> {};
+};
+
+template<typename TIME> class TrajectoryLogger {
+    public:
+        // ports definition
+        using input_ports = tuple<typename TrajectoryLogger_defs::logging_in>;
+        using output_ports = tuple<>;
+
+        struct state_type {
+            TIME current_time;
+            uint64_t events;  // messages logged
+            resume_t<TIME> resume;  // time of the last transition (for checkpoints), and the restored times until the first transition
+        };
+        state_type state;
+
+        TrajectoryLogger () {
+            if (DEBUG_TL) cout << "TrajectoryLogger default constructor called" << endl;
+        }
+
+        // quanta of 0 log velocities and positions exactly
+        TrajectoryLogger (string log_path, int dim, float velocity_quantum, float position_quantum) {
+            if (DEBUG_TL) cout << "TrajectoryLogger constructor received path: " << log_path << endl;
+            log = make_shared<TrajectoryWriter>(log_path, dim, velocity_quantum, position_quantum);
+            this->dim = dim;
+            state.current_time = TIME();
+            state.events = 0;
+        }
+
+        // internal transition
+        void internal_transition () {
+            assert(false && "trajectory logger has no internal events");
+        }
+
+        // external transition
+        void external_transition (TIME e, typename make_message_bags<input_ports>::type mbs) {
+            if (state.resume.active) e = state.resume.elapsed();
+            state.resume.transition();
+            state.current_time += e;
+            const vector<logging_message_t>& messages = get_messages<typename TrajectoryLogger_defs::logging_in>(mbs);
+            if (DEBUG_TL) cout << "trajectory logger writing " << messages.size() << " message(s) at " << state.current_time << endl;
+            for (const logging_message_t& x : messages) {
+                assert((int)x.position.size() == dim && (int)x.velocity.size() == dim && "trajectory logger: message does not match the dimensions of the log");
+                log->write(state.current_time, x.particle_id, x.subV_id, (uint8_t)x.purpose, x.position.begin(), x.velocity.begin());
+                ++state.events;
+            }
+        }
+
+        // confluence transition
+        void confluence_transition (TIME e, typename make_message_bags<input_ports>::type mbs) {
+            external_transition(e, move(mbs));
+        }
+
+        // output function
+        typename make_message_bags<output_ports>::type output () const {
+            typename make_message_bags<output_ports>::type bags;
+            return bags;
+        }
+
+        // time advance function
+        TIME time_advance () const {
+            return numeric_limits<TIME>::infinity();
+        }
+
+        void save_checkpoint (CheckpointWriter& out) const {
+            out.put(state.current_time);
+            out.put(state.events);
+        }
+
+        void restore_checkpoint (CheckpointReader& in) {
+            in.get(state.current_time);
+            in.get(state.events);
+        }
+
+        friend ostringstream& operator<<(ostringstream& os, const typename TrajectoryLogger<TIME>::state_type& i) {
+            os << "events logged: " << i.events;
+            return os;
+        }
+
+    private:
+        shared_ptr<TrajectoryWriter> log;  // flushed when the last copy of the model is destroyed
+        int dim;
+};
+
+#endif
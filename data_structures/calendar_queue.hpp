@@ -0,0 +1,185 @@
+#ifndef CALENDAR_QUEUE_HPP
+#define CALENDAR_QUEUE_HPP
+
+#include <assert.h>
+#include <vector>
+#include <utility>  // contains pair
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+using namespace std;
+
+/*
+Calendar queue (R. Brown, "Calendar Queues: A Fast O(1) Priority Queue Implementation for the
+Simulation Event Set Problem", 1988) holding (id, time) pairs, earliest time first.
+
+Has the interface of the priority_queue it replaces (push, top, pop, empty, size). Events are
+hashed into buckets of a fixed time width ("days" of a "year"), each bucket is a sorted linked list,
+and the queue is dequeued by walking the buckets in time order. List nodes live in one pool and
+bucket heads are indices into it, so scanning buckets touches contiguous memory and resizing only
+relinks nodes. The number of buckets follows the number of events and the width is re-estimated
+from the spacing of the earliest events whenever the queue is resized, which keeps buckets short and
+gives amortized O(1) push and pop.
+Events with the same time are returned in order of id. TIME must be a floating point type.
+*/
+template <typename ID, typename TIME>
+class CalendarQueue {
+    public:
+        using value_type = pair<ID, TIME>;
+
+        CalendarQueue () : heads(min_buckets, npos), width(1), count(0), current_slot(0), cached(false), cached_bucket(0) {}
+
+        void push (const value_type& value) {
+            uint32_t index;
+            if (free_nodes.size() > 0) {
+                index = free_nodes.back();
+                free_nodes.pop_back();
+                nodes[index].value = value;
+            }
+            else {
+                index = nodes.size();
+                nodes.push_back(node_t{value, npos});
+            }
+            int64_t slot = slot_of(value.second);
+            link(index, bucket_of(slot));
+            ++count;
+
+            // an event earlier than the current position moves the search back
+            if (slot < current_slot) current_slot = slot;
+            if (cached && earlier(value, nodes[heads[cached_bucket]].value)) cached_bucket = bucket_of(slot);
+
+            if (count > 2 * heads.size()) resize(2 * heads.size());
+        }
+
+        const value_type& top () const {
+            assert(count > 0 && "CalendarQueue: top called on an empty queue");
+            return nodes[heads[find_min()]].value;
+        }
+
+        void pop () {
+            assert(count > 0 && "CalendarQueue: pop called on an empty queue");
+            size_t bucket = find_min();
+            uint32_t index = heads[bucket];
+            current_slot = slot_of(nodes[index].value.second);
+            heads[bucket] = nodes[index].next;
+            free_nodes.push_back(index);
+            --count;
+            cached = false;
+
+            if (heads.size() > min_buckets && count < heads.size() / 2) resize(heads.size() / 2);
+        }
+
+        bool empty () const {
+            return count == 0;
+        }
+
+        size_t size () const {
+            return count;
+        }
+
+        TIME bucket_width () const {
+            return width;
+        }
+
+        size_t num_buckets () const {
+            return heads.size();
+        }
+
+    private:
+        static constexpr size_t min_buckets = 2;
+        static constexpr size_t width_samples = 25;  // earliest events used to estimate the bucket width
+        static constexpr uint32_t npos = numeric_limits<uint32_t>::max();
+
+        struct node_t {
+            value_type value;
+            uint32_t next;  // next (later) node of the same bucket
+        };
+
+        vector<node_t> nodes;  // pool of list nodes
+        vector<uint32_t> free_nodes;  // unused nodes of the pool
+        vector<uint32_t> heads;  // earliest node of every bucket (number of buckets is a power of two)
+        TIME width;  // time covered by one bucket
+        size_t count;
+        int64_t current_slot;  // width-sized interval of time that the search starts from (never after the earliest event)
+        mutable bool cached;  // whether cached_bucket holds the earliest event
+        mutable size_t cached_bucket;
+
+        static bool earlier (const value_type& lhs, const value_type& rhs) {
+            return lhs.second < rhs.second || (lhs.second == rhs.second && lhs.first < rhs.first);
+        }
+
+        int64_t slot_of (TIME time) const {
+            return (int64_t)floor(time / width);
+        }
+
+        size_t bucket_of (int64_t slot) const {
+            return (size_t)slot & (heads.size() - 1);
+        }
+
+        // insert a node into its place in a bucket's list
+        void link (uint32_t index, size_t bucket) {
+            uint32_t* next = &heads[bucket];
+            while (*next != npos && !earlier(nodes[index].value, nodes[*next].value)) {
+                next = &nodes[*next].next;
+            }
+            nodes[index].next = *next;
+            *next = index;
+        }
+
+        // bucket holding the earliest event
+        size_t find_min () const {
+            if (cached) return cached_bucket;
+
+            // walk one year of buckets from the current slot, the first event that falls in the slot being looked at is the earliest
+            for (size_t i = 0; i < heads.size(); ++i) {
+                size_t bucket = bucket_of(current_slot + i);
+                if (heads[bucket] != npos && slot_of(nodes[heads[bucket]].value.second) <= current_slot + (int64_t)i) {
+                    cached = true;
+                    cached_bucket = bucket;
+                    return bucket;
+                }
+            }
+
+            // the next event is more than a year away, search every bucket directly
+            size_t best = heads.size();
+            for (size_t bucket = 0; bucket < heads.size(); ++bucket) {
+                if (heads[bucket] != npos && (best == heads.size() || earlier(nodes[heads[bucket]].value, nodes[heads[best]].value))) {
+                    best = bucket;
+                }
+            }
+            cached = true;
+            cached_bucket = best;
+            return best;
+        }
+
+        // change the number of buckets and estimate a new width from the earliest events
+        void resize (size_t num_buckets) {
+            vector<uint32_t> live;
+            live.reserve(count);
+            for (uint32_t head : heads) {
+                for (uint32_t index = head; index != npos; index = nodes[index].next) {
+                    live.push_back(index);
+                }
+            }
+
+            size_t samples = min(live.size(), width_samples);
+            partial_sort(live.begin(), live.begin() + samples, live.end(), [this](uint32_t lhs, uint32_t rhs) {
+                return earlier(nodes[lhs].value, nodes[rhs].value);
+            });
+            if (samples > 1) {
+                TIME separation = (nodes[live[samples - 1]].value.second - nodes[live[0]].value.second) / (samples - 1);
+                if (separation > 0) width = 3 * separation;
+            }
+
+            heads.assign(num_buckets, npos);
+            for (uint32_t index : live) {
+                link(index, bucket_of(slot_of(nodes[index].value.second)));
+            }
+            current_slot = (live.size() > 0) ? slot_of(nodes[live[0]].value.second) : 0;
+            cached = false;
+        }
+};
+
+#endif
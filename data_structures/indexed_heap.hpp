@@ -0,0 +1,164 @@
+#ifndef INDEXED_HEAP_HPP
+#define INDEXED_HEAP_HPP
+
+#include <assert.h>
+#include <vector>
+#include <limits>
+#include <cstddef>
+
+using namespace std;
+
+/*
+Binary heap that hands out a stable handle for every element.
+Handles stay valid until the element is erased, so elements can be erased or re-keyed in O(log n)
+without searching for them. The element for which compare(element, other) holds for every other
+element is at the top (a comparator that sorts ascending gives a min-heap).
+*/
+template <typename T, typename Compare>
+class IndexedHeap {
+    public:
+        using handle_t = size_t;
+
+        IndexedHeap () {}
+        IndexedHeap (Compare i_compare) : compare(i_compare) {}
+
+        // add an element, returns its handle
+        handle_t push (const T& value) {
+            handle_t handle;
+            if (free_handles.size() > 0) {
+                handle = free_handles.back();
+                free_handles.pop_back();
+                values[handle] = value;
+            }
+            else {
+                handle = values.size();
+                values.push_back(value);
+                positions.push_back(npos);
+            }
+            positions[handle] = heap.size();
+            heap.push_back(handle);
+            sift_up(heap.size() - 1);
+            return handle;
+        }
+
+        const T& top () const {
+            assert(heap.size() > 0 && "IndexedHeap: top called on an empty heap");
+            return values[heap[0]];
+        }
+
+        handle_t top_handle () const {
+            assert(heap.size() > 0 && "IndexedHeap: top_handle called on an empty heap");
+            return heap[0];
+        }
+
+        void pop () {
+            erase(top_handle());
+        }
+
+        // remove an element by handle (the handle may be reused by a later push)
+        void erase (handle_t handle) {
+            assert(contains(handle) && "IndexedHeap: erase called with an invalid handle");
+            size_t index = positions[handle];
+            size_t last = heap.size() - 1;
+            if (index != last) {
+                swap_nodes(index, last);
+            }
+            heap.pop_back();
+            positions[handle] = npos;
+            free_handles.push_back(handle);
+            if (index != last) {
+                restore(index);
+            }
+        }
+
+        // restore the ordering after the key of an element has changed
+        void update (handle_t handle) {
+            assert(contains(handle) && "IndexedHeap: update called with an invalid handle");
+            restore(positions[handle]);
+        }
+
+        const T& get (handle_t handle) const {
+            assert(contains(handle) && "IndexedHeap: get called with an invalid handle");
+            return values[handle];
+        }
+
+        bool contains (handle_t handle) const {
+            return handle < positions.size() && positions[handle] != npos;
+        }
+
+        size_t size () const {
+            return heap.size();
+        }
+
+        bool empty () const {
+            return heap.size() == 0;
+        }
+
+        void clear () {
+            heap.clear();
+            values.clear();
+            positions.clear();
+            free_handles.clear();
+        }
+
+        // elements in heap order (not sorted), mainly for debugging
+        vector<T> elements () const {
+            vector<T> result;
+            for (handle_t handle : heap) {
+                result.push_back(values[handle]);
+            }
+            return result;
+        }
+
+    private:
+        static constexpr size_t npos = numeric_limits<size_t>::max();
+
+        Compare compare;
+        vector<handle_t> heap;  // handles in heap order
+        vector<T> values;  // indexed by handle
+        vector<size_t> positions;  // indexed by handle, position in heap (npos if the handle is free)
+        vector<handle_t> free_handles;  // handles of erased elements
+
+        bool before (size_t i, size_t j) const {
+            return compare(values[heap[i]], values[heap[j]]);
+        }
+
+        void swap_nodes (size_t i, size_t j) {
+            swap(heap[i], heap[j]);
+            positions[heap[i]] = i;
+            positions[heap[j]] = j;
+        }
+
+        void restore (size_t index) {
+            if (index > 0 && before(index, (index - 1) / 2)) {
+                sift_up(index);
+            }
+            else {
+                sift_down(index);
+            }
+        }
+
+        void sift_up (size_t index) {
+            while (index > 0) {
+                size_t parent = (index - 1) / 2;
+                if (!before(index, parent)) break;
+                swap_nodes(index, parent);
+                index = parent;
+            }
+        }
+
+        void sift_down (size_t index) {
+            while (true) {
+                size_t best = index;
+                size_t left = 2 * index + 1;
+                size_t right = left + 1;
+                if (left < heap.size() && before(left, best)) best = left;
+                if (right < heap.size() && before(right, best)) best = right;
+                if (best == index) break;
+                swap_nodes(index, best);
+                index = best;
+            }
+        }
+};
+
+#endif
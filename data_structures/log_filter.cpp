@@ -0,0 +1,64 @@
+#include <string>
+#include <stdexcept>
+
+#include "log_filter.hpp"
+#include "../utilities/checkpoint.hpp"
+
+static purpose_t parse_purpose (const string& name) {
+    if (name == "init") return purpose_t::init;
+    if (name == "load") return purpose_t::load;
+    if (name == "rest") return purpose_t::rest;
+    if (name == "ri") return purpose_t::ri;
+    throw invalid_argument("LogFilter: unknown purpose: " + name + " (expected \"init\", \"load\", \"rest\" or \"ri\")");
+}
+
+LogFilter::LogFilter(json& config) : purposes(~0u), sample(1), seen(0) {
+    if (config.contains("particles")) {
+        for (int p_id : config["particles"]) particles.insert(p_id);
+    }
+    if (config.contains("regions")) {
+        for (json& box : config["regions"]) {
+            region_t region;
+            region.min = box["min"].get<vector<float>>();
+            region.max = box["max"].get<vector<float>>();
+            if (region.min.size() != region.max.size()) throw invalid_argument("LogFilter: region bounds must have the same dimensions");
+            regions.push_back(region);
+        }
+    }
+    if (config.contains("purposes")) {
+        purposes = 0;
+        for (const json& name : config["purposes"]) purposes |= 1u << (unsigned)parse_purpose(name);
+    }
+    if (config.contains("sample")) {
+        long long k = config["sample"];
+        if (k <= 0) throw invalid_argument("LogFilter: sample must be positive");
+        sample = k;
+    }
+}
+
+bool LogFilter::accept(int p_id, purpose_t purpose, vector_view_t position) {
+    if ((purposes & (1u << (unsigned)purpose)) == 0) return false;
+    if (!particles.empty() && particles.count(p_id) == 0) return false;
+    if (!regions.empty()) {
+        bool inside = false;
+        for (const region_t& region : regions) {
+            inside = region.min.size() == position.size();
+            for (size_t i = 0; i < position.size() && inside; ++i) {
+                inside = region.min[i] <= position[i] && position[i] <= region.max[i];
+            }
+            if (inside) break;
+        }
+        if (!inside) return false;
+    }
+    return seen++ % sample == 0;
+}
+
+void LogFilter::save_checkpoint(CheckpointWriter& out) const {
+    out.put(uint64_t(seen));
+}
+
+void LogFilter::restore_checkpoint(CheckpointReader& in) {
+    uint64_t saved;
+    in.get(saved);
+    seen = saved;
+}
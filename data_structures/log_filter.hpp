@@ -0,0 +1,45 @@
+#ifndef LOG_FILTER
+#define LOG_FILTER
+
+#include <vector>
+#include <unordered_set>
+#include <nlohmann/json.hpp>
+
+#include "message.hpp"
+
+using namespace std;
+
+using json = nlohmann::json;
+
+class CheckpointWriter;
+class CheckpointReader;
+
+/*
+Selects the logging messages of subV that are worth producing, so that rejected messages are never built
+or formatted. Built from the "log_filter" object of a config's "config" block, every key is optional:
+    "particles": [p_id, ...]                          only these particles
+    "regions": [{"min": [...], "max": [...]}, ...]    only positions inside one of these boxes (bounds included)
+    "purposes": ["init", "load", "rest", "ri"]        only these purposes
+    "sample": K                                       then only every K-th message that passed the criteria above
+A message is kept when it passes every given criterion. Sampling counts messages in the order subV produces them.
+Throws invalid_argument for an unknown purpose, a sample that is not positive or region bounds of different dimensions.
+*/
+class LogFilter {
+    public:
+        LogFilter (json& config);
+        bool accept (int p_id, purpose_t purpose, vector_view_t position);  // counts the message towards sampling
+        void save_checkpoint (CheckpointWriter& out) const;  // position in the sampling
+        void restore_checkpoint (CheckpointReader& in);
+    private:
+        struct region_t {
+            vector<float> min;
+            vector<float> max;
+        };
+        unordered_set<int> particles;  // empty for every particle
+        vector<region_t> regions;  // empty for everywhere
+        unsigned purposes;  // bit (1 << purpose) for every accepted purpose
+        unsigned long sample;  // keep 1 in sample
+        unsigned long seen;  // messages that passed the other criteria
+};
+
+#endif
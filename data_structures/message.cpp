@@ -6,13 +6,37 @@
 
 #include "message.hpp"
 
+/*** purpose_t ***/
+
+// Output stream
+const char* purpose_name (purpose_t purpose) {
+    switch (purpose) {
+        case purpose_t::init: return "init";
+        case purpose_t::load: return "load";
+        case purpose_t::rest: return "rest";
+        case purpose_t::ri: return "ri";
+        default: return "n/a";
+    }
+}
+
+// Output stream
+ostream& operator<< (ostream& os, purpose_t purpose) {
+    os << purpose_name(purpose);
+    return os;
+}
+
 /*** message_t ***/
 
 // Output stream
 ostream& operator<< (ostream& os, const message_t& msg) {
-    string result = "(p_ids:" + VectorUtils::get_string<int>(msg.particle_ids) + "): [";
-    result += VectorUtils::get_string<float>(msg.data, true);
-    os << result + ", type: " << msg.purpose << "]";
+    TextBuffer& text = TextBuffer::local();
+    size_t start = text.size();
+    text << "(p_ids:";
+    text.append_values(msg.particle_ids.begin(), msg.particle_ids.end(), false);
+    text << "): [";
+    text.append_values(msg.data.begin(), msg.data.end(), true);
+    text << ", type: " << purpose_name(msg.purpose) << "]";
+    text.flush_to(os, start);
     return os;
 }
 
@@ -29,9 +53,14 @@ istream& operator>> (istream& is, message_t& msg) {
 
 // Output stream
 ostream& operator<< (ostream& os, const tracker_message_t& msg) {
-    string result = "(p_ids:" + VectorUtils::get_string<int>(msg.particle_ids) + "): [";
-    result += VectorUtils::get_string<float>(msg.data, true);
-    os << result + ", type: " << msg.purpose << "]";
+    TextBuffer& text = TextBuffer::local();
+    size_t start = text.size();
+    text << "(p_ids:";
+    text.append_values(msg.particle_ids.begin(), msg.particle_ids.end(), false);
+    text << "): [";
+    text.append_values(msg.data.begin(), msg.data.end(), true);
+    text << ", type: " << purpose_name(msg.purpose) << "]";
+    text.flush_to(os, start);
     return os;
 }
 
@@ -48,14 +77,29 @@ istream& operator>> (istream& is, tracker_message_t& msg) {
 
 // Output stream
 ostream& operator<< (ostream& os, const collision_message_t& msg) {
-    string result = "";
-    for (const auto& [key, val] : msg.positions) {
-        result += "[(p_id:" + to_string(key) + "): " + VectorUtils::get_string<float>(val, true) + "]";
+    TextBuffer& text = TextBuffer::local();
+    size_t start = text.size();
+    for (size_t i = 0; i < msg.size(); ++i) {
+        text << "[(p_id:" << msg.particle_ids[i] << "): ";
+        text.append_values(msg.positions[i].begin(), msg.positions[i].end(), true);
+        text << "]";
     }
-    os << result;
+    text.flush_to(os, start);
     return os;
 }
 
+// Comparison (same order as the map of positions that collisions used to be)
+bool operator< (const collision_message_t& lhs, const collision_message_t& rhs) {
+    for (size_t i = 0; i < min(lhs.size(), rhs.size()); ++i) {
+        if (lhs.particle_ids[i] != rhs.particle_ids[i]) return lhs.particle_ids[i] < rhs.particle_ids[i];
+        const inline_vector_t& l = lhs.positions[i];
+        const inline_vector_t& r = rhs.positions[i];
+        if (lexicographical_compare(l.begin(), l.end(), r.begin(), r.end())) return true;
+        if (lexicographical_compare(r.begin(), r.end(), l.begin(), l.end())) return false;
+    }
+    return lhs.size() < rhs.size();
+}
+
 // Input stream
 istream& operator>> (istream& is, collision_message_t& msg) {
     // incomplete
@@ -66,13 +110,18 @@ istream& operator>> (istream& is, collision_message_t& msg) {
 
 // Output stream
 ostream& operator<< (ostream& os, const logging_message_t& msg) {
-    os << "[";
-    os << "subV_id: " << msg.subV_id;
-    os << ", p_id: " << msg.particle_id;
-    os << ", vel: " << VectorUtils::get_string<float>(msg.velocity, true);
-    os << ", pos: " << VectorUtils::get_string<float>(msg.position, true);
-    os << ", type: " << msg.purpose;
-    os << "]";
+    TextBuffer& text = TextBuffer::local();
+    size_t start = text.size();
+    text << "[";
+    text << "subV_id: " << msg.subV_id;
+    text << ", p_id: " << msg.particle_id;
+    text << ", vel: ";
+    text.append_values(msg.velocity.begin(), msg.velocity.end(), true);
+    text << ", pos: ";
+    text.append_values(msg.position.begin(), msg.position.end(), true);
+    text << ", type: " << purpose_name(msg.purpose);
+    text << "]";
+    text.flush_to(os, start);
     return os;
 }
 
@@ -5,28 +5,115 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <map>
+#include <cstdint>
+#include <initializer_list>
+#include <algorithm>  // copy, lexicographical_compare
 
 #include "../utilities/vector_utils.hpp"  // vector functions
 
 using namespace std;
 
+#define MESSAGE_MAX_DIM 3  // largest number of dimensions a message can carry (the models support 1 to 3)
+
+/*
+The message types below are laid out inline (no member allocates, except particle ID lists longer than
+id_list_t::inline_capacity) since every event creates several of them and Cadmium copies them through bags.
+*/
+
+// purpose of a message (mainly used for logging)
+enum class purpose_t : uint8_t {
+    none,  // printed as "n/a"
+    init,  // initial state of a particle
+    load,  // loading velocity after a collision
+    rest,  // restitution velocity
+    ri  // random impulse
+};
+
+// vector of up to MESSAGE_MAX_DIM floats stored inline
+// converts to and from vector<float> so that it can be used with VectorUtils, and copies from a vector_view_t
+struct inline_vector_t {
+    inline_vector_t () : dim(0) {}
+    inline_vector_t (const vector<float>& v) { assign(v.data(), v.data() + v.size()); }
+    inline_vector_t (vector_view_t v) { assign(v.begin(), v.end()); }
+    inline_vector_t (initializer_list<float> v) { assign(v.begin(), v.end()); }
+
+    void assign (const float* first, const float* last) {
+        assert(last - first <= MESSAGE_MAX_DIM && "inline_vector_t: too many dimensions");
+        dim = last - first;
+        copy(first, last, values);
+    }
+
+    size_t size () const { return dim; }
+    const float* data () const { return values; }
+    const float* begin () const { return values; }
+    const float* end () const { return values + dim; }
+    float operator[] (size_t i) const { return values[i]; }
+    float& operator[] (size_t i) { return values[i]; }
+    operator vector<float> () const { return vector<float>(begin(), end()); }
+
+    float values[MESSAGE_MAX_DIM] = {};
+    uint8_t dim;
+};
+
+// list of particle IDs, stored inline when there are at most inline_capacity of them (ex. a single particle or a small cluster)
+class id_list_t {
+    public:
+        static constexpr size_t inline_capacity = 4;
+
+        id_list_t () : count(0) {}
+        id_list_t (const vector<int>& ids) { assign(ids.data(), ids.data() + ids.size()); }
+        id_list_t (initializer_list<int> ids) { assign(ids.begin(), ids.end()); }
+
+        void assign (const int* first, const int* last) {
+            count = last - first;
+            if (count <= inline_capacity) {
+                copy(first, last, local);
+                spilled.clear();
+            }
+            else {
+                spilled.assign(first, last);
+            }
+        }
+
+        void push_back (int id) {
+            if (count < inline_capacity) {
+                local[count] = id;
+            }
+            else {
+                if (count == inline_capacity) spilled.assign(local, local + inline_capacity);
+                spilled.push_back(id);
+            }
+            ++count;
+        }
+
+        size_t size () const { return count; }
+        const int* begin () const { return (count <= inline_capacity) ? local : spilled.data(); }
+        const int* end () const { return begin() + count; }
+        int operator[] (size_t i) const { return begin()[i]; }
+        operator vector<int> () const { return vector<int>(begin(), end()); }
+
+    private:
+        size_t count;
+        int local[inline_capacity] = {};
+        vector<int> spilled;  // every ID once there are more than inline_capacity (empty otherwise)
+};
+
 /*
 Used to transport impulses (typically only when sent from the random impulse module) or velocities.
 Members:
 - data: impulse or velocity
 - particle_ids: vector of particles the data applies to
-- purpose: informs on the purpose of the message (ex. "load", "rest", "ri")
+- purpose: informs on the purpose of the message (ex. load, rest, ri)
 */
 struct message_t {
-    message_t () : data({}), particle_ids({}), purpose("n/a") {}
-    message_t (vector<float> i_data) : data(i_data), particle_ids({}), purpose("n/a") {}
-    message_t (vector<float> i_data, vector<int> i_particle_ids) : data(i_data), particle_ids(i_particle_ids), purpose("n/a") {}
-    message_t (vector<float> i_data, vector<int> i_particle_ids, string i_purpose) : data(i_data), particle_ids(i_particle_ids), purpose(i_purpose) {}
-
-    vector<float> data;  // impulse or vecocity
-    vector<int> particle_ids;
-    string purpose;
+    message_t () : purpose(purpose_t::none) {}
+    message_t (inline_vector_t i_data) : data(i_data), purpose(purpose_t::none) {}
+    message_t (inline_vector_t i_data, id_list_t i_particle_ids) : data(i_data), particle_ids(i_particle_ids), purpose(purpose_t::none) {}
+    message_t (inline_vector_t i_data, id_list_t i_particle_ids, purpose_t i_purpose) : data(i_data), particle_ids(i_particle_ids), purpose(i_purpose) {}
+
+    inline_vector_t data;  // impulse or vecocity
+    id_list_t particle_ids;
+    purpose_t purpose;
 };
 
 /*
@@ -36,25 +123,38 @@ Members:
 */
 struct tracker_message_t : message_t {
     tracker_message_t () {}
-    tracker_message_t (vector<float> i_data, vector<int> i_particle_ids, vector<int> i_subV_ids) :
+    tracker_message_t (inline_vector_t i_data, id_list_t i_particle_ids, id_list_t i_subV_ids) :
             message_t(i_data, i_particle_ids), subV_ids(i_subV_ids) {}
-    tracker_message_t (message_t msg, vector<int> i_subV_ids) :
-            message_t(msg.data, msg.particle_ids, msg.purpose), subV_ids(i_subV_ids) {}
+    tracker_message_t (const message_t& msg, id_list_t i_subV_ids) :
+            message_t(msg), subV_ids(i_subV_ids) {}
 
-    vector<int> subV_ids;
+    id_list_t subV_ids;
 };
 
 /*
 Used to inform the responder of collisions between particles.
 Members:
-- positions: the IDs and positions of the particles that are colliding (should always have exactly two elements)
+- particle_ids: the particles that are colliding, in increasing order of ID
+- positions: the position of each particle when they collide
+A collision has exactly two particles, an uninitialized message has none.
 */
 struct collision_message_t {
-    collision_message_t () {}
+    collision_message_t () : count(0) {}
+    collision_message_t (int p1_id, int p2_id) : count(2) {
+        particle_ids[0] = min(p1_id, p2_id);
+        particle_ids[1] = max(p1_id, p2_id);
+    }
 
-    map<int, vector<float>> positions;
+    size_t size () const { return count; }
+
+    int count;  // number of particles (0 or 2)
+    int particle_ids[2];
+    inline_vector_t positions[2];
 };
 
+// orders collisions by particle IDs, then by positions
+bool operator< (const collision_message_t& lhs, const collision_message_t& rhs);
+
 /*
 Used to log the velocities and positions of particles that have been updated.
 Members:
@@ -64,17 +164,20 @@ Members:
 - position: the particle's position
 */
 struct logging_message_t {
-    logging_message_t () : subV_id(-1), particle_id(-1), velocity({}), position({}) {}
-    logging_message_t (int i_subV_id, int i_particle_id, vector<float> i_velocity, vector<float> i_position, string i_purpose) :
+    logging_message_t () : subV_id(-1), particle_id(-1), purpose(purpose_t::none) {}
+    logging_message_t (int i_subV_id, int i_particle_id, inline_vector_t i_velocity, inline_vector_t i_position, purpose_t i_purpose) :
         subV_id(i_subV_id), particle_id(i_particle_id), velocity(i_velocity), position(i_position), purpose(i_purpose) {}
 
     int subV_id;
     int particle_id;
-    vector<float> velocity;
-    vector<float> position;
-    string purpose;
+    inline_vector_t velocity;
+    inline_vector_t position;
+    purpose_t purpose;
 };
 
+const char* purpose_name (purpose_t purpose);  // as printed in the logs
+ostream& operator<< (ostream& os, purpose_t purpose);
+
 istream& operator>> (istream& is, message_t& msg);
 ostream& operator<< (ostream& os, const message_t& msg);
 
@@ -1,15 +1,38 @@
 #include "node.hpp"
+#include "../utilities/text_format.hpp"
 
 Node::Node() {
-    //
-}
-
-Node::Node(int p1, int p2, float mass, float time, vector<float> impulse) {
+    parent = NULL;
+    root_hint = NULL;
+    hint_version = 0;
+    structure_version = NULL;
+    collider_children[0] = NULL;
+    collider_children[1] = NULL;
+    own_members[0] = {0, NULL};
+    own_members[1] = {0, NULL};
+    members_first = NULL;
+    members_last = NULL;
+    num_members = 0;
+    restitutionTime = 0;
+    mass = 0;
+}
+
+Node::Node(int p1, int p2, float mass, float time, vector<float> impulse, unsigned long* structure_version) {
     //colliders = minmax(p1, p2);
     colliders = {p1, p2};
     restitutionTime = time;
     this->impulse = impulse;
-    particles.insert({p1, p2});
+    parent = NULL;
+    root_hint = NULL;
+    hint_version = 0;
+    this->structure_version = structure_version;
+    collider_children[0] = NULL;
+    collider_children[1] = NULL;
+    own_members[0] = {p1, &own_members[1]};
+    own_members[1] = {p2, NULL};
+    members_first = &own_members[0];
+    members_last = &own_members[1];
+    num_members = 2;
     this->mass = mass;
 }
 
@@ -17,66 +40,86 @@ Node::~Node() {
     // we do not want to deallocate child nodes (they must do it themselves)
 }
 
+// the collider children are found by searching the particles of the children
 void Node::addChild(Node* node) {
-    children.push_back(node);
-    adjustTime(this->restitutionTime, node);  // adjust the child and all of its descendants
-    for (int pID : node->particles) {
-        particles.insert(pID);
-    }
+    addChildren({node});
 }
 
 void Node::addChildren(vector<Node*> nodes) {
     for (Node* node : nodes) {
-        addChild(node);
+        children.push_back(node);
+        node->parent = this;  // the child and all of its descendants now take their restitution time from this tree
     }
+    collider_children[0] = NULL;
+    collider_children[1] = NULL;
+    for (Node* child : children) {
+        ParticleView view = child->getParticles();
+        if (view.contains(colliders.first)) collider_children[0] = child;
+        if (view.contains(colliders.second)) collider_children[1] = child;
+    }
+    linkMembers();
 }
 
-vector<Node*> Node::getChildren() {
+void Node::addColliderChildren(Node* first_child, Node* second_child) {
+    collider_children[0] = first_child;
+    collider_children[1] = second_child;
+    for (Node* node : collider_children) {
+        if (node == NULL) continue;
+        children.push_back(node);
+        node->parent = this;
+    }
+    linkMembers();
+}
+
+const vector<Node*>& Node::getChildren() const {
     return children;
 }
 
 // associate each child node with its collider
-unordered_map<int, Node*> Node::getChildAssociations() {
-    unordered_map<int, Node*> associations;
-    vector<int> colliders_list = {colliders.first, colliders.second};
-
-    for (int curr_collider : colliders_list) {
-        for (Node* child : children) {
-            if (associations.find(curr_collider) == associations.end()) {
-                for (int pID : child->particles) {
-                    if (pID == curr_collider) {
-                        associations[curr_collider] = child;
-                        break;
-                    }
-                }
-            }
-        }
-
-        if (associations.find(curr_collider) == associations.end()) {
-            associations[curr_collider] = NULL;
-        }
-    }
+unordered_map<int, Node*> Node::getChildAssociations() const {
+    return {{colliders.first, collider_children[0]}, {colliders.second, collider_children[1]}};
+}
 
-    return associations;
+// the child containing one of the colliders (NULL if the collider is not in a child)
+Node* Node::getChildOf(int collider) const {
+    return (collider == colliders.first) ? collider_children[0] : collider_children[1];
 }
 
-int Node::numChildren() {
+int Node::numChildren() const {
     return children.size();
 }
 
+Node* Node::getParent() const {
+    return parent;
+}
+
+// make every child the root of its own tree, keeping the restitution time they inherited (called before a node is released)
+void Node::detachChildren() {
+    float time = getRest();
+    for (Node* child : children) {
+        child->restitutionTime = time;
+        child->parent = NULL;
+    }
+    children.clear();
+    collider_children[0] = NULL;
+    collider_children[1] = NULL;
+    if (structure_version != NULL) ++*structure_version;
+}
+
+// set the restitution time of the whole tree containing this node
 void Node::setRest(float time) {
-    restitutionTime = time;
+    findRoot()->restitutionTime = time;
 }
 
 float Node::getRest() const {
-    return restitutionTime;
+    return findRoot()->restitutionTime;
 }
 
-unordered_set<int> Node::getParticles() const {
-    return particles;
+ParticleView Node::getParticles() const {
+    return ParticleView(members_first, members_last, num_members);
 }
 
-vector<float> Node::getImpulse() const {
+const vector<float>& Node::getImpulse() const {
     return impulse;
 }
 
@@ -88,31 +131,77 @@ pair<int, int> Node::getColliders() const {
     return colliders;
 }
 
-void Node::adjustTime(float time, Node* node) {
-    node->restitutionTime = time;
-    for (Node* curr_node : node->getChildren()) {
-        adjustTime(time, curr_node);
+// walk up the tree, jumping to hints that are still valid, then walk the same path again and point every visited
+// node at the root
+Node* Node::findRoot() const {
+    auto next = [this](const Node* node) {
+        if (structure_version != NULL && node->root_hint != NULL && node->hint_version == *structure_version) {
+            return (const Node*)node->root_hint;
+        }
+        return (const Node*)node->parent;
+    };
+    const Node* curr_node = this;
+    while (curr_node->parent != NULL) {
+        curr_node = next(curr_node);
+    }
+    Node* root = const_cast<Node*>(curr_node);
+    if (structure_version == NULL) return root;
+    for (const Node* node = this; node != root; ) {
+        const Node* following = next(node);
+        node->root_hint = root;
+        node->hint_version = *structure_version;
+        node = following;
     }
+    return root;
+}
+
+// chain the ranges of the children and the colliders that are not in a child
+// the ranges of the descendants are unchanged (only the next link of the last member of a range is rewritten, which
+// belongs to the enclosing range)
+void Node::linkMembers() {
+    member_t* last = NULL;
+    members_first = NULL;
+    num_members = 0;
+    auto append = [&](member_t* first, member_t* range_last, size_t count) {
+        if (last == NULL) members_first = first;
+        else last->next = first;
+        last = range_last;
+        num_members += count;
+    };
+
+    for (Node* child : children) {
+        append(child->members_first, child->members_last, child->num_members);
+    }
+    own_members[0].id = colliders.first;
+    own_members[1].id = colliders.second;
+    if (collider_children[0] == NULL) append(&own_members[0], &own_members[0], 1);
+    if (collider_children[1] == NULL) append(&own_members[1], &own_members[1], 1);
+
+    last->next = NULL;
+    members_last = last;
 }
 
 bool operator< (const Node& lhs, const Node& rhs) {
-    return lhs.restitutionTime < rhs.restitutionTime;
+    return lhs.getRest() < rhs.getRest();
 }
 
 ostream& operator<< (ostream& os, const Node& node) {
-    os << "head=(" + to_string(node.colliders.first) + "," + to_string(node.colliders.second);
-    os << "), mass=" + to_string(node.mass);
-    os << ", time=" + to_string(node.restitutionTime);
-    os << ", child nodes={";
+    TextBuffer& text = TextBuffer::local();
+    size_t start = text.size();
+    text << "head=(" << node.colliders.first << "," << node.colliders.second;
+    text << "), mass=" << node.mass;
+    text << ", time=" << node.getRest();
+    text << ", child nodes={";
     for (Node* child : node.children) {
-        os << "(" + to_string(child->colliders.first) + "," + to_string(child->colliders.second) + ")";
-        os << " ";
+        text << "(" << child->colliders.first << "," << child->colliders.second << ")";
+        text << " ";
     }
-    os << "}, all particles={";
-    for (int id : node.particles) {
-        os << id;
-        os << " ";
+    text << "}, all particles={";
+    for (int id : node.getParticles()) {
+        text << id;
+        text << " ";
     }
-    os << "}";
+    text << "}";
+    text.flush_to(os, start);
     return os;
 }
\ No newline at end of file
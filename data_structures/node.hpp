@@ -3,38 +3,97 @@
 
 #include <iostream>
 #include <vector>
+#include <cstddef>  // ptrdiff_t
+#include <iterator>  // forward_iterator_tag
 #include <algorithm>
 #include <unordered_set>
 #include <unordered_map>
 
 using namespace std;
 
+// particle id in the members of a node, linked to the next particle of the tree that contains it
+struct member_t {
+    int id;
+    member_t* next;
+};
+
+// read-only view of the particle ids of a node (valid until the tree containing the node is changed)
+class ParticleView {
+    public:
+        class iterator {
+            public:
+                using iterator_category = forward_iterator_tag;
+                using value_type = int;
+                using difference_type = ptrdiff_t;
+                using pointer = const int*;
+                using reference = const int&;
+                iterator (const member_t* curr, const member_t* last) : curr(curr), last(last) {}
+                const int& operator* () const { return curr->id; }
+                iterator& operator++ () { curr = (curr == last) ? NULL : curr->next; return *this; }
+                bool operator== (const iterator& other) const { return curr == other.curr; }
+                bool operator!= (const iterator& other) const { return curr != other.curr; }
+            private:
+                const member_t* curr;
+                const member_t* last;  // the next link of the last member belongs to the enclosing tree
+        };
+        ParticleView () : first(NULL), last(NULL), count(0) {}
+        ParticleView (const member_t* first, const member_t* last, size_t count) : first(first), last(last), count(count) {}
+        iterator begin () const { return iterator(first, last); }
+        iterator end () const { return iterator(NULL, last); }
+        size_t size () const { return count; }
+        bool contains (int id) const { return find(begin(), end(), id) != end(); }
+    private:
+        const member_t* first;
+        const member_t* last;
+        size_t count;
+};
+
 class Node {
     public:
         Node ();
-        Node (int p1, int p2, float mass, float time, vector<float> impulse);
+        Node (int p1, int p2, float mass, float time, vector<float> impulse, unsigned long* structure_version = NULL);  // see structure_version
         ~Node ();
+        Node (const Node&) = delete;  // the members of a node link to each other and to its children's
+        Node& operator= (const Node&) = delete;
         void addChild (Node* node);
         void addChildren (vector<Node*> nodes);
-        vector<Node*> getChildren ();
-        unordered_map<int, Node*> getChildAssociations ();
-        int numChildren ();
+        void addColliderChildren (Node* first_child, Node* second_child);  // the trees containing each collider (NULL if it is alone), without searching them
+        const vector<Node*>& getChildren () const;
+        unordered_map<int, Node*> getChildAssociations () const;
+        Node* getChildOf (int collider) const;
+        int numChildren () const;
+        Node* getParent () const;
+        void detachChildren ();
         void setRest (float time);
         float getRest () const;
-        unordered_set<int> getParticles () const;
-        vector<float> getImpulse () const;
+        ParticleView getParticles () const;
+        const vector<float>& getImpulse () const;
         float getMass () const;
         pair<int, int> getColliders () const;
         friend bool operator< (const Node& lhs, const Node& rhs);
         friend ostream& operator<< (ostream& os, const Node& node);
     private:
         pair<int, int> colliders;  // the two particles that collided (min, max)
+        Node* collider_children[2];  // child containing each collider (NULL if the collider is not in a child)
         vector<Node*> children;  // child nodes
-        unordered_set<int> particles;  // particles related to this node and its descendants
+        Node* parent;  // NULL for the root of a tree
+        // path compression for finding the root: an ancestor found by an earlier search and the structure version it was found in
+        mutable Node* root_hint;
+        mutable unsigned long hint_version;
+        // shared by the nodes of one owner (NodePool) and changed whenever one of them is detached (hints from older
+        // versions may point to released nodes), NULL for a node without an owner (no hints are kept)
+        unsigned long* structure_version;
+        // particles related to this node and its descendants, as a linked range: the ranges of its children followed by
+        // its colliders that are not in a child (own_members), so that merging trees only links the ends of their ranges
+        member_t own_members[2];
+        member_t* members_first;
+        member_t* members_last;
+        size_t num_members;
         vector<float> impulse;  // impulse associated with the collision that created the node
-        float restitutionTime;  // the time that resitution happens at (according to the responder)
+        float restitutionTime;  // the time that resitution happens at (according to the responder), only used at the root of a tree
         float mass;  // mass of this node and its descendants
-        void adjustTime (float time, Node* node);  // adjust time of all descendant nodes
+        Node* findRoot () const;  // root of the tree containing this node (descendants inherit its restitution time)
+        void linkMembers ();  // link the ranges of the children and the colliders that are not in a child (O(number of children))
 };
 
 #endif
\ No newline at end of file
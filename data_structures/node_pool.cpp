@@ -0,0 +1,49 @@
+#include <new>  // placement new
+
+#include "node_pool.hpp"
+
+NodePool::NodePool(size_t block_size) {
+    this->block_size = block_size;
+    in_use = 0;
+    structure_version = 0;
+}
+
+NodePool::~NodePool() {
+    for (unique_ptr<slot_t[]>& block : blocks) {
+        for (size_t i = 0; i < block_size; ++i) {
+            if (block[i].in_use) {
+                reinterpret_cast<Node*>(block[i].storage)->~Node();
+            }
+        }
+    }
+}
+
+Node* NodePool::create(int p1, int p2, float mass, float time, vector<float> impulse) {
+    if (free_slots.size() == 0) {
+        blocks.emplace_back(new slot_t[block_size]);
+        slot_t* block = blocks.back().get();
+        for (size_t i = block_size; i > 0; --i) {
+            block[i - 1].in_use = false;
+            free_slots.push_back(&block[i - 1]);
+        }
+    }
+    slot_t* slot = free_slots.back();
+    free_slots.pop_back();
+    Node* node = new (slot->storage) Node(p1, p2, mass, time, impulse, &structure_version);
+    slot->in_use = true;
+    ++in_use;
+    return node;
+}
+
+void NodePool::release(Node* node) {
+    slot_t* slot = reinterpret_cast<slot_t*>(node);  // storage is the first member of a slot
+    node->detachChildren();
+    node->~Node();
+    slot->in_use = false;
+    free_slots.push_back(slot);
+    --in_use;
+}
+
+size_t NodePool::size() const {
+    return in_use;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef NODE_POOL
+#define NODE_POOL
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+#include "node.hpp"
+
+using namespace std;
+
+/*
+Owner of the loading tree nodes of a responder.
+Nodes are constructed in fixed-size blocks and released nodes are reused, so building and restituting
+clusters does not go through the general allocator. Nodes still in use when the pool is destroyed are
+destroyed with it.
+*/
+class NodePool {
+    public:
+        NodePool (size_t block_size = 256);
+        ~NodePool ();
+        NodePool (const NodePool&) = delete;
+        NodePool& operator= (const NodePool&) = delete;
+        Node* create (int p1, int p2, float mass, float time, vector<float> impulse);
+        void release (Node* node);  // destroy a node made by create (its children are not released, they become roots)
+        size_t size () const;  // number of nodes in use
+    private:
+        struct slot_t {
+            alignas(Node) unsigned char storage[sizeof(Node)];
+            bool in_use;
+        };
+        size_t block_size;  // slots per block
+        vector<unique_ptr<slot_t[]>> blocks;
+        vector<slot_t*> free_slots;
+        size_t in_use;
+        unsigned long structure_version;  // shared by the nodes of the pool (see Node::structure_version)
+};
+
+#endif
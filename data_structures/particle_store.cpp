@@ -0,0 +1,465 @@
+#include <assert.h>
+#include <map>
+#include <unordered_map>
+#include <algorithm>  // copy, copy_n, lexicographical_compare, stable_sort
+#include <stdexcept>
+#include <fstream>
+#include <charconv>  // to_chars
+#include <cstdint>
+
+#include "particle_store.hpp"
+#include "../utilities/checkpoint.hpp"
+#include "../utilities/particle_file.hpp"
+
+ParticleStore::ParticleStore(json& config) {
+    json& particles = config["particles"];
+    dim = (particles.size() > 0) ? particles.begin().value()["position"].size() : 0;
+    map<string, int> species_index = read_species(config["species"]);
+
+    // particles keep the order of the config so that models iterate over them as they did over the JSON
+    for (auto it = particles.begin(); it != particles.end(); ++it) {
+        int p_id = stoi(it.key());
+        assert(p_id >= 0 && "ParticleStore: particle IDs must not be negative");
+        particle_ids.push_back(p_id);
+
+        string species = it.value()["species"];
+        assert(species_index.count(species) > 0 && "ParticleStore: particle of an unknown species");
+        particle_species.push_back(species_index[species]);
+
+        vector<float> position = it.value()["position"];
+        vector<float> velocity = it.value()["velocity"];
+        assert((int)position.size() == dim && (int)velocity.size() == dim && "ParticleStore: particles must have the same dimensions");
+        positions.insert(positions.end(), position.begin(), position.end());
+        velocities.insert(velocities.end(), velocity.begin(), velocity.end());
+    }
+    index_particles();
+}
+
+namespace {
+
+// decimal text of a particle ID (the key of the particle in a config)
+struct id_text_t {
+    char text[16];
+    char* end;
+    id_text_t (int p_id) : end(to_chars(text, text + sizeof(text), p_id).ptr) {}
+};
+
+// order of the particles of a config once parsed (nlohmann::json sorts object keys as strings)
+bool key_less (int p1_id, int p2_id) {
+    id_text_t p1(p1_id);
+    id_text_t p2(p2_id);
+    return lexicographical_compare(p1.text, p1.end, p2.text, p2.end);
+}
+
+/*
+SAX handler of json::sax_parse for ParticleStore::load. The particles are appended to typed columns as they
+are read (species by name until the species table is known), everything else is built as JSON in config.
+*/
+class ConfigSax {
+    public:
+        vector<int> ids;
+        vector<int> species;  // index in species_names
+        vector<std::string> species_names;  // in the order they are first used
+        vector<float> positions;
+        vector<float> velocities;
+        int dim = -1;  // set by the first particle
+        std::string error;  // set if the file is not valid JSON
+
+        ConfigSax (json& config) : config(config) {}
+
+        bool null () { return add(nullptr); }
+        bool boolean (bool value) { return add(value); }
+        bool number_integer (json::number_integer_t value) { return add(value) && add_number(float(value)); }
+        bool number_unsigned (json::number_unsigned_t value) { return add(value) && add_number(float(value)); }
+        bool number_float (json::number_float_t value, const json::string_t&) { return add(value) && add_number(float(value)); }
+        bool binary (json::binary_t& value) { return add(json::binary(value)); }
+
+        bool string (json::string_t& value) {
+            if (depth == 0) return add(value);
+            if (depth == 2 && field == "species") {
+                auto it = species_refs.find(value);
+                if (it == species_refs.end()) {
+                    it = species_refs.emplace(value, species_names.size()).first;
+                    species_names.push_back(value);
+                }
+                particle_species = it->second;
+            }
+            return true;
+        }
+
+        bool key (json::string_t& value) {
+            if (depth == 0) {
+                key_name = value;
+            }
+            else if (depth == 1) {
+                size_t end;
+                p_id = stoi(value, &end);
+                assert(end == value.size() && value == id_text(p_id) && p_id >= 0 && "ParticleStore: particle IDs must be non-negative decimal integers");
+            }
+            else if (depth == 2) {
+                field = value;
+            }
+            return true;
+        }
+
+        bool start_object (size_t) {
+            if (depth == 0 && stack.size() == 1 && key_name == "particles") {
+                depth = 1;
+                return true;
+            }
+            if (depth > 0) {
+                if (++depth == 2) start_particle();
+                return true;
+            }
+            stack.push_back(add_value(json::object()));
+            return true;
+        }
+
+        bool end_object () {
+            if (depth > 0) {
+                if (depth == 2) end_particle();
+                --depth;
+                return true;
+            }
+            stack.pop_back();
+            return true;
+        }
+
+        bool start_array (size_t) {
+            if (depth > 0) {
+                ++depth;
+                return true;
+            }
+            stack.push_back(add_value(json::array()));
+            return true;
+        }
+
+        bool end_array () {
+            if (depth > 0) {
+                --depth;
+                return true;
+            }
+            stack.pop_back();
+            return true;
+        }
+
+        bool parse_error (size_t, const std::string&, const json::exception& e) {
+            error = e.what();
+            return false;
+        }
+
+    private:
+        json& config;
+        vector<json*> stack;  // open objects and arrays outside "particles"
+        std::string key_name;  // key of the next value of the innermost object
+        unordered_map<std::string, int> species_refs;  // index of every name in species_names
+
+        // inside "particles": 1 in the particles object, 2 in a particle, 3 in one of its values (ignored deeper)
+        int depth = 0;
+        int p_id;
+        std::string field;  // key of the particle's next value
+        vector<float> particle_position;
+        vector<float> particle_velocity;
+        int particle_species;
+
+        static std::string id_text (int p_id) {
+            id_text_t text(p_id);
+            return std::string(text.text, text.end);
+        }
+
+        // a value outside "particles"
+        template <typename T>
+        bool add (T&& value) {
+            if (depth == 0) add_value(json(std::forward<T>(value)));
+            return true;
+        }
+
+        json* add_value (json&& value) {
+            if (stack.empty()) {
+                config = move(value);
+                return &config;
+            }
+            json& parent = *stack.back();
+            if (parent.is_object()) return &(parent[key_name] = move(value));
+            parent.push_back(move(value));
+            return &parent.back();
+        }
+
+        // a number inside "particles"
+        bool add_number (float value) {
+            if (depth == 3 && field == "position") particle_position.push_back(value);
+            if (depth == 3 && field == "velocity") particle_velocity.push_back(value);
+            return true;
+        }
+
+        void start_particle () {
+            particle_position.clear();
+            particle_velocity.clear();
+            particle_species = -1;
+        }
+
+        void end_particle () {
+            if (dim == -1) dim = particle_position.size();
+            assert((int)particle_position.size() == dim && (int)particle_velocity.size() == dim && "ParticleStore: particles must have the same dimensions");
+            assert(particle_species != -1 && "ParticleStore: particle without a species");
+            ids.push_back(p_id);
+            species.push_back(particle_species);
+            positions.insert(positions.end(), particle_position.begin(), particle_position.end());
+            velocities.insert(velocities.end(), particle_velocity.begin(), particle_velocity.end());
+        }
+};
+
+// reorder a column of width values per particle (order[i] is the particle moved to index i)
+template <typename T>
+void permute (vector<T>& column, const vector<uint32_t>& order, int width) {
+    vector<T> result(column.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        copy_n(column.begin() + size_t(order[i]) * width, width, result.begin() + i * width);
+    }
+    column.swap(result);
+}
+
+}
+
+// peak memory stays close to the size of the store: particles are never built as JSON
+// (they are sorted afterwards to get the order that parsing the whole config would give)
+shared_ptr<ParticleStore> ParticleStore::load(const string& path, json& config) {
+    if (is_particle_file(path)) return load_particle_file(path, config);
+    ifstream file(path);
+    if (!file) throw runtime_error("ParticleStore: cannot open " + path);
+    ConfigSax sax(config);
+    if (!json::sax_parse(file, &sax)) throw runtime_error("ParticleStore: cannot parse " + path + ": " + sax.error);
+
+    shared_ptr<ParticleStore> store(new ParticleStore());
+    store->dim = max(sax.dim, 0);
+    map<string, int> species_index = store->read_species(config["species"]);
+    vector<int> species_of_name;
+    for (const string& name : sax.species_names) {
+        assert(species_index.count(name) > 0 && "ParticleStore: particle of an unknown species");
+        species_of_name.push_back(species_index[name]);
+    }
+    for (int& species : sax.species) {
+        species = species_of_name[species];
+    }
+
+    store->particle_ids.swap(sax.ids);
+    store->particle_species.swap(sax.species);
+    store->positions.swap(sax.positions);
+    store->velocities.swap(sax.velocities);
+    if (!is_sorted(store->particle_ids.begin(), store->particle_ids.end(), key_less)) {
+        vector<uint32_t> order(store->particle_ids.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return key_less(store->particle_ids[a], store->particle_ids[b]);
+        });
+        permute(store->particle_ids, order, 1);
+        permute(store->particle_species, order, 1);
+        permute(store->positions, order, store->dim);
+        permute(store->velocities, order, store->dim);
+    }
+    store->index_particles();
+    return store;
+}
+
+// the records are copied into the columns as they are, config gets the config text and the species table back as JSON
+shared_ptr<ParticleStore> ParticleStore::load_particle_file(const string& path, json& config) {
+    ParticleFileReader file(path);
+    config = json::parse(file.config_text());
+
+    shared_ptr<ParticleStore> store(new ParticleStore());
+    store->dim = file.dimensions();
+    store->species_list = file.species();
+    json& species = config["species"] = json::object();
+    for (const species_t& entry : store->species_list) {
+        species[entry.name] = {{"mass", entry.mass}, {"radius", entry.radius}, {"tau", entry.tau}, {"mean", entry.mean}, {"shape", entry.shape}};
+    }
+
+    store->particle_ids.resize(file.size());
+    store->particle_species.resize(file.size());
+    store->positions.resize(file.size() * store->dim);
+    store->velocities.resize(file.size() * store->dim);
+    file.copy_columns(store->particle_ids.data(), store->particle_species.data(), store->positions.data(), store->velocities.data());
+    for (size_t i = 0; i < file.size(); ++i) {
+        assert(store->particle_ids[i] >= 0 && "ParticleStore: particle IDs must not be negative");
+        assert(store->particle_species[i] >= 0 && store->particle_species[i] < (int)store->species_list.size() && "ParticleStore: particle of an unknown species");
+    }
+    store->index_particles();
+    return store;
+}
+
+size_t ParticleStore::size() const {
+    return particle_ids.size();
+}
+
+int ParticleStore::dimensions() const {
+    return dim;
+}
+
+const vector<int>& ParticleStore::ids() const {
+    return particle_ids;
+}
+
+bool ParticleStore::contains(int p_id) const {
+    return p_id >= 0 && p_id < (int)index.size() && index[p_id] != -1;
+}
+
+size_t ParticleStore::index_of(int p_id) const {
+    assert(contains(p_id) && "ParticleStore: unknown particle ID");
+    return index[p_id];
+}
+
+int ParticleStore::species_of(int p_id) const {
+    return particle_species[index_of(p_id)];
+}
+
+const species_t& ParticleStore::species(int p_id) const {
+    return species_list[species_of(p_id)];
+}
+
+const vector<species_t>& ParticleStore::species_table() const {
+    return species_list;
+}
+
+float ParticleStore::mass(int p_id) const {
+    return species(p_id).mass;
+}
+
+float ParticleStore::radius(int p_id) const {
+    return species(p_id).radius;
+}
+
+vector_view_t ParticleStore::position(int p_id) const {
+    return get_column(positions, p_id);
+}
+
+void ParticleStore::set_position(int p_id, vector_view_t position) {
+    set_column(positions, p_id, position);
+}
+
+vector_view_t ParticleStore::velocity(int p_id) const {
+    return get_column(velocities, p_id);
+}
+
+void ParticleStore::set_velocity(int p_id, vector_view_t velocity) {
+    set_column(velocities, p_id, velocity);
+}
+
+float ParticleStore::time(int p_id) const {
+    return times[index_of(p_id)];
+}
+
+void ParticleStore::set_time(int p_id, float time) {
+    times[index_of(p_id)] = time;
+}
+
+vector_view_t ParticleStore::response_velocity(int p_id) const {
+    return get_column(response_velocities, p_id);
+}
+
+void ParticleStore::set_response_velocity(int p_id, vector_view_t velocity) {
+    set_column(response_velocities, p_id, velocity);
+}
+
+void ParticleStore::insert(int p_id, int species, vector_view_t position, vector_view_t velocity, float time) {
+    assert(p_id >= 0 && !contains(p_id) && "ParticleStore: inserting a particle that is already stored");
+    assert(species >= 0 && species < (int)species_list.size() && "ParticleStore: particle of an unknown species");
+    if (particle_ids.size() == 0 && dim == 0) dim = position.size();
+    assert((int)position.size() == dim && (int)velocity.size() == dim && "ParticleStore: particles must have the same dimensions");
+    if (p_id >= (int)index.size()) index.resize(p_id + 1, -1);
+    index[p_id] = particle_ids.size();
+    particle_ids.push_back(p_id);
+    particle_species.push_back(species);
+    positions.insert(positions.end(), position.begin(), position.end());
+    velocities.insert(velocities.end(), velocity.begin(), velocity.end());
+    response_velocities.insert(response_velocities.end(), velocity.begin(), velocity.end());
+    times.push_back(time);
+}
+
+void ParticleStore::erase(int p_id) {
+    size_t i = index_of(p_id);
+    size_t last = particle_ids.size() - 1;
+    if (i != last) {
+        particle_ids[i] = particle_ids[last];
+        index[particle_ids[i]] = i;
+        particle_species[i] = particle_species[last];
+        copy_n(&positions[last * dim], dim, &positions[i * dim]);
+        copy_n(&velocities[last * dim], dim, &velocities[i * dim]);
+        copy_n(&response_velocities[last * dim], dim, &response_velocities[i * dim]);
+        times[i] = times[last];
+    }
+    index[p_id] = -1;
+    particle_ids.pop_back();
+    particle_species.pop_back();
+    positions.resize(last * dim);
+    velocities.resize(last * dim);
+    response_velocities.resize(last * dim);
+    times.pop_back();
+}
+
+// same arithmetic as subV, so a frame matches the positions subV reports
+void ParticleStore::positions_at(float time, float* out) const {
+    for (size_t i = 0; i < particle_ids.size(); ++i) {
+        float dt = time - times[i];
+        const float* position = &positions[i * dim];
+        const float* velocity = &velocities[i * dim];
+        float* result = &out[i * dim];
+        for (int j = 0; j < dim; ++j) {
+            result[j] = position[j] + velocity[j] * dt;
+        }
+    }
+}
+
+void ParticleStore::save_checkpoint(CheckpointWriter& out) const {
+    out.put(particle_ids);
+    out.put(positions);
+    out.put(velocities);
+    out.put(times);
+    out.put(response_velocities);
+}
+
+void ParticleStore::restore_checkpoint(CheckpointReader& in) {
+    vector<int> saved_ids;
+    in.get(saved_ids);
+    if (saved_ids != particle_ids) throw runtime_error("ParticleStore: the checkpoint holds other particles than the config");
+    in.get(positions);
+    in.get(velocities);
+    in.get(times);
+    in.get(response_velocities);
+}
+
+// species are numbered in the order they appear in the config
+map<string, int> ParticleStore::read_species(json& species) {
+    map<string, int> species_index;
+    for (auto it = species.begin(); it != species.end(); ++it) {
+        species_t entry;
+        entry.name = it.key();
+        entry.mass = it.value()["mass"];
+        entry.radius = it.value()["radius"];
+        entry.tau = it.value()["tau"];
+        entry.mean = it.value()["mean"];
+        entry.shape = it.value()["shape"];
+        species_index[it.key()] = species_list.size();
+        species_list.push_back(entry);
+    }
+    return species_index;
+}
+
+void ParticleStore::index_particles() {
+    for (size_t i = 0; i < particle_ids.size(); ++i) {
+        int p_id = particle_ids[i];
+        if (p_id >= (int)index.size()) index.resize(p_id + 1, -1);
+        assert(index[p_id] == -1 && "ParticleStore: duplicate particle ID");
+        index[p_id] = i;
+    }
+    response_velocities = velocities;
+    times.assign(particle_ids.size(), 0);
+}
+
+vector_view_t ParticleStore::get_column(const vector<float>& column, int p_id) const {
+    return vector_view_t(column.data() + index_of(p_id) * dim, dim);
+}
+
+void ParticleStore::set_column(vector<float>& column, int p_id, vector_view_t values) {
+    assert((int)values.size() == dim && "ParticleStore: value does not match the dimensions of the store");
+    copy(values.begin(), values.end(), column.begin() + index_of(p_id) * dim);
+}
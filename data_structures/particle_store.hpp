@@ -0,0 +1,95 @@
+#ifndef PARTICLE_STORE
+#define PARTICLE_STORE
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <nlohmann/json.hpp>
+
+#include "../utilities/vector_utils.hpp"  // vector_view_t
+
+using namespace std;
+
+using json = nlohmann::json;
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// parameters shared by every particle of a species
+struct species_t {
+    string name;
+    float mass;
+    float radius;
+    float tau;  // rate of random impulses
+    float mean;  // random impulse magnitude (gamma distribution)
+    float shape;
+};
+
+/*
+Typed particle data shared by the models of a simulation (RI, responder and subV).
+Built once from a config's "particles" and "species" and owned outside the models, which hold a
+shared_ptr to it (load reads a config file, or a binary particle file, without building its particles
+as JSON). Per-particle data is stored in dense columns indexed by the order of the particles in the
+config, species parameters are stored once in a table that particles refer to by index.
+Vectors are read as views of the dim values of a particle in its column (no copy is made), which stay valid
+until a particle is inserted or erased or the store is restored from a checkpoint. Models only write the
+columns they own:
+- position, velocity and time: subV (kinematic state, the position is valid at the particle's time)
+- response velocity: responder (velocity of a particle that is not loaded, as last sent by the responder;
+  it runs ahead of the kinematic velocity until the response reaches subV)
+*/
+class ParticleStore {
+    public:
+        ParticleStore (json& config);
+        // the particles of a config file go straight into the columns, the rest of the file is returned in config (without "particles");
+        // path may also be a particle file (utilities/particle_file.hpp), whose records are copied into the columns
+        static shared_ptr<ParticleStore> load (const string& path, json& config);
+        ParticleStore (const ParticleStore&) = delete;
+        ParticleStore& operator= (const ParticleStore&) = delete;
+        size_t size () const;  // number of particles
+        int dimensions () const;
+        const vector<int>& ids () const;  // particle IDs in store order
+        bool contains (int p_id) const;
+        size_t index_of (int p_id) const;
+        int species_of (int p_id) const;  // index in the species table
+        const species_t& species (int p_id) const;
+        const vector<species_t>& species_table () const;
+        float mass (int p_id) const;
+        float radius (int p_id) const;
+        vector_view_t position (int p_id) const;
+        void set_position (int p_id, vector_view_t position);
+        vector_view_t velocity (int p_id) const;
+        void set_velocity (int p_id, vector_view_t velocity);
+        float time (int p_id) const;
+        void set_time (int p_id, float time);
+        vector_view_t response_velocity (int p_id) const;
+        void set_response_velocity (int p_id, vector_view_t velocity);
+        // particles handed between the stores of a domain-decomposed run (see test/main_domain_test.cpp)
+        // an inserted particle starts with its response velocity set to its velocity, like a particle of the config
+        // (a store made without particles takes the dimensions of the first one inserted), an erased particle's
+        // place in the columns is taken by the last particle
+        void insert (int p_id, int species, vector_view_t position, vector_view_t velocity, float time);
+        void erase (int p_id);
+        void positions_at (float time, float* out) const;  // every position extrapolated to time (size() * dimensions() values, store order)
+        void save_checkpoint (CheckpointWriter& out) const;  // the columns written by the models
+        void restore_checkpoint (CheckpointReader& in);
+    private:
+        ParticleStore () : dim(0) {}
+        static shared_ptr<ParticleStore> load_particle_file (const string& path, json& config);
+        int dim;
+        vector<species_t> species_list;
+        vector<int> particle_ids;  // ID of every index
+        vector<int> index;  // index of every ID (-1 for IDs without a particle)
+        vector<int> particle_species;
+        vector<float> positions;  // dim values per particle
+        vector<float> velocities;
+        vector<float> times;
+        vector<float> response_velocities;
+        map<string, int> read_species (json& species);  // fills the species table, returns the index of every name
+        void index_particles ();  // index the particle IDs and start every particle at time 0 with its initial velocity
+        vector_view_t get_column (const vector<float>& column, int p_id) const;
+        void set_column (vector<float>& column, int p_id, vector_view_t values);
+};
+
+#endif
@@ -0,0 +1,190 @@
+#!/bin/python3
+
+'''
+Reader for the binary columnar event logs written by the event logger (utilities/event_log.hpp).
+
+read_event_log(filename) returns every column as a NumPy array:
+    time      (n,)      float64
+    event     (n,)      uint32   index of the bag of messages the record arrived in
+    p_id      (n,)      int32
+    subV_id   (n,)      int32
+    position  (n, dim)  float32
+    velocity  (n, dim)  float32
+    purpose   (n,)      uint8    index in PURPOSES
+The file is memory mapped and chunks are read as views where possible.
+
+Logs written with an index interval (config key log_index_interval) come with a sidecar index "<log>.idx"
+and keyframes "<log>.keys" (see utilities/time_index.hpp and utilities/event_log.hpp): state_at(filename, t)
+finds the block of t with a binary search and only reads that block's keyframe and chunks.
+read_index and find_block also work on the indexes of the text logs.
+
+Logs written with a particle index (config key event_log_particle_index) come with "<log>.pidx":
+particle_history(filename, p_id) only reads the records of that particle (as does bin/PARTICLE_QUERY).
+'''
+
+import sys
+import numpy as np
+
+MAGIC = b"TPSEVL01"
+INDEX_MAGIC = b"TPSIDX01"
+PARTICLE_INDEX_MAGIC = b"TPSPID01"
+KEYFRAME_MAGIC = b"TPSKEY01"
+NO_KEYFRAME = 2**64 - 1
+HEADER_BYTES = 16
+CHUNK_HEADER_BYTES = 8
+PURPOSES = ["n/a", "init", "load", "rest", "ri"]  # same order as purpose_t
+
+# columns of a chunk in file order: name, type, whether there is one value per dimension
+COLUMNS = [
+    ("time", np.float64, False),
+    ("event", np.uint32, False),
+    ("p_id", np.int32, False),
+    ("subV_id", np.int32, False),
+    ("position", np.float32, True),
+    ("velocity", np.float32, True),
+    ("purpose", np.uint8, False)
+]
+KEYFRAME_COLUMNS = [
+    ("time", np.float64, False),
+    ("p_id", np.int32, False),
+    ("position", np.float32, True),
+    ("velocity", np.float32, True)
+]
+
+def is_event_log(filename):
+    try:
+        with open(filename, "rb") as f:
+            return f.read(len(MAGIC)) == MAGIC
+    except OSError:
+        return False
+
+def _open(filename, magic):
+    data = np.memmap(filename, dtype=np.uint8, mode="r")
+    if bytes(data[:len(magic)]) != magic:
+        raise ValueError(f"{filename} is not a {magic.decode()} file")
+    return data, int(data[8:12].view(np.uint32)[0])
+
+# columns of the chunk (or keyframe) at offset and the offset of the next one
+def _read_columns(data, offset, dim, columns):
+    count = int(data[offset:offset+4].view(np.uint32)[0])
+    offset += CHUNK_HEADER_BYTES
+    result = {}
+    for name, dtype, per_dim in columns:
+        width = dim if per_dim else 1
+        column = np.frombuffer(data, dtype=dtype, count=count*width, offset=offset)
+        result[name] = column.reshape(count, dim) if per_dim else column
+        offset += column.nbytes
+    return result, offset + (-offset % 8)  # padded to 8 bytes
+
+def read_event_log(filename):
+    data, dim = _open(filename, MAGIC)
+
+    chunks = {name: [] for name, _, _ in COLUMNS}
+    offset = HEADER_BYTES
+    while offset + CHUNK_HEADER_BYTES <= len(data):
+        chunk, offset = _read_columns(data, offset, dim, COLUMNS)
+        for name in chunk:
+            chunks[name].append(chunk[name])
+
+    result = {"dim": dim}
+    for name, dtype, per_dim in COLUMNS:
+        if len(chunks[name]) == 0:
+            result[name] = np.zeros((0, dim) if per_dim else 0, dtype=dtype)
+        elif len(chunks[name]) == 1:
+            result[name] = chunks[name][0]
+        else:
+            result[name] = np.concatenate(chunks[name])
+    return result
+
+# sidecar index of a log (event log or text log): arrays time, offset and keyframe, sorted by time
+def read_index(log_filename):
+    data = np.memmap(log_filename + ".idx", dtype=np.uint8, mode="r")
+    if bytes(data[:len(INDEX_MAGIC)]) != INDEX_MAGIC:
+        raise ValueError(f"{log_filename}.idx is not an index")
+    entries = np.frombuffer(data, dtype=[("time", np.float64), ("offset", np.uint64), ("keyframe", np.uint64)], offset=len(INDEX_MAGIC))
+    return {"time": entries["time"], "offset": entries["offset"], "keyframe": entries["keyframe"]}
+
+# index of the entry of the block holding time (-1 if time is before the first entry)
+def find_block(index, time):
+    return int(np.searchsorted(index["time"], time, side="right")) - 1
+
+# position of every particle logged up to time (included), as {p_id: [pos]}
+def state_at(filename, time):
+    data, dim = _open(filename, MAGIC)
+    try:
+        index = read_index(filename)
+        block = find_block(index, time)
+    except FileNotFoundError:
+        block = -1  # without an index, the whole log is read
+
+    state = {}  # p_id: (time, position, velocity) of the particle's last record
+    offset = HEADER_BYTES
+    if block >= 0:
+        keys, _ = _open(filename + ".keys", KEYFRAME_MAGIC)
+        keyframe, _ = _read_columns(keys, int(index["keyframe"][block]), dim, KEYFRAME_COLUMNS)
+        for t, p_id, pos, vel in zip(keyframe["time"], keyframe["p_id"], keyframe["position"], keyframe["velocity"]):
+            state[int(p_id)] = (t, pos, vel)
+        offset = int(index["offset"][block])
+
+    while offset + CHUNK_HEADER_BYTES <= len(data):
+        chunk, offset = _read_columns(data, offset, dim, COLUMNS)
+        end = int(np.searchsorted(chunk["time"], time, side="right"))
+        for t, p_id, pos, vel in zip(chunk["time"][:end], chunk["p_id"][:end], chunk["position"][:end], chunk["velocity"][:end]):
+            state[int(p_id)] = (t, pos, vel)
+        if end < len(chunk["time"]):
+            break
+
+    return {p_id: (pos + vel * np.float32(time - t)).tolist() for p_id, (t, pos, vel) in state.items()}
+
+# records of one particle in the format of output_tools.parse_msg_file: [time, p_id, [pos], [vel]]
+def particle_history(filename, p_id):
+    data, dim = _open(filename, MAGIC)
+    index = np.memmap(filename + ".pidx", dtype=np.uint8, mode="r")
+    if bytes(index[:len(PARTICLE_INDEX_MAGIC)]) != PARTICLE_INDEX_MAGIC:
+        raise ValueError(f"{filename}.pidx is not a particle index")
+    particles = int(index[8:12].view(np.uint32)[0])
+    chunks = int(index[16:24].view(np.uint64)[0])
+    chunk_offsets = np.frombuffer(index, dtype=np.uint64, count=chunks, offset=32)
+    entries = np.frombuffer(index, dtype=[("p_id", np.int32), ("count", np.uint32), ("first", np.uint64)], count=particles, offset=32 + 8*chunks)
+    i = int(np.searchsorted(entries["p_id"], p_id))
+    if i == len(entries) or entries["p_id"][i] != p_id:
+        return []
+    locations = np.frombuffer(index, dtype=[("chunk", np.uint32), ("row", np.uint32)], count=int(entries["count"][i]),
+                              offset=32 + 8*chunks + entries.itemsize*particles + 8*int(entries["first"][i]))
+
+    result = []
+    for chunk, row in zip(locations["chunk"].tolist(), locations["row"].tolist()):
+        offset = int(chunk_offsets[chunk])
+        count = int(data[offset:offset+4].view(np.uint32)[0])
+        offset += CHUNK_HEADER_BYTES
+        time = float(np.frombuffer(data, dtype=np.float64, count=1, offset=offset + 8*row)[0])
+        offset += count * (8 + 4 + 4 + 4)  # time, event, p_id, subV_id
+        pos = np.frombuffer(data, dtype=np.float32, count=dim, offset=offset + 4*dim*row).tolist()
+        vel = np.frombuffer(data, dtype=np.float32, count=dim, offset=offset + 4*dim*(count + row)).tolist()
+        result.append([time, p_id, pos, vel])
+    return result
+
+# events in the format of output_tools.parse_msg_file: [time, p_id, [pos], [vel]]
+def iter_events(filename):
+    log = read_event_log(filename)
+    times = log["time"].tolist()
+    p_ids = log["p_id"].tolist()
+    positions = log["position"].tolist()
+    velocities = log["velocity"].tolist()
+    for i in range(len(times)):
+        yield([times[i], p_ids[i], positions[i], velocities[i]])
+
+if __name__ == "__main__":
+    if len(sys.argv) not in [2, 3] or '-h' in sys.argv[1]:
+        print('Usage: \n\tpython3 event_log.py events.bin           #prints a summary of the log\n'+
+              '\tpython3 event_log.py events.bin <time>    #prints the position of every particle at time, of the form [time, {p_id:[pos]}]')
+        exit()
+    if len(sys.argv) == 3:
+        print([float(sys.argv[2]), state_at(sys.argv[1], float(sys.argv[2]))])
+        exit()
+    log = read_event_log(sys.argv[1])
+    print(f"dimensions: {log['dim']}, events: {len(log['time'])}, bags: {len(np.unique(log['event']))}")
+    if len(log["time"]) > 0:
+        print(f"time: [{log['time'][0]}, {log['time'][-1]}], particles: {len(np.unique(log['p_id']))}")
+        for code, count in zip(*np.unique(log["purpose"], return_counts=True)):
+            print(f"{PURPOSES[code]}: {count}")
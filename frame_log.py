@@ -0,0 +1,55 @@
+#!/bin/python3
+
+'''
+Reader for the frame logs written by the frame recorder (utilities/frame_log.hpp), which hold the position of
+every particle at regular times (config keys frame_interval and frame_log).
+
+read_frames(filename) returns:
+    dim
+    p_id      (n,)              int32
+    time      (frames,)         float64
+    position  (frames, n, dim)  float32   position[k, i] is the position of p_id[i] at time[k]
+The file is memory mapped and the arrays are views into it.
+'''
+
+import sys
+import numpy as np
+
+MAGIC = b"TPSFRM01"
+HEADER_BYTES = 16
+
+def _padded(size):
+    return size + (-size % 8)
+
+def is_frame_log(filename):
+    try:
+        with open(filename, "rb") as f:
+            return f.read(len(MAGIC)) == MAGIC
+    except OSError:
+        return False
+
+def read_frames(filename):
+    data = np.memmap(filename, dtype=np.uint8, mode="r")
+    if bytes(data[:len(MAGIC)]) != MAGIC:
+        raise ValueError(f"{filename} is not a frame log")
+    dim, n = (int(x) for x in data[8:16].view(np.uint32))
+    p_ids = np.frombuffer(data, dtype=np.int32, count=n, offset=HEADER_BYTES)
+
+    start = HEADER_BYTES + _padded(4 * n)
+    frame = np.dtype([("time", np.float64), ("position", np.float32, (n, dim)), ("padding", np.uint8, _padded(4 * n * dim) - 4 * n * dim)])
+    frames = np.frombuffer(data, dtype=frame, count=(len(data) - start) // frame.itemsize, offset=start)
+    return {"dim": dim, "p_id": p_ids, "time": frames["time"], "position": frames["position"]}
+
+# frames in the format of output_tools.quantize_state_to_times: [time, {p_id:[pos]}]
+def iter_frames(filename):
+    frames = read_frames(filename)
+    p_ids = frames["p_id"].tolist()
+    for time, positions in zip(frames["time"].tolist(), frames["position"]):
+        yield([time, dict(zip(p_ids, positions.tolist()))])
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2 or '-h' in sys.argv[1]:
+        print('Usage: \n\tpython3 frame_log.py frames.bin    #prints every frame, of the form [time, {p_id:[pos]}]')
+        exit()
+    for frame in iter_frames(sys.argv[1]):
+        print(frame)
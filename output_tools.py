@@ -41,6 +41,23 @@ def parse_msg_file(msg_file):
 
                 yield([time, p_id, pos, vel])
 
+#events of a message log, of a binary event log (event_log.py) or of a trajectory log (trajectory.py), in the format of parse_msg_file
+def read_events(filename):
+    magic = _magic(filename)
+    if magic == b"TPSEVL01":
+        import event_log  #only binary logs need numpy
+        yield from event_log.iter_events(filename)
+    elif magic == b"TPSTRJ01":
+        import trajectory
+        yield from trajectory.iter_events(filename)
+    else:
+        with open(filename) as msg_file:
+            yield from parse_msg_file(msg_file)
+
+def _magic(filename):
+    with open(filename, "rb") as f:
+        return f.read(8)
+
 def _quantize_state_to_times_output_helper(state, next_time):
     out = dict()
     for key, (update_time, po, ve) in state.items():
@@ -79,15 +96,15 @@ if __name__ == "__main__":
         'Usage: \n'+
         '\tmessages.txt | python3 output_tools.py                                       #outputs a cleanned sequence of events of the form [time, p_id, [pos], [vel]]\n'+
         '\tpython3 output_tools.py messages.txt                                         #as if messages.txt was piped in\n'+
+        '\tpython3 output_tools.py events.bin                                           #the same for a binary event log or trajectory log (event_log or trajectory_log in the config)\n'+
         '\tpython3 output_tools.py messages.txt <end time>                              #at each time in [0.0, end] with a stepsize of 1.0, print a snapeshot of the state, of the form [time, {p_id:[pos]}]\n'+
         '\tpython3 output_tools.py messages.txt <end time> <timestep size>              #as the last case, but with the specified step size instead of 1.0\n'+
         '\tpython3 output_tools.py messages.txt <end time> <timestep size> <start time> #as the last case, but with the specified start time instead of 0.0\n'
         )
         exit()
     if len(sys.argv) == 2:
-        with open(sys.argv[1]) as msg_file:
-            for event in parse_msg_file(msg_file):
-                print(event)
+        for event in read_events(sys.argv[1]):
+            print(event)
     elif len(sys.argv) > 2:
         #end | end, step size | end, step size, start
         end  = float(sys.argv[2])
@@ -102,9 +119,8 @@ if __name__ == "__main__":
         if(step < 0):
             print(f"step:{step} is <0, we can only walk forwards through the input, we cannot produce states out of order or in reverse order like this")
             exit(-1)
-        with open(sys.argv[1]) as msg_file:
-            for state in quantize_state_to_times(parse_msg_file(msg_file), _float_range_helper(start, end, step)):
-                print(state)
+        for state in quantize_state_to_times(read_events(sys.argv[1]), _float_range_helper(start, end, step)):
+            print(state)
 
     else:
         for event in parse_msg_file(sys.stdin):
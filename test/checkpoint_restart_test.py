@@ -0,0 +1,148 @@
+#!/bin/python3
+
+'''
+Checks that a run restarted from a checkpoint continues exactly like the uninterrupted run (see utilities/checkpoint.hpp).
+
+The config is run three or four times with ITER_1_TEST, in a temporary directory:
+- full: from 0 to the runtime of the config
+- half: from 0 to half the runtime, saving a checkpoint at the end
+- restarted: from the checkpoint of the half run to the runtime
+- with --sigterm: from 0 to the runtime with a checkpoint path, stopped with SIGTERM once its logs are written to,
+  then restarted from the checkpoint saved on SIGTERM
+Every restarted run must continue the run it was restarted from exactly like the full run: the lines of the message
+and state logs of both runs (after the states logged when the runner starts) are the lines of the full run's logs,
+and the records of their event logs are the records of the full run's event log.
+
+Run from the root of the repository (event_log.py is read from there), or with make checkpoint_test.
+'''
+
+import sys
+import os
+import json
+import time
+import signal
+import struct
+import tempfile
+import subprocess
+import numpy as np
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+from event_log import read_event_log
+
+LOGS = ["iter_1_test_output_messages.txt", "iter_1_test_output_state.txt"]
+
+# run the simulator on config (plus keys) from work/bin, so that its logs are written to work/simulation_results
+# return: the process (waited for unless wait is False)
+def run(binary, config, keys, work, name, wait=True):
+    config = json.loads(json.dumps(config))
+    config["config"].update(keys)
+    path = os.path.join(work, name + ".json")
+    with open(path, "w") as f:
+        json.dump(config, f)
+    err = open(os.path.join(work, name + ".err"), "w")
+    process = subprocess.Popen([binary, path], cwd=os.path.join(work, "bin"), stdout=subprocess.DEVNULL, stderr=err)
+    if wait:
+        process.wait()
+    return process
+
+# the log files of the last run, renamed after name
+def keep_logs(work, name):
+    for log in LOGS:
+        os.replace(os.path.join(work, "simulation_results", log), os.path.join(work, name + "." + log))
+
+def read_lines(work, name, log):
+    with open(os.path.join(work, name + "." + log)) as f:
+        return f.read().splitlines()
+
+def is_time(line):
+    try:
+        float(line)
+        return True
+    except ValueError:
+        return False
+
+# lines of a log from its first step (the runner logs the state of every model when it starts)
+def steps(lines):
+    for i, line in enumerate(lines):
+        if is_time(line):
+            return lines[i:]
+    return []
+
+def checkpoint_time(path):
+    with open(path, "rb") as f:
+        header = f.read(16)
+    return struct.unpack("=d", header[8:16])[0]
+
+# compare the run stopped at a checkpoint followed by the run restarted from it with the full run, return the failures
+def compare(work, full, stopped, restarted):
+    failures = []
+    for log in LOGS:
+        expected = steps(read_lines(work, full, log))
+        actual = steps(read_lines(work, stopped, log)) + steps(read_lines(work, restarted, log))
+        if actual != expected:
+            failures.append(f"{restarted}: {log} differs from the full run's")
+
+    expected = read_event_log(events(work, full))
+    before = read_event_log(events(work, stopped))
+    after = read_event_log(events(work, restarted))
+    if len(before["time"]) + len(after["time"]) != len(expected["time"]):
+        failures.append(f"{restarted}: {len(before['time'])} + {len(after['time'])} event log records for {len(expected['time'])} in the full run")
+        return failures
+    for column in ["time", "event", "p_id", "subV_id", "position", "velocity", "purpose"]:
+        if not np.array_equal(np.concatenate([before[column], after[column]]), expected[column]):
+            failures.append(f"{restarted}: event log column {column} differs from the full run's")
+    return failures
+
+def events(work, name):
+    return os.path.join(work, name + ".events.bin")
+
+def main(binary, config_path, sigterm):
+    binary = os.path.abspath(binary)
+    with open(config_path) as f:
+        config = json.load(f)
+    runtime = float(config["config"]["runtime"])
+    failures = []
+
+    with tempfile.TemporaryDirectory() as work:
+        os.mkdir(os.path.join(work, "bin"))
+        os.mkdir(os.path.join(work, "simulation_results"))
+        checkpoint = os.path.join(work, "checkpoint.bin")
+
+        runs = [("full", {"event_log": events(work, "full")}),
+                ("half", {"runtime": runtime / 2, "checkpoint": checkpoint, "event_log": events(work, "half")}),
+                ("restarted", {"restart": checkpoint, "event_log": events(work, "restarted")})]
+        for name, keys in runs:
+            if run(binary, config, keys, work, name).returncode != 0:
+                sys.exit(f"{name} run failed, see {name}.err")
+            keep_logs(work, name)
+        print(f"restarted at {checkpoint_time(checkpoint)} (runtime {runtime})")
+        failures += compare(work, "full", "half", "restarted")
+
+        if sigterm:
+            stopped = os.path.join(work, "stopped.bin")
+            process = run(binary, config, {"checkpoint": stopped, "event_log": events(work, "stopped")}, work, "stopped", wait=False)
+            messages = os.path.join(work, "simulation_results", LOGS[0])
+            while process.poll() is None and (not os.path.exists(messages) or os.path.getsize(messages) == 0):
+                time.sleep(0.001)
+            process.send_signal(signal.SIGTERM)
+            if process.wait() != 1:
+                failures.append("stopped: the run finished before SIGTERM (use a longer config)")
+            else:
+                keep_logs(work, "stopped")
+                if run(binary, config, {"restart": stopped, "event_log": events(work, "resumed")}, work, "resumed").returncode != 0:
+                    sys.exit("resumed run failed, see resumed.err")
+                keep_logs(work, "resumed")
+                print(f"stopped by SIGTERM at {checkpoint_time(stopped)}")
+                failures += compare(work, "full", "stopped", "resumed")
+
+    for failure in failures:
+        print(failure)
+    print("FAILED" if failures else "OK")
+    return 1 if failures else 0
+
+if __name__ == "__main__":
+    args = [arg for arg in sys.argv[1:] if arg != "--sigterm"]
+    if len(args) != 2 or '-h' in args[0]:
+        print('Usage: \n\tpython3 test/checkpoint_restart_test.py bin/ITER_1_TEST config.json [--sigterm]')
+        exit()
+    sys.exit(main(args[0], args[1], "--sigterm" in sys.argv[1:]))
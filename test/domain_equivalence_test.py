@@ -0,0 +1,129 @@
+#!/bin/python3
+
+'''
+Checks that a run split into domains (see test/main_domain_test.cpp) logs the same events as the run in one domain.
+
+The config is run with DOMAIN_TEST in one domain and in two, in a temporary directory, once for every window length
+given (config key "window"). The logging messages of subV (initial states excluded) are read from the message logs
+of every domain and grouped by particle: every particle must go through the same events in both runs (purpose and,
+within a tolerance, time, velocity and position), in the same order. The times of the two runs are not bit for bit
+the same, as the time of a domain advances through its own events.
+The two domain run must hand particles over, so the config has to move particles across the middle of the first axis.
+
+Run from the root of the repository, or with make domain_test.
+'''
+
+import sys
+import os
+import re
+import json
+import glob
+import tempfile
+import subprocess
+
+TOLERANCE = 1e-3
+WINDOWS = [1.0, 8.0]
+
+LOGGING = re.compile(r"\[subV_id: -?\d+, p_id: (\d+), vel: <([^>]*)>, pos: <([^>]*)>, type: (\w+)\]")
+
+# run the simulator on config (plus keys) in num_domains domains from work/bin, so that its logs are written to
+# work/simulation_results
+# return: the return code
+def run(binary, config, keys, num_domains, work, name):
+    config = json.loads(json.dumps(config))
+    config["config"].update(keys)
+    path = os.path.join(work, name + ".json")
+    with open(path, "w") as f:
+        json.dump(config, f)
+    for log in glob.glob(os.path.join(work, "simulation_results", "*")):
+        os.remove(log)
+    with open(os.path.join(work, name + ".err"), "w") as err:
+        return subprocess.run([binary, path, str(num_domains)], cwd=os.path.join(work, "bin"),
+                              stdout=subprocess.DEVNULL, stderr=err).returncode
+
+# logging messages of subV in the message logs of every domain
+# return: {p_id: [(time, purpose, velocity, position)]} in the order they were logged
+def read_events(work):
+    events = {}
+    for log in sorted(glob.glob(os.path.join(work, "simulation_results", "domain_*_output_messages.txt"))):
+        time = None
+        with open(log) as f:
+            for line in f:
+                line = line.strip()
+                try:
+                    time = float(line)
+                    continue
+                except ValueError:
+                    pass
+                if "logging_out" not in line:
+                    continue
+                for match in LOGGING.finditer(line):
+                    if match.group(4) == "init":
+                        continue
+                    velocity = [float(x) for x in match.group(2).split()]
+                    position = [float(x) for x in match.group(3).split()]
+                    events.setdefault(int(match.group(1)), []).append((time, match.group(4), velocity, position))
+    # a particle is only ever in one domain, its events are sorted by time over the logs of every domain
+    for history in events.values():
+        history.sort(key=lambda event: event[0])
+    return events
+
+def count_departures(work):
+    departures = 0
+    for log in glob.glob(os.path.join(work, "simulation_results", "domain_*_migrations.txt")):
+        with open(log) as f:
+            departures += sum(1 for line in f if " departure " in line)
+    return departures
+
+def close(a, b):
+    return all(abs(x - y) <= TOLERANCE for x, y in zip(a, b))
+
+# compare the events of every particle with the one domain run's, return the failures
+def compare(name, expected, actual):
+    failures = []
+    for p_id in sorted(set(expected) | set(actual)):
+        wanted = expected.get(p_id, [])
+        logged = actual.get(p_id, [])
+        for i, (e, a) in enumerate(zip(wanted, logged)):
+            if e[1] != a[1] or not close([e[0]], [a[0]]) or not close(e[2], a[2]) or not close(e[3], a[3]):
+                failures.append(f"{name}: event {i} of particle {p_id} differs from the one domain run's: {a} for {e}")
+                break
+        else:
+            if len(wanted) != len(logged):
+                failures.append(f"{name}: {len(logged)} events of particle {p_id} for {len(wanted)} in the one domain run")
+    return failures
+
+def main(binary, config_path):
+    binary = os.path.abspath(binary)
+    with open(config_path) as f:
+        config = json.load(f)
+    failures = []
+
+    with tempfile.TemporaryDirectory() as work:
+        os.mkdir(os.path.join(work, "bin"))
+        os.mkdir(os.path.join(work, "simulation_results"))
+
+        for window in WINDOWS:
+            runs = {}
+            for num_domains in [1, 2]:
+                name = f"window_{window}_domains_{num_domains}"
+                if run(binary, config, {"window": window}, num_domains, work, name) != 0:
+                    sys.exit(f"{name} run failed, see {name}.err")
+                runs[num_domains] = read_events(work)
+                if num_domains == 2:
+                    departures = count_departures(work)
+            print(f"window {window}: {sum(len(history) for history in runs[1].values())} events, {departures} handovers")
+            if departures == 0:
+                failures.append(f"window {window}: no particle was handed over (use a config whose particles cross the middle)")
+            failures += compare(f"window {window}", runs[1], runs[2])
+
+    for failure in failures:
+        print(failure)
+    print("FAILED" if failures else "OK")
+    return 1 if failures else 0
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3 or '-h' in sys.argv[1]:
+        print('Usage: \n\tpython3 test/domain_equivalence_test.py bin/DOMAIN_TEST config.json')
+        exit()
+    sys.exit(main(sys.argv[1], sys.argv[2]))
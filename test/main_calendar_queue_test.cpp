@@ -0,0 +1,102 @@
+/*
+Equivalence check and throughput benchmark for the random impulse scheduling queues.
+
+Runs the RI scheduling pattern (pop the particle with the earliest impulse time, push its next time
+drawn from an exponential distribution) on the two queues RandomImpulse can use (ri_heap_t and
+ri_calendar_t), checks that both return exactly the same sequence of events (with ties broken by
+particle ID), then times each.
+
+Usage: CALENDAR_QUEUE_TEST [particles] [events] [seed]
+*/
+
+// C++ libraries
+#include <iostream>
+#include <string>
+#include <vector>
+#include <queue>
+#include <random>
+#include <chrono>
+#include <utility>  // contains pair
+
+#include "../atomics/random_impulse.hpp"  // ri_heap_t, ri_calendar_t
+
+using namespace std;
+
+using TIME = float;
+
+/*** Forward References ***/
+struct event_plan_t;
+template <typename QUEUE> vector<pair<int, TIME>> runQueue (const event_plan_t&, bool);
+double timeQueue (const event_plan_t&, bool);
+
+using heap_queue_t = ri_heap_t<TIME>;
+using calendar_queue_t = ri_calendar_t<TIME>;
+
+// random numbers are drawn before running so that only the queue is timed
+struct event_plan_t {
+    vector<TIME> initial;  // first impulse time of every particle
+    vector<TIME> intervals;  // time until the next impulse, one per event
+};
+
+int main (int argc, char** argv) {
+    int particles = (argc > 1) ? stoi(argv[1]) : 100000;
+    int events = (argc > 2) ? stoi(argv[2]) : 2000000;
+    unsigned int seed = (argc > 3) ? stoul(argv[3]) : 1;
+
+    // particles have one of a few impulse rates (as with a small number of species)
+    default_random_engine generator(seed);
+    vector<exponential_distribution<TIME>> rates = {exponential_distribution<TIME>(0.1), exponential_distribution<TIME>(0.2), exponential_distribution<TIME>(5)};
+    event_plan_t plan;
+    for (int i = 0; i < particles; ++i) {
+        plan.initial.push_back(rates[i % rates.size()](generator));
+    }
+    for (int i = 0; i < events; ++i) {
+        plan.intervals.push_back(rates[i % rates.size()](generator));
+    }
+
+    // equivalence
+    bool equivalent = (runQueue<heap_queue_t>(plan, true) == runQueue<calendar_queue_t>(plan, true));
+    cout << "particles: " << particles << ", events: " << events << endl;
+    cout << "equivalent: " << (equivalent ? "yes" : "NO") << endl;
+    if (!equivalent) return 1;
+
+    // throughput
+    double heap_seconds = timeQueue(plan, false);
+    double calendar_seconds = timeQueue(plan, true);
+    cout << "binary heap:    " << heap_seconds << " s (" << events / heap_seconds << " events/s)" << endl;
+    cout << "calendar queue: " << calendar_seconds << " s (" << events / calendar_seconds << " events/s)" << endl;
+    return 0;
+}
+
+// run the scheduling pattern, returns the popped events if record is set
+template <typename QUEUE>
+vector<pair<int, TIME>> runQueue (const event_plan_t& plan, bool record) {
+    vector<pair<int, TIME>> order;
+    QUEUE queue;
+    for (unsigned int i = 0; i < plan.initial.size(); ++i) {
+        queue.push(pair<int, TIME>(i, plan.initial[i]));
+    }
+    for (TIME interval : plan.intervals) {
+        pair<int, TIME> next = queue.top();
+        queue.pop();
+        if (record) order.push_back(next);
+        queue.push(pair<int, TIME>(next.first, next.second + interval));
+    }
+    // drain so that shrinking is exercised as well
+    while (!queue.empty()) {
+        if (record) order.push_back(queue.top());
+        queue.pop();
+    }
+    return order;
+}
+
+double timeQueue (const event_plan_t& plan, bool calendar) {
+    auto start = chrono::steady_clock::now();
+    if (calendar) {
+        runQueue<calendar_queue_t>(plan, false);
+    }
+    else {
+        runQueue<heap_queue_t>(plan, false);
+    }
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,683 @@
+// Cadmium Simulator headers
+#include <cadmium/modeling/ports.hpp>
+#include <cadmium/modeling/dynamic_model.hpp>
+#include <cadmium/modeling/dynamic_model_translator.hpp>
+#include <cadmium/engine/pdevs_dynamic_runner.hpp>
+#include <cadmium/logger/common_loggers.hpp>
+
+// Time class header
+#include <NDTime.hpp>
+
+// Message structures
+#include "../data_structures/message.hpp"
+#include "../data_structures/particle_store.hpp"
+#include "../data_structures/log_filter.hpp"
+
+// Atomic model headers
+#include <cadmium/basic_model/pdevs/iestream.hpp>  // atomic model for inputs
+#include "../atomics/random_impulse.hpp"
+#include "../atomics/responder.hpp"
+#include "../atomics/tracker.hpp"
+#include "../atomics/subV.hpp"
+
+// Inter-process transport
+#include "../utilities/shm_ring.hpp"
+#include "../utilities/shm_barrier.hpp"
+#include "../utilities/async_log.hpp"
+#include "../utilities/checkpoint_clock.hpp"  // models resume from their own times when a runner is rebuilt
+
+// C++ libraries
+#include <iostream>
+#include <string>
+#include <nlohmann/json.hpp>  // Used to parse JSON files and manipulate the resulting data
+#include <fstream>  // Used to read from files
+#include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <algorithm>
+#include <numeric>  // iota
+#include <cmath>  // nextafter
+#include <random>  // default_random_engine::default_seed
+#include <stdexcept>
+
+// POSIX process management
+#include <sys/wait.h>
+#include <unistd.h>
+#include <csignal>  // kill, SIGTERM
+#include <cerrno>
+
+using namespace std;
+using namespace cadmium;
+using namespace cadmium::basic_models::pdevs;
+
+using json = nlohmann::json;
+using TIME = float;
+
+/*
+Domain decomposition over shared memory
+
+The particles are split into slabs along the first axis and every slab is simulated by its own
+process (RI, responder, tracker and subV). Processes advance in windows and meet at a barrier at every
+window boundary, where particles are handed between neighbouring domains through shared-memory ring buffers:
+- every domain sends the particles close to each of its boundaries (position and velocity at the window
+  boundary) to the domain on the other side, so that both domains know the same particles there
+- from these, both domains make the same handover decisions (see decideHandovers): a particle that is not
+  loaded goes to the domain its position is in, and particles predicted to touch before the next window
+  boundary go to the same domain, whose subV detects their collision
+- a particle leaving a domain is removed from its subV, RI and responder and erased from its store, and is
+  sent with the state they keep for it (kinematic state, response velocity, random streams and next impulse),
+  the domain taking it over inserts it into its store and models
+- a domain whose particles changed rebuilds its runner at the window boundary, every model resuming from its own
+  times as after a restart (see resume_t), so its state log shows the state of every model again
+- the domains then agree on the time of the earliest next event of any of them (impulse, collision, response),
+  and the window ends just after it (or after "window" if that comes first). Velocities only change at the end of
+  a window, so contacts predicted at its start are every contact across a boundary in it.
+A particle is close to a boundary within the largest distance a particle covers in a window at its velocity plus
+its radius, twice (over every domain), plus how far loaded particles are past the boundary of their slab.
+A domain that fails aborts the barrier, so that the others stop instead of waiting for it, and the parent process
+terminates the domains still running as soon as one of them exits with an error.
+
+Limitations:
+- Domains meet at the barrier after every event time of the whole system, which limits what more domains gain.
+- Loaded particles stay in their domain until their cluster is restituted (the particles they are predicted to
+  touch are handed to them instead). Two loaded clusters of different domains that meet do not collide (a warning
+  is printed).
+- A particle predicted to touch particles that have to stay in different domains (ex. two loaded clusters) only
+  joins the domain of its earliest contact.
+- Domains only exchange particles with their neighbours, and a particle is only sent across the nearer boundary of
+  its slab. When particles come within the distance above of both boundaries of a slab they can meet particles of
+  a domain further away without colliding (a warning is printed, use shorter windows or fewer domains).
+- Checkpoints are not supported (configs with "checkpoint" or "restart" are rejected).
+*/
+
+// particle close to the boundary between two domains, sent to the domain on the other side
+struct boundary_record_t {
+    int p_id;
+    bool loaded;  // loaded particles stay in their domain
+    float radius;
+    float position[MESSAGE_MAX_DIM];  // at the window boundary
+    float velocity[MESSAGE_MAX_DIM];
+};
+
+// particle handed to a neighbouring domain, with the state its models keep for it
+struct migration_record_t {
+    int p_id;
+    int from_domain;
+    float time;  // time of the handover
+    int species;  // index in the species table (the same in every domain)
+    float particle_time;  // time of the position
+    float position[MESSAGE_MAX_DIM];
+    float velocity[MESSAGE_MAX_DIM];
+    float response_velocity[MESSAGE_MAX_DIM];
+    PhiloxStream time_stream;  // random impulse streams
+    PhiloxStream impulse_stream;
+    int num_impulses;  // pre-generated impulses (0 or batch_size * dim values)
+    float impulses[RandomImpulse<TIME>::batch_size * MESSAGE_MAX_DIM];
+    int next_impulse;
+    float impulse_time;  // time of the next random impulse
+};
+
+// rings between neighbouring domains, formatted: {from, to} -> ring
+struct domain_rings_t {
+    map<pair<int, int>, ShmRing<boundary_record_t>> boundary;
+    map<pair<int, int>, ShmRing<migration_record_t>> migration;
+};
+
+/*** Forward References ***/
+vector<json> partitionParticles (json&, int, vector<float>&);
+template <template<typename> class RI_MODEL> int runDomain (int, json&, vector<float>&, int, float, float, ShmBarrier&, domain_rings_t&);
+vector<int> decideHandovers (int, float, const vector<boundary_record_t>&, const vector<boundary_record_t>&, int, float, vector<tuple<float, int, int>>&);
+template <template<typename> class MODEL> function<void(TIME)> resumeModel (shared_ptr<dynamic::modeling::model>);
+template <template<typename> class MODEL> function<TIME()> nextEvent (shared_ptr<dynamic::modeling::model>);
+
+/*** Define input ports for coupled models ***/
+struct detector_response_in : public in_port<message_t>{};
+struct lattice_response_in : public in_port<tracker_message_t>{};
+
+/*** Define output ports for coupled models ***/
+struct top_out : public out_port<message_t>{};
+struct lattice_collision_out : public out_port<collision_message_t>{};
+struct detector_collision_out : public out_port<collision_message_t>{};
+
+/*** Loggers (files are opened per domain after forking, so that each domain has its own writer thread) ***/
+static AsyncLogStream out_messages;
+static AsyncLogStream out_state;
+static ofstream out_migrations;
+struct oss_sink_messages{
+    static ostream& sink(){
+        return out_messages;
+    }
+};
+struct oss_sink_state{
+    static ostream& sink(){
+        return out_state;
+    }
+};
+
+using state=logger::logger<logger::logger_state, dynamic::logger::formatter<TIME>, oss_sink_state>;
+using log_messages=logger::logger<logger::logger_messages, dynamic::logger::formatter<TIME>, oss_sink_messages>;
+using global_time_mes=logger::logger<logger::logger_global_time, dynamic::logger::formatter<TIME>, oss_sink_messages>;
+using global_time_sta=logger::logger<logger::logger_global_time, dynamic::logger::formatter<TIME>, oss_sink_state>;
+
+using logger_top=logger::multilogger<state, log_messages, global_time_mes, global_time_sta, CheckpointClock<TIME>>;
+
+int main (int argc, char** argv) {
+    // Get initial particle information prepared
+    string filename = "../input/config.json";
+    if (argc >= 2) {
+        filename = argv[1];
+    }
+    ifstream ifs(filename);
+    json configJson = json::parse(ifs);
+    float runtime = configJson["config"]["runtime"];
+    int num_domains = configJson["config"].value("domains", 2);
+    float window = configJson["config"].value("window", 1.0);
+    string ri_queue = configJson["config"].value("ri_queue", "heap");  // "heap" (binary heap) or "calendar" (calendar queue) to schedule the impulses of every domain
+    if (argc >= 3) {
+        num_domains = stoi(argv[2]);  // allow the number of domains to be overridden from the command line
+    }
+    if (num_domains <= 0) throw invalid_argument("domains must be positive");
+    if (!(window > 0)) throw invalid_argument("window must be positive");
+    if (ri_queue != "heap" && ri_queue != "calendar") throw invalid_argument("unknown RI queue: " + ri_queue + " (expected \"heap\" or \"calendar\")");
+    if (configJson["config"].contains("checkpoint") || configJson["config"].contains("restart")) {
+        cerr << "domain test: checkpoints are not supported, run the config with ITER_1_TEST" << endl;
+        return 1;
+    }
+
+    vector<float> boundaries;  // slab edges along the first axis (num_domains + 1 values)
+    vector<json> slabs = partitionParticles(configJson, num_domains, boundaries);
+
+    // shared segments are created before forking, children use the inherited mappings
+    // (a domain may come to hold every particle, and sends each of them at most once per window)
+    string prefix = "/tps_domain_" + to_string(getpid());
+    ShmBarrier barrier = ShmBarrier::create(prefix + "_barrier", num_domains);
+    domain_rings_t rings;
+    for (int from = 0; from < num_domains; ++from) {
+        for (int to : {from - 1, from + 1}) {
+            if (to < 0 || to >= num_domains) continue;
+            string name = prefix + "_" + to_string(from) + "_" + to_string(to);
+            rings.boundary[{from, to}] = ShmRing<boundary_record_t>::create(name + "_boundary", configJson["particles"].size() + 1);
+            rings.migration[{from, to}] = ShmRing<migration_record_t>::create(name + "_migration", configJson["particles"].size() + 1);
+        }
+    }
+    int dim = configJson["particles"].begin().value()["position"].size();
+
+    // a domain that fails takes the others down with it rather than leaving them waiting for it at the barrier
+    vector<pid_t> children;  // still running
+    auto stop_children = [&barrier, &children]() {
+        barrier.abort();
+        for (pid_t pid : children) kill(pid, SIGTERM);
+    };
+
+    for (int domain = 0; domain < num_domains; ++domain) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            cerr << "domain test: fork failed" << endl;
+            stop_children();
+            break;
+        }
+        if (pid == 0) {
+            // exit (rather than return) so that the child does not release the parent's shared segments
+            int result = 1;
+            try {
+                if (ri_queue == "calendar") {
+                    result = runDomain<CalendarRandomImpulse>(domain, slabs[domain], boundaries, dim, runtime, window, barrier, rings);
+                }
+                else {
+                    result = runDomain<RandomImpulse>(domain, slabs[domain], boundaries, dim, runtime, window, barrier, rings);
+                }
+            } catch (const exception& e) {
+                cerr << "domain " << domain << ": " << e.what() << endl;
+            }
+            if (result != 0) barrier.abort();
+            exit(result);
+        }
+        children.push_back(pid);
+    }
+
+    int result = (int(children.size()) == num_domains) ? 0 : 1;
+    while (!children.empty()) {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        children.erase(remove(children.begin(), children.end(), pid), children.end());
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            if (result == 0) stop_children();
+            result = 1;
+        }
+    }
+    return result;
+}
+
+// simulate one slab and hand particles over to the neighbouring slabs at every window boundary
+template <template<typename> class RI_MODEL>
+int runDomain (int domain, json& slab, vector<float>& boundaries, int dim, float runtime, float window,
+               ShmBarrier& barrier, domain_rings_t& rings) {
+    string results_prefix = "../simulation_results/domain_" + to_string(domain);
+    size_t log_buffer = slab["config"].value("log_buffer", AsyncLogBuf::default_capacity);  // bytes of log text queued for the writer thread
+    log_overflow_t log_overflow = parse_log_overflow(slab["config"].value("log_overflow", "block"));  // "block" or "drop" when the queue is full
+    float log_index_interval = slab["config"].value("log_index_interval", 0.0);  // time covered by each entry of the logs' sidecar indexes (0 for none)
+    out_messages.open(results_prefix + "_output_messages.txt", log_buffer, log_overflow, log_index_interval);
+    out_state.open(results_prefix + "_output_state.txt", log_buffer, log_overflow, log_index_interval);
+    out_migrations.open(results_prefix + "_migrations.txt");
+
+    bool do_ri = slab["config"]["ri"];
+    // random streams are per particle, so every domain uses the same seed and the impulses do not depend on the number of domains
+    unsigned int seed = slab["config"].value("seed", default_random_engine::default_seed);
+    int num_domains = boundaries.size() - 1;
+
+    // an empty slab still has its models, particles may be handed to it later
+    shared_ptr<ParticleStore> particles = make_shared<ParticleStore>(slab);  // shared by the models of this domain
+    shared_ptr<LogFilter> log_filter;  // logging messages of subV to produce (every message without a "log_filter" object)
+    if (slab["config"].contains("log_filter")) log_filter = make_shared<LogFilter>(slab["config"]["log_filter"]);
+
+    /*** RI atomic model instantiation ***/
+    shared_ptr<dynamic::modeling::model> random_impulse;
+    random_impulse = dynamic::translate::make_dynamic_atomic_model<RI_MODEL, TIME, shared_ptr<ParticleStore>, vector<int>, bool, unsigned int>
+            ("random_impulse", shared_ptr<ParticleStore>(particles), vector<int>(particles->ids()), move(do_ri), move(seed));
+
+    /*** Responder atomic model instantiation ***/
+    shared_ptr<dynamic::modeling::model> responder;
+    responder = dynamic::translate::make_dynamic_atomic_model<Responder, TIME, shared_ptr<ParticleStore>>("responder", shared_ptr<ParticleStore>(particles));
+
+    /*** Tracker atomic model instantiation ***/
+    shared_ptr<dynamic::modeling::model> tracker;
+    tracker = dynamic::translate::make_dynamic_atomic_model<Tracker, TIME>("tracker");
+
+    /*** SubV atomimc model instantiation ***/
+    shared_ptr<dynamic::modeling::model> subV;
+    subV = dynamic::translate::make_dynamic_atomic_model<SubV, TIME, shared_ptr<ParticleStore>, shared_ptr<LogFilter>>("subV", shared_ptr<ParticleStore>(particles), shared_ptr<LogFilter>(log_filter));
+
+    /*** LATTICE COUPLED MODEL ***/
+    dynamic::modeling::Ports iports_lattice;
+    iports_lattice = {typeid(lattice_response_in)};
+    dynamic::modeling::Ports oports_lattice;
+    oports_lattice = {typeid(lattice_collision_out)};
+    dynamic::modeling::Models submodels_lattice;
+    submodels_lattice = {subV};
+    dynamic::modeling::EICs eics_lattice;  // external input couplings
+    eics_lattice = {
+        dynamic::translate::make_EIC<lattice_response_in, SubV_defs::response_in>("subV")  // lattice -> subV
+    };
+    dynamic::modeling::EOCs eocs_lattice;
+    eocs_lattice = {
+        dynamic::translate::make_EOC<SubV_defs::collision_out, lattice_collision_out>("subV"),  // subV -> lattice
+    };
+    dynamic::modeling::ICs ics_lattice;
+    ics_lattice = {};
+    shared_ptr<dynamic::modeling::coupled<TIME>> lattice;
+    lattice = make_shared<dynamic::modeling::coupled<TIME>>(
+        "lattice", submodels_lattice, iports_lattice, oports_lattice, eics_lattice, eocs_lattice, ics_lattice
+    );
+
+    /*** DETECTOR COUPLED MODEL ***/
+    dynamic::modeling::Ports iports_detector;
+    iports_detector = {typeid(detector_response_in)};
+    dynamic::modeling::Ports oports_detector;
+    oports_detector = {typeid(detector_collision_out)};
+    dynamic::modeling::Models submodels_detector;
+    submodels_detector = {tracker, lattice};
+    dynamic::modeling::EICs eics_detector;  // external input couplings
+    eics_detector = {
+        dynamic::translate::make_EIC<detector_response_in, Tracker_defs::response_in>("tracker")  // detector -> tracker
+    };
+    dynamic::modeling::EOCs eocs_detector;
+    eocs_detector = {
+        dynamic::translate::make_EOC<lattice_collision_out, detector_collision_out>("lattice"),  // lattice -> detector
+    };
+    dynamic::modeling::ICs ics_detector;
+    ics_detector = {
+        dynamic::translate::make_IC<Tracker_defs::response_out, lattice_response_in>("tracker", "lattice")
+    };
+    shared_ptr<dynamic::modeling::coupled<TIME>> detector;
+    detector = make_shared<dynamic::modeling::coupled<TIME>>(
+        "detector", submodels_detector, iports_detector, oports_detector, eics_detector, eocs_detector, ics_detector
+    );
+
+    /*** TOP MODEL ***/
+    dynamic::modeling::Ports iports_TOP;
+    iports_TOP = {};
+    dynamic::modeling::Ports oports_TOP;
+    oports_TOP = {typeid(top_out)};
+    dynamic::modeling::Models submodels_TOP;
+    submodels_TOP = {random_impulse, responder, detector};
+    dynamic::modeling::EICs eics_TOP;  // external input couplings
+    eics_TOP = {};
+    dynamic::modeling::EOCs eocs_TOP;
+    eocs_TOP = {
+        dynamic::translate::make_EOC<Responder_defs::response_out, top_out>("responder")
+    };
+    dynamic::modeling::ICs ics_TOP;
+    ics_TOP = {
+        dynamic::translate::make_IC<RandomImpulse_defs::impulse_out, Responder_defs::impulse_in>("random_impulse", "responder"),
+        dynamic::translate::make_IC<Responder_defs::response_out, detector_response_in>("responder", "detector"),
+        dynamic::translate::make_IC<detector_collision_out, Responder_defs::collision_in>("detector", "responder"),
+    };
+    shared_ptr<dynamic::modeling::coupled<TIME>> TOP;
+    TOP = make_shared<dynamic::modeling::coupled<TIME>>(
+        "TOP", submodels_TOP, iports_TOP, oports_TOP, eics_TOP, eocs_TOP, ics_TOP
+    );
+
+    // the models particles are handed to and taken from, and how each of them resumes in a rebuilt runner
+    shared_ptr<RI_MODEL<TIME>> ri_model = dynamic_pointer_cast<RI_MODEL<TIME>>(random_impulse);
+    shared_ptr<Responder<TIME>> responder_model = dynamic_pointer_cast<Responder<TIME>>(responder);
+    shared_ptr<SubV<TIME>> subV_model = dynamic_pointer_cast<SubV<TIME>>(subV);
+    vector<function<void(TIME)>> resume = {
+        resumeModel<RI_MODEL>(random_impulse),
+        resumeModel<Responder>(responder),
+        resumeModel<Tracker>(tracker),
+        resumeModel<SubV>(subV)
+    };
+    vector<function<TIME()>> next_event = {
+        nextEvent<RI_MODEL>(random_impulse),
+        nextEvent<Responder>(responder),
+        nextEvent<Tracker>(tracker),
+        nextEvent<SubV>(subV)
+    };
+
+    /*** Runner calls (one per window) ***/
+    unique_ptr<dynamic::engine::runner<TIME, logger_top>> r(new dynamic::engine::runner<TIME, logger_top>(TOP, {0}));
+
+    // narrowest slab that has two boundaries (particles are sent across the nearer of them)
+    float slab_width = numeric_limits<float>::infinity();
+    for (int i = 1; i < num_domains - 1; ++i) slab_width = min(slab_width, boundaries[i + 1] - boundaries[i]);
+    bool warned = false;
+    set<pair<int, int>> reported;  // missed collisions already reported, formatted: {lower pID, higher pID}
+
+    TIME horizon = 0;
+    while (horizon < runtime) {
+        if (num_domains == 1) {
+            horizon = min(runtime, horizon + window);
+            r->run_until(horizon);
+            continue;
+        }
+
+        CheckpointClock<TIME>::now = horizon;  // particles are handed over at the window boundary
+        float lookahead = min(runtime, horizon + window) - horizon;
+
+        // position of every particle at the window boundary
+        vector<float> positions(particles->size() * dim);
+        particles->positions_at(horizon, positions.data());
+
+        // distance within which particles are sent to the other side of a boundary: a particle can touch particles
+        // within its reach plus theirs, and loaded particles can be past the boundary of their slab
+        float reach = 0;
+        float overhang_reach = 0;  // reach plus the distance past the slab
+        for (size_t i = 0; i < particles->size(); ++i) {
+            int p_id = particles->ids()[i];
+            float x = positions[i * dim];
+            float particle_reach = VectorUtils::length(particles->velocity(p_id)) * lookahead + particles->radius(p_id);
+            float overhang = max({0.0f, boundaries[domain] - x, x - boundaries[domain + 1]});
+            reach = max(reach, particle_reach);
+            overhang_reach = max(overhang_reach, overhang + particle_reach);
+        }
+        float halo = -barrier.wait(-reach);
+        halo += -barrier.wait(-overhang_reach);
+        if (domain == 0 && !warned && halo > slab_width / 2) {
+            cerr << "domain test: particles reach " << halo << " from a boundary in a window, more than half a slab ("
+                 << slab_width << "), they can miss collisions with particles further away (use shorter windows)" << endl;
+            warned = true;
+        }
+
+        // send the particles close to a boundary to the domain on the other side
+        map<int, vector<boundary_record_t>> sent;  // formatted: {neighbour, records}
+        float middle = (boundaries[domain] + boundaries[domain + 1]) / 2;
+        for (size_t i = 0; i < particles->size(); ++i) {
+            int p_id = particles->ids()[i];
+            const float* position = &positions[i * dim];
+            bool lower_side = (domain == num_domains - 1) || (domain > 0 && position[0] < middle);
+            int neighbour = lower_side ? domain - 1 : domain + 1;
+            if (lower_side ? position[0] >= boundaries[domain] + halo : position[0] < boundaries[domain + 1] - halo) continue;
+
+            boundary_record_t record = {};
+            record.p_id = p_id;
+            record.loaded = responder_model->loaded(p_id);
+            record.radius = particles->radius(p_id);
+            copy_n(position, dim, record.position);
+            copy_n(particles->velocity(p_id).data(), dim, record.velocity);
+            if (!rings.boundary[{domain, neighbour}].push(record)) {
+                cerr << "domain " << domain << ": boundary ring to domain " << neighbour << " is full" << endl;
+                return 1;
+            }
+            sent[neighbour].push_back(record);
+        }
+        barrier.wait(0);
+
+        // every domain decides the handovers across its boundaries from the same records as its neighbours
+        map<int, unordered_set<int>> leaving;  // formatted: {neighbour, {pID}}
+        for (int neighbour : {domain - 1, domain + 1}) {
+            if (neighbour < 0 || neighbour >= num_domains) continue;
+            vector<boundary_record_t> received;
+            boundary_record_t record;
+            while (rings.boundary[{neighbour, domain}].pop(record)) received.push_back(record);
+
+            int lower = min(domain, neighbour);
+            const vector<boundary_record_t>& lower_records = (lower == domain) ? sent[neighbour] : received;
+            const vector<boundary_record_t>& upper_records = (lower == domain) ? received : sent[neighbour];
+            vector<tuple<float, int, int>> missed;
+            vector<int> destinations = decideHandovers(lower, boundaries[lower + 1], lower_records, upper_records, dim, lookahead, missed);
+            for (const auto& [t, low_id, high_id] : missed) {
+                if (lower != domain || !reported.insert({low_id, high_id}).second) continue;
+                cerr << "domain test: particles " << low_id << " and " << high_id << " of domains " << lower << " and " << lower + 1
+                     << " are loaded and predicted to touch at " << horizon + t << ", their collision is missed" << endl;
+            }
+            size_t offset = (lower == domain) ? 0 : lower_records.size();
+            for (size_t i = 0; i < sent[neighbour].size(); ++i) {
+                if (destinations[offset + i] != domain) leaving[neighbour].insert(sent[neighbour][i].p_id);
+            }
+        }
+
+        // take the leaving particles out of the models and hand them over with the state the models keep for them
+        bool changed = false;
+        for (const auto& [neighbour, p_ids] : leaving) {
+            if (p_ids.empty()) continue;
+            changed = true;
+            subV_model->remove_particles(p_ids);
+            unordered_map<int, typename RI_MODEL<TIME>::ri_migrant_t> migrants = ri_model->remove_particles(p_ids);
+            for (int p_id : p_ids) {
+                responder_model->remove_particle(p_id);
+
+                const typename RI_MODEL<TIME>::ri_migrant_t& migrant = migrants.at(p_id);
+                migration_record_t record = {};
+                record.p_id = p_id;
+                record.from_domain = domain;
+                record.time = horizon;
+                record.species = particles->species_of(p_id);
+                record.particle_time = particles->time(p_id);
+                copy_n(particles->position(p_id).data(), dim, record.position);
+                copy_n(particles->velocity(p_id).data(), dim, record.velocity);
+                copy_n(particles->response_velocity(p_id).data(), dim, record.response_velocity);
+                record.time_stream = migrant.particle.time_stream;
+                record.impulse_stream = migrant.particle.impulse_stream;
+                record.num_impulses = migrant.particle.impulses.size();
+                copy(migrant.particle.impulses.begin(), migrant.particle.impulses.end(), record.impulses);
+                record.next_impulse = migrant.particle.next_impulse;
+                record.impulse_time = migrant.next_time;
+                if (!rings.migration[{domain, neighbour}].push(record)) {
+                    cerr << "domain " << domain << ": migration ring to domain " << neighbour << " is full" << endl;
+                    return 1;
+                }
+                particles->erase(p_id);
+                out_migrations << horizon << " departure p_id: " << p_id << " to: " << neighbour << endl;
+            }
+        }
+        barrier.wait(0);
+
+        for (int neighbour : {domain - 1, domain + 1}) {
+            if (neighbour < 0 || neighbour >= num_domains) continue;
+            migration_record_t record;
+            while (rings.migration[{neighbour, domain}].pop(record)) {
+                changed = true;
+                vector_view_t position(record.position, dim);
+                vector_view_t velocity(record.velocity, dim);
+                particles->insert(record.p_id, record.species, position, velocity, record.particle_time);
+                subV_model->add_particle(record.p_id);
+
+                typename RI_MODEL<TIME>::ri_migrant_t migrant;
+                migrant.particle.species = record.species;
+                migrant.particle.time_stream = record.time_stream;
+                migrant.particle.impulse_stream = record.impulse_stream;
+                migrant.particle.impulses.assign(record.impulses, record.impulses + record.num_impulses);
+                migrant.particle.next_impulse = record.next_impulse;
+                migrant.next_time = record.impulse_time;
+                ri_model->add_particle(record.p_id, migrant);
+                responder_model->add_particle(record.p_id, vector_view_t(record.response_velocity, dim));
+
+                vector<float> handover_position(dim);  // at the window boundary
+                for (int i = 0; i < dim; ++i) handover_position[i] = record.position[i] + record.velocity[i] * (record.time - record.particle_time);
+                out_migrations << record.time << " arrival p_id: " << record.p_id << " from: " << record.from_domain
+                               << ", pos: " << VectorUtils::get_string<float>(handover_position, true)
+                               << ", vel: " << VectorUtils::get_string<float>(velocity, true) << endl;
+            }
+        }
+
+        // the runner is rebuilt at the window boundary, every model resuming from its own times
+        if (changed) {
+            for (const function<void(TIME)>& model : resume) model(horizon);
+            r.reset(new dynamic::engine::runner<TIME, logger_top>(TOP, {horizon}));
+        }
+
+        // the window ends just after the earliest next event of any domain: until then velocities only change at
+        // that time, so the contacts predicted above are every contact across a boundary in the window
+        // (every domain computes the same horizons)
+        TIME next = numeric_limits<TIME>::infinity();
+        for (const function<TIME()>& model : next_event) next = min(next, model());
+        next = barrier.wait(next);
+        horizon = min(min(runtime, horizon + window), nextafter(next, numeric_limits<TIME>::infinity()));
+        r->run_until(horizon);
+    }
+
+    out_messages.drain();
+    out_state.drain();
+    if (out_messages.dropped() + out_state.dropped() > 0) {
+        cerr << "domain " << domain << ": log queue full, dropped " << out_messages.dropped() << " message log line(s) and "
+             << out_state.dropped() << " state log line(s)" << endl;
+    }
+    return 0;
+}
+
+// which domain every particle close to the boundary between lower and lower + 1 goes to
+// args: the lower domain, the boundary, the records sent by both domains, dimensions, longest time to the next window
+//       boundary, contacts between particles that stay in different domains (filled, formatted: {time, lower pID, higher pID})
+// return: the domain of every record (records of the lower domain first), the same in both domains
+vector<int> decideHandovers (int lower, float boundary, const vector<boundary_record_t>& lower_records,
+                             const vector<boundary_record_t>& upper_records, int dim, float lookahead,
+                             vector<tuple<float, int, int>>& missed) {
+    vector<boundary_record_t> records = lower_records;
+    records.insert(records.end(), upper_records.begin(), upper_records.end());
+
+    // a particle goes to the domain its position is in, unless it is loaded
+    vector<int> result(records.size());
+    vector<float> reach(records.size());
+    float max_reach = 0;
+    for (size_t i = 0; i < records.size(); ++i) {
+        int home = (i < lower_records.size()) ? lower : lower + 1;
+        result[i] = records[i].loaded ? home : (records[i].position[0] >= boundary ? lower + 1 : lower);
+        reach[i] = VectorUtils::length(vector<float>(records[i].velocity, records[i].velocity + dim)) * lookahead + records[i].radius;
+        max_reach = max(max_reach, reach[i]);
+    }
+
+    // contacts predicted before the next window boundary, formatted: {time, lower pID, higher pID, index, index}
+    vector<size_t> order(records.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&records](size_t lhs, size_t rhs) {
+        return make_pair(records[lhs].position[0], records[lhs].p_id) < make_pair(records[rhs].position[0], records[rhs].p_id);
+    });
+    vector<tuple<float, int, int, size_t, size_t>> contacts;
+    for (size_t a = 0; a < order.size(); ++a) {
+        for (size_t b = a + 1; b < order.size(); ++b) {
+            size_t i = order[a];
+            size_t j = order[b];
+            if (records[j].position[0] - records[i].position[0] > 2 * max_reach) break;
+            if (records[j].position[0] - records[i].position[0] > reach[i] + reach[j]) continue;
+            float t = SubV<TIME>::contact_time(records[i].position, records[i].velocity, records[j].position, records[j].velocity,
+                                               dim, records[i].radius + records[j].radius);
+            if (t < 0 || t > lookahead) continue;
+            contacts.emplace_back(t, min(records[i].p_id, records[j].p_id), max(records[i].p_id, records[j].p_id), i, j);
+        }
+    }
+    sort(contacts.begin(), contacts.end());
+
+    // from the earliest contact, particles predicted to touch go to the same domain (the particle with the higher ID
+    // moves if it can), a particle keeps the domain of its earliest contact
+    vector<bool> placed(records.size(), false);
+    for (const auto& [t, low_id, high_id, i, j] : contacts) {
+        if (result[i] != result[j]) {
+            size_t high = (records[i].p_id == high_id) ? i : j;
+            size_t low = (high == i) ? j : i;
+            if (!records[high].loaded && !placed[high]) result[high] = result[low];
+            else if (!records[low].loaded && !placed[low]) result[low] = result[high];
+            else if (records[high].loaded && records[low].loaded) missed.emplace_back(t, low_id, high_id);
+        }
+        placed[i] = true;
+        placed[j] = true;
+    }
+    return result;
+}
+
+// resume a model in a rebuilt runner from the times of its last and next transitions (see resume_t)
+// args: the model (made with make_dynamic_atomic_model<MODEL, TIME, ...>)
+// return: sets the times of the model for a runner starting at its argument
+template <template<typename> class MODEL>
+function<void(TIME)> resumeModel (shared_ptr<dynamic::modeling::model> model) {
+    shared_ptr<MODEL<TIME>> atomic = dynamic_pointer_cast<MODEL<TIME>>(model);
+    assert(atomic != nullptr && "resumed model of another type");
+    return [atomic](TIME start) {
+        // a model is never due before the runner starts (its next time may round below the window boundary)
+        TIME next = max(start, atomic->state.resume.next_time(atomic->time_advance()));
+        atomic->state.resume.set(start, atomic->state.resume.last, next);
+    };
+}
+
+// time of the next event of a model
+// args: the model (made with make_dynamic_atomic_model<MODEL, TIME, ...>)
+// return: the time of its next internal transition, between two windows
+template <template<typename> class MODEL>
+function<TIME()> nextEvent (shared_ptr<dynamic::modeling::model> model) {
+    shared_ptr<MODEL<TIME>> atomic = dynamic_pointer_cast<MODEL<TIME>>(model);
+    assert(atomic != nullptr && "model of another type");
+    return [atomic]() {
+        return atomic->state.resume.next_time(atomic->time_advance());
+    };
+}
+
+// split the particles of a config into num_domains slabs of equal width along the first axis
+// each returned config keeps the original config and species blocks
+vector<json> partitionParticles (json& j, int num_domains, vector<float>& boundaries) {
+    float low = numeric_limits<float>::infinity();
+    float high = -numeric_limits<float>::infinity();
+    for (auto it = j["particles"].begin(); it != j["particles"].end(); ++it) {
+        float x = j["particles"][it.key()]["position"][0];
+        low = min(low, x);
+        high = max(high, x);
+    }
+    float width = (high - low) / num_domains;
+
+    boundaries.clear();
+    for (int i = 0; i <= num_domains; ++i) {
+        boundaries.push_back(low + i * width);
+    }
+    // particles may travel beyond the initial extent, the outer slabs are unbounded
+    boundaries.front() = -numeric_limits<float>::infinity();
+    boundaries.back() = numeric_limits<float>::infinity();
+
+    vector<json> result(num_domains);
+    for (json& slab : result) {
+        slab["config"] = j["config"];
+        slab["species"] = j["species"];
+        slab["particles"] = json::object();
+    }
+    for (auto it = j["particles"].begin(); it != j["particles"].end(); ++it) {
+        float x = j["particles"][it.key()]["position"][0];
+        int domain = width > 0 ? min(num_domains - 1, (int)((x - low) / width)) : 0;
+        result[domain]["particles"][it.key()] = it.value();
+    }
+    return result;
+}
@@ -10,13 +10,24 @@
 
 // Message structures
 #include "../data_structures/message.hpp"
+#include "../data_structures/particle_store.hpp"
+#include "../data_structures/log_filter.hpp"
 
 // Atomic model headers
 #include <cadmium/basic_model/pdevs/iestream.hpp>  // atomic model for inputs
 #include "../atomics/random_impulse.hpp"
+#include "../atomics/random_impulse_replay.hpp"
 #include "../atomics/responder.hpp"
 #include "../atomics/tracker.hpp"
 #include "../atomics/subV.hpp"
+#include "../atomics/event_logger.hpp"
+#include "../atomics/frame_recorder.hpp"
+#include "../atomics/trajectory_logger.hpp"
+
+// Utilities
+#include "../utilities/async_log.hpp"
+#include "../utilities/checkpoint.hpp"
+#include "../utilities/checkpoint_clock.hpp"
 
 // C++ libraries
 #include <iostream>
@@ -24,6 +35,14 @@
 #include <nlohmann/json.hpp>  // Used to parse JSON files and manipulate the resulting data
 #include <fstream>  // Used to read from files
 #include <map>
+#include <vector>
+#include <memory>
+#include <random>  // default_random_engine::default_seed
+#include <algorithm>  // sort, min
+#include <functional>
+#include <stdexcept>
+#include <cmath>  // nextafter, floor
+#include <csignal>
 
 using namespace std;
 using namespace cadmium;
@@ -32,8 +51,22 @@ using namespace cadmium::basic_models::pdevs;
 using json = nlohmann::json;
 using TIME = float;
 
+// a model whose state is saved in checkpoints
+struct checkpointed_model_t {
+    function<void(CheckpointWriter&)> save;  // args: checkpoint
+    function<void(CheckpointReader&, TIME)> restore;  // args: checkpoint, time the restored run starts at
+    function<TIME()> next;  // time of the next internal transition
+};
+
 /*** Forward References ***/
-json prepParticlesJSON (json&, vector<string>, vector<string>);
+vector<vector<int>> shardParticles (ParticleStore&, int, string);
+string shardTapePath (string, int, int);
+template <template<typename> class MODEL> checkpointed_model_t checkpointedModel (shared_ptr<dynamic::modeling::model>, string);
+template <typename LOGGER> bool runCheckpointed (shared_ptr<dynamic::modeling::coupled<TIME>>, TIME, TIME, float, string, const vector<checkpointed_model_t>&, const ParticleStore&);
+void saveCheckpoint (string, TIME, const vector<checkpointed_model_t>&, const ParticleStore&);
+void requestCheckpoint (int);
+
+volatile sig_atomic_t checkpoint_requested = 0;  // set on SIGTERM
 
 /*** Define input ports for coupled models ***/
 struct detector_response_in : public in_port<message_t>{};
@@ -50,23 +83,65 @@ int main (int argc, char** argv) {
     if (argc == 2) {
         filename = argv[1];
     }
-    ifstream ifs(filename);
-    json configJson = json::parse(ifs);
+    // one copy of the particles shared by every model (read straight into the store, configJson holds the rest of the file);
+    // filename is a JSON config or a particle file converted from one with PARTICLE_CONVERT
+    json configJson;
+    shared_ptr<ParticleStore> particles = ParticleStore::load(filename, configJson);
     bool do_ri = configJson["config"]["ri"];
     float runtime = configJson["config"]["runtime"];
-    int dim = configJson["particles"][configJson["particles"].begin().key()]["position"].size();  // get number of dimensions
-    json ri_particles = prepParticlesJSON(configJson, {}, {"mass", "tau", "shape", "mean"});
-    json re_particles = prepParticlesJSON(configJson, {"velocity"}, {"mass"});  // position is not required in the responder
-    json de_particles = prepParticlesJSON(configJson, {"position", "velocity"}, {"radius"});
+    int ri_shards = configJson["config"].value("ri_shards", 1);  // number of independent RI models
+    string ri_shard_by = configJson["config"].value("ri_shard_by", "id");  // "id" (particle ID ranges) or "region" (slabs along the first axis, from the initial positions)
+    string ri_queue = configJson["config"].value("ri_queue", "heap");  // "heap" (binary heap) or "calendar" (calendar queue) to schedule the impulses of every RI shard
+    unsigned int seed = configJson["config"].value("seed", default_random_engine::default_seed);
+    string ri_record = configJson["config"].value("ri_record", "");  // tape to record the sent impulses to
+    string ri_replay = configJson["config"].value("ri_replay", "");  // tape to send impulses from instead of generating them
+    string event_log = configJson["config"].value("event_log", "");  // binary log of the subV logging messages (read with event_log.py)
+    bool event_log_particle_index = configJson["config"].value("event_log_particle_index", false);  // index of the records of every particle (queried with PARTICLE_QUERY)
+    string trajectory_log = configJson["config"].value("trajectory_log", "");  // compact log of the subV logging messages (read with trajectory.py)
+    float trajectory_velocity_quantum = configJson["config"].value("trajectory_velocity_quantum", 0.0);  // 0 to log velocities exactly
+    float trajectory_position_quantum = configJson["config"].value("trajectory_position_quantum", 0.0);  // 0 to log positions exactly
+    size_t log_buffer = configJson["config"].value("log_buffer", AsyncLogBuf::default_capacity);  // bytes of log text queued for the writer thread
+    log_overflow_t log_overflow = parse_log_overflow(configJson["config"].value("log_overflow", "block"));  // "block" or "drop" when the queue is full
+    float log_index_interval = configJson["config"].value("log_index_interval", 0.0);  // time covered by each entry of the logs' sidecar indexes (0 for none)
+    float frame_interval = configJson["config"].value("frame_interval", 0.0);  // time between frames of every particle's position (0 for none)
+    string frame_log = configJson["config"].value("frame_log", "../simulation_results/iter_1_test_frames.bin");  // read with frame_log.py
+    bool cadmium_logs = configJson["config"].value("cadmium_logs", true);  // message and state logs (can be turned off when frames are enough)
+    string checkpoint = configJson["config"].value("checkpoint", "");  // state saved every checkpoint_interval, at the end of the run and on SIGTERM (which then stops the run)
+    float checkpoint_interval = configJson["config"].value("checkpoint_interval", 0.0);  // simulation time between checkpoints (0 for none before the end)
+    string restart = configJson["config"].value("restart", "");  // checkpoint to continue from (written with the same config, logs start new files)
+
+    if (ri_queue != "heap" && ri_queue != "calendar") throw invalid_argument("unknown RI queue: " + ri_queue + " (expected \"heap\" or \"calendar\")");
+    vector<vector<int>> ri_shard_particles = shardParticles(*particles, ri_shards, ri_shard_by);
 
-    /*** RI atomic model instantiation ***/
-    shared_ptr<dynamic::modeling::model> random_impulse;
-    random_impulse = dynamic::translate::make_dynamic_atomic_model<RandomImpulse, TIME, json, int, bool>
-            ("random_impulse", move(ri_particles), move(dim), move(do_ri));
+    // logging messages of subV to produce (every message without a "log_filter" object)
+    shared_ptr<LogFilter> log_filter;
+    if (configJson["config"].contains("log_filter")) log_filter = make_shared<LogFilter>(configJson["config"]["log_filter"]);
+
+    /*** RI atomic model instantiation (one model per shard) ***/
+    // random streams are per particle, so every shard uses the same seed and the impulses do not depend on the number of shards
+    // shards send impulses at the same time independently, the responder resolves every impulse of a bag in one transition
+    // with ri_replay, each shard is replaced by a model replaying the tape recorded by the same shard
+    vector<shared_ptr<dynamic::modeling::model>> random_impulses;
+    for (int i = 0; i < ri_shards; ++i) {
+        if (ri_replay.size() > 0) {
+            random_impulses.push_back(dynamic::translate::make_dynamic_atomic_model<RandomImpulseReplay, TIME, string>
+                    ("random_impulse_" + to_string(i), shardTapePath(ri_replay, i, ri_shards)));
+        }
+        else if (ri_queue == "calendar") {
+            string tape_path = (ri_record.size() > 0) ? shardTapePath(ri_record, i, ri_shards) : "";
+            random_impulses.push_back(dynamic::translate::make_dynamic_atomic_model<CalendarRandomImpulse, TIME, shared_ptr<ParticleStore>, vector<int>, bool, unsigned int, string>
+                    ("random_impulse_" + to_string(i), shared_ptr<ParticleStore>(particles), move(ri_shard_particles[i]), bool(do_ri), (unsigned int)(seed), move(tape_path)));
+        }
+        else {
+            string tape_path = (ri_record.size() > 0) ? shardTapePath(ri_record, i, ri_shards) : "";
+            random_impulses.push_back(dynamic::translate::make_dynamic_atomic_model<RandomImpulse, TIME, shared_ptr<ParticleStore>, vector<int>, bool, unsigned int, string>
+                    ("random_impulse_" + to_string(i), shared_ptr<ParticleStore>(particles), move(ri_shard_particles[i]), bool(do_ri), (unsigned int)(seed), move(tape_path)));
+        }
+    }
 
     /*** Responder atomic model instantiation ***/
     shared_ptr<dynamic::modeling::model> responder;
-    responder = dynamic::translate::make_dynamic_atomic_model<Responder, TIME, json>("responder", move(re_particles));
+    responder = dynamic::translate::make_dynamic_atomic_model<Responder, TIME, shared_ptr<ParticleStore>>("responder", shared_ptr<ParticleStore>(particles));
 
     /*** Tracker atomic model instantiation ***/
     shared_ptr<dynamic::modeling::model> tracker;
@@ -74,7 +149,63 @@ int main (int argc, char** argv) {
 
     /*** SubV atomimc model instantiation ***/
     shared_ptr<dynamic::modeling::model> subV;
-    subV = dynamic::translate::make_dynamic_atomic_model<SubV, TIME, json>("subV", move(de_particles));
+    subV = dynamic::translate::make_dynamic_atomic_model<SubV, TIME, shared_ptr<ParticleStore>, shared_ptr<LogFilter>>("subV", shared_ptr<ParticleStore>(particles), shared_ptr<LogFilter>(log_filter));
+
+    /*** Frame recorder atomic model instantiation (reads the particle store, no couplings) ***/
+    shared_ptr<dynamic::modeling::model> frame_recorder;
+    if (frame_interval > 0) {
+        frame_recorder = dynamic::translate::make_dynamic_atomic_model<FrameRecorder, TIME, shared_ptr<ParticleStore>, TIME, string>
+                ("frame_recorder", shared_ptr<ParticleStore>(particles), TIME(frame_interval), move(frame_log));
+    }
+
+    /*** Event and trajectory logger atomic model instantiation (coupled to subV in the lattice) ***/
+    shared_ptr<dynamic::modeling::model> event_logger;
+    if (event_log.size() > 0) {
+        event_logger = dynamic::translate::make_dynamic_atomic_model<EventLogger, TIME, string, int, float, bool>
+                ("event_logger", move(event_log), particles->dimensions(), float(log_index_interval), bool(event_log_particle_index));
+    }
+    shared_ptr<dynamic::modeling::model> trajectory_logger;
+    if (trajectory_log.size() > 0) {
+        trajectory_logger = dynamic::translate::make_dynamic_atomic_model<TrajectoryLogger, TIME, string, int, float, float>
+                ("trajectory_logger", move(trajectory_log), particles->dimensions(), float(trajectory_velocity_quantum), float(trajectory_position_quantum));
+    }
+
+    /*** Checkpoints ***/
+    // the loggers only save their clocks and counts, they write the events after the checkpoint to new files
+    vector<checkpointed_model_t> checkpointed;
+    for (int i = 0; i < ri_shards; ++i) {
+        if (ri_replay.size() > 0) {
+            checkpointed.push_back(checkpointedModel<RandomImpulseReplay>(random_impulses[i], "random_impulse_" + to_string(i)));
+        }
+        else if (ri_queue == "calendar") {
+            checkpointed.push_back(checkpointedModel<CalendarRandomImpulse>(random_impulses[i], "random_impulse_" + to_string(i)));
+        }
+        else {
+            checkpointed.push_back(checkpointedModel<RandomImpulse>(random_impulses[i], "random_impulse_" + to_string(i)));
+        }
+    }
+    checkpointed.push_back(checkpointedModel<Responder>(responder, "responder"));
+    checkpointed.push_back(checkpointedModel<Tracker>(tracker, "tracker"));
+    checkpointed.push_back(checkpointedModel<SubV>(subV, "subV"));
+    if (frame_recorder) checkpointed.push_back(checkpointedModel<FrameRecorder>(frame_recorder, "frame_recorder"));
+    if (event_logger) checkpointed.push_back(checkpointedModel<EventLogger>(event_logger, "event_logger"));
+    if (trajectory_logger) checkpointed.push_back(checkpointedModel<TrajectoryLogger>(trajectory_logger, "trajectory_logger"));
+
+    TIME start = 0;
+    if (restart.size() > 0) {
+        try {
+            CheckpointReader saved(restart);
+            start = saved.start_time();
+            saved.section("particles");
+            particles->restore_checkpoint(saved);
+            for (const checkpointed_model_t& model : checkpointed) model.restore(saved, start);
+            saved.finish();
+        } catch (const exception& e) {
+            cerr << "restart: " << e.what() << endl;
+            return 1;
+        }
+    }
+    if (checkpoint.size() > 0) signal(SIGTERM, requestCheckpoint);
 
     /*** LATTICE COUPLED MODEL ***/
     // TODO: (2nd iteration) add several subV into a lattice
@@ -94,6 +225,14 @@ int main (int argc, char** argv) {
     };
     dynamic::modeling::ICs ics_lattice;
     ics_lattice = {};  // (2nd iteration) will have several subV connections
+    if (event_logger) {
+        submodels_lattice.push_back(event_logger);
+        ics_lattice.push_back(dynamic::translate::make_IC<SubV_defs::logging_out, EventLogger_defs::logging_in>("subV", "event_logger"));
+    }
+    if (trajectory_logger) {
+        submodels_lattice.push_back(trajectory_logger);
+        ics_lattice.push_back(dynamic::translate::make_IC<SubV_defs::logging_out, TrajectoryLogger_defs::logging_in>("subV", "trajectory_logger"));
+    }
     shared_ptr<dynamic::modeling::coupled<TIME>> lattice;
     lattice = make_shared<dynamic::modeling::coupled<TIME>>(
         "lattice", submodels_lattice, iports_lattice, oports_lattice, eics_lattice, eocs_lattice, ics_lattice
@@ -129,7 +268,9 @@ int main (int argc, char** argv) {
     dynamic::modeling::Ports oports_TOP;
     oports_TOP = {typeid(top_out)};
     dynamic::modeling::Models submodels_TOP;
-    submodels_TOP = {random_impulse, responder, detector};
+    submodels_TOP = {responder, detector};
+    submodels_TOP.insert(submodels_TOP.begin(), random_impulses.begin(), random_impulses.end());
+    if (frame_recorder) submodels_TOP.push_back(frame_recorder);
     dynamic::modeling::EICs eics_TOP;  // external input couplings
     eics_TOP = {};
     dynamic::modeling::EOCs eocs_TOP;
@@ -138,23 +279,25 @@ int main (int argc, char** argv) {
     };
     dynamic::modeling::ICs ics_TOP;
     ics_TOP = {
-        dynamic::translate::make_IC<RandomImpulse_defs::impulse_out, Responder_defs::impulse_in>("random_impulse", "responder"),
         dynamic::translate::make_IC<Responder_defs::response_out, detector_response_in>("responder", "detector"),
         dynamic::translate::make_IC<detector_collision_out, Responder_defs::collision_in>("detector", "responder"),
     };
+    for (int i = 0; i < ri_shards; ++i) {
+        ics_TOP.push_back(dynamic::translate::make_IC<RandomImpulse_defs::impulse_out, Responder_defs::impulse_in>("random_impulse_" + to_string(i), "responder"));
+    }
     shared_ptr<dynamic::modeling::coupled<TIME>> TOP;
     TOP = make_shared<dynamic::modeling::coupled<TIME>>(
         "TOP", submodels_TOP, iports_TOP, oports_TOP, eics_TOP, eocs_TOP, ics_TOP
     );
 
-    /*** Loggers ***/
-    static ofstream out_messages("../simulation_results/iter_1_test_output_messages.txt");
+    /*** Loggers (written by a background thread) ***/
+    static AsyncLogStream out_messages;
     struct oss_sink_messages{
         static ostream& sink(){
             return out_messages;
         }
     };
-    static ofstream out_state("../simulation_results/iter_1_test_output_state.txt");
+    static AsyncLogStream out_state;
     struct oss_sink_state{
         static ostream& sink(){
             return out_state;
@@ -167,29 +310,160 @@ int main (int argc, char** argv) {
     using global_time_sta=logger::logger<logger::logger_global_time, dynamic::logger::formatter<TIME>, oss_sink_state>;
 
     using logger_top=logger::multilogger<state, log_messages, global_time_mes, global_time_sta>;
+    using logger_top_checkpointed=logger::multilogger<state, log_messages, global_time_mes, global_time_sta, CheckpointClock<TIME>>;
 
     /*** Runner call ***/
-    dynamic::engine::runner<TIME, logger_top> r(TOP, {0});
-    //r.run_until(NDTime("00:05:00:000"));
-    r.run_until(TIME(runtime));
-    return 0;
+    // checkpointed runs go one step at a time (CheckpointClock tells when each model last changed)
+    bool finished = true;
+    try {
+        if (cadmium_logs) {
+            out_messages.open("../simulation_results/iter_1_test_output_messages.txt", log_buffer, log_overflow, log_index_interval);
+            out_state.open("../simulation_results/iter_1_test_output_state.txt", log_buffer, log_overflow, log_index_interval);
+            if (checkpoint.size() > 0 || restart.size() > 0) {
+                finished = runCheckpointed<logger_top_checkpointed>(TOP, start, TIME(runtime), checkpoint_interval, checkpoint, checkpointed, *particles);
+            } else {
+                dynamic::engine::runner<TIME, logger_top> r(TOP, {0});
+                //r.run_until(NDTime("00:05:00:000"));
+                r.run_until(TIME(runtime));
+            }
+        } else {
+            if (checkpoint.size() > 0 || restart.size() > 0) {
+                finished = runCheckpointed<CheckpointClock<TIME>>(TOP, start, TIME(runtime), checkpoint_interval, checkpoint, checkpointed, *particles);
+            } else {
+                dynamic::engine::runner<TIME, logger::not_logger> r(TOP, {0});
+                r.run_until(TIME(runtime));
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "checkpoint: " << e.what() << endl;
+        finished = false;
+    }
+    try {
+        if (event_logger) dynamic_pointer_cast<EventLogger<TIME>>(event_logger)->close();
+    } catch (const exception& e) {
+        cerr << "event log: " << e.what() << endl;
+        finished = false;
+    }
+    out_messages.drain();
+    out_state.drain();
+    if (out_messages.dropped() + out_state.dropped() > 0) {
+        cerr << "log queue full, dropped " << out_messages.dropped() << " message log line(s) and " << out_state.dropped() << " state log line(s)" << endl;
+    }
+    return finished ? 0 : 1;
 }
 
-// args: config JSON, necessary particle element names, necessary species element names
-// return: JSON of format {id : {elements}, id : {elements}, ...}
-json prepParticlesJSON (json& j, vector<string> particle_elements, vector<string> species_elements) {
-    json result;
-    string currSpecies;
-    for (auto it = j["particles"].begin(); it != j["particles"].end(); ++it) {
-        // prune particle information
-        for (auto element : particle_elements) {
-            result[it.key()][element] = j["particles"][it.key()][element];
+// split the particles between RI shards
+// regions are cut from the initial positions only: particles keep their shard as they move and shards are never
+// rebalanced (this only decides which model schedules the impulses of a particle, the impulses themselves are the same)
+// args: particle store, number of shards, "id" or "region"
+// return: the particle IDs of every shard (in store order)
+vector<vector<int>> shardParticles (ParticleStore& particles, int num_shards, string shard_by) {
+    if (num_shards <= 0) throw invalid_argument("ri_shards must be positive");
+    if (shard_by != "id" && shard_by != "region") throw invalid_argument("unknown RI sharding: " + shard_by + " (expected \"id\" or \"region\")");
+
+    // order the particles along the sharding key, then cut the order into contiguous ranges
+    vector<pair<float, int>> order;
+    for (int p_id : particles.ids()) {
+        if (shard_by == "region") {
+            order.push_back({particles.position(p_id)[0], p_id});
         }
-        // add necessary species information
-        for (auto element : species_elements) {
-            currSpecies = j["particles"][it.key()]["species"];
-            result[it.key()][element] = j["species"][currSpecies][element];
+        else {
+            order.push_back({p_id, p_id});
         }
     }
+    sort(order.begin(), order.end());
+
+    vector<int> shard_of(particles.size());  // formatted: {store index, shard}
+    for (unsigned int i = 0; i < order.size(); ++i) {
+        shard_of[particles.index_of(order[i].second)] = i * num_shards / order.size();
+    }
+    vector<vector<int>> result(num_shards);
+    for (int p_id : particles.ids()) {
+        result[shard_of[particles.index_of(p_id)]].push_back(p_id);
+    }
+    return result;
+}
+
+// tape of one RI shard (the path itself when there is only one shard)
+string shardTapePath (string path, int shard, int num_shards) {
+    if (num_shards == 1) return path;
+    return path + "." + to_string(shard);
+}
+
+// save and restore the state of a model, and the times of its last and next transitions
+// args: the model (made with make_dynamic_atomic_model<MODEL, TIME, ...>), its ID
+template <template<typename> class MODEL>
+checkpointed_model_t checkpointedModel (shared_ptr<dynamic::modeling::model> model, string id) {
+    shared_ptr<MODEL<TIME>> atomic = dynamic_pointer_cast<MODEL<TIME>>(model);
+    assert(atomic != nullptr && "checkpointed model of another type");
+    checkpointed_model_t result;
+    result.next = [atomic]() {
+        return atomic->state.resume.next_time(atomic->time_advance());
+    };
+    result.save = [atomic, id, next = result.next](CheckpointWriter& out) {
+        // a model still waiting for its first transition since a restart keeps the times it was restored with
+        out.section(id);
+        out.put(atomic->state.resume.last);
+        out.put(next());
+        atomic->save_checkpoint(out);
+    };
+    result.restore = [atomic, id](CheckpointReader& in, TIME start) {
+        TIME last;
+        TIME next;
+        in.section(id);
+        in.get(last);
+        in.get(next);
+        atomic->restore_checkpoint(in);
+        atomic->state.resume.set(start, last, next);
+    };
     return result;
-}
\ No newline at end of file
+}
+
+// run from start to runtime one step at a time, saving a checkpoint every interval, on SIGTERM and at the end
+// (no checkpoints without a path)
+// throws runtime_error if the runner does not schedule the models as the checkpoints expect (see resume_t)
+// return: false if the run was stopped by SIGTERM
+template <typename LOGGER>
+bool runCheckpointed (shared_ptr<dynamic::modeling::coupled<TIME>> TOP, TIME start, TIME runtime, float interval, string path,
+                      const vector<checkpointed_model_t>& models, const ParticleStore& particles) {
+    dynamic::engine::runner<TIME, LOGGER> r(TOP, {start});
+    TIME next = r.run_until(start);  // time of the next step
+    TIME first = numeric_limits<TIME>::infinity();  // earliest next internal transition (the loggers are passive)
+    for (const checkpointed_model_t& model : models) first = min(first, model.next());
+    if (next != first) {
+        throw runtime_error("the runner starts at " + to_string(next) + " but the models are next at " + to_string(first));
+    }
+    double next_checkpoint = (interval > 0) ? (floor(start / interval) + 1) * interval : numeric_limits<double>::infinity();
+    while (next < runtime) {
+        if (path.size() > 0 && checkpoint_requested) {
+            saveCheckpoint(path, next, models, particles);
+            cerr << "checkpoint: stopped at " << next << ", saved to " << path << endl;
+            return false;
+        }
+        if (path.size() > 0 && next >= next_checkpoint) {
+            saveCheckpoint(path, next, models, particles);
+            next_checkpoint = (floor(next / interval) + 1) * interval;
+        }
+        TIME step = next;
+        next = r.run_until(min(nextafter(next, numeric_limits<TIME>::infinity()), runtime));
+        if (CheckpointClock<TIME>::now != step) {
+            throw runtime_error("the step at " + to_string(step) + " was not reported to CheckpointClock (logger_global_time)");
+        }
+    }
+    if (path.size() > 0) saveCheckpoint(path, min(next, runtime), models, particles);  // the run can be extended from here
+    return true;
+}
+
+// save the state of the simulation between two steps
+// args: checkpoint path, time of the next step, checkpointed models, particle store
+void saveCheckpoint (string path, TIME time, const vector<checkpointed_model_t>& models, const ParticleStore& particles) {
+    CheckpointWriter out(path, time);
+    out.section("particles");
+    particles.save_checkpoint(out);
+    for (const checkpointed_model_t& model : models) model.save(out);
+    out.commit();
+}
+
+void requestCheckpoint (int) {
+    checkpoint_requested = 1;
+}
@@ -0,0 +1,41 @@
+/*
+Converts a JSON config into a binary particle file (utilities/particle_file.hpp), which ITER_1_TEST accepts
+in place of the config. The file is mapped into memory when loaded, so runs with millions of particles
+start without parsing them.
+
+The particles keep the order they have in the store, and the rest of the config (its "config" block and any
+other keys) is stored with them, so a run from the particle file is the same as a run from the config.
+
+Usage: PARTICLE_CONVERT <config.json> <particles.bin>
+*/
+
+// C++ libraries
+#include <iostream>
+#include <string>
+#include <memory>
+#include <stdexcept>
+
+#include "../data_structures/particle_store.hpp"
+#include "../utilities/particle_file.hpp"
+
+using namespace std;
+
+int main (int argc, char** argv) {
+    if (argc != 3) {
+        cerr << "Usage: " << argv[0] << " <config.json> <particles.bin>" << endl;
+        return 1;
+    }
+
+    try {
+        json config;
+        shared_ptr<ParticleStore> particles = ParticleStore::load(argv[1], config);
+        config.erase("species");  // stored as the species table
+        write_particle_file(argv[2], *particles, config.dump());
+        cout << "particle convert: " << particles->size() << " particles in " << particles->dimensions() << "D, "
+             << particles->species_table().size() << " species written to " << argv[2] << endl;
+    } catch (const exception& e) {
+        cerr << "particle convert: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
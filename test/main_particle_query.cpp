@@ -0,0 +1,47 @@
+/*
+Prints the history of some particles from an event log written with a particle index
+(config keys event_log and event_log_particle_index).
+
+Only the records of the requested particles are read, so the time taken is proportional to the number
+of records of those particles rather than to the size of the log. Every record is printed as
+<time> [subV_id: ..., p_id: ..., vel: <...>, pos: <...>, type: ...], in the order it was logged.
+
+Usage: PARTICLE_QUERY <event log> <p_id> [p_id ...]
+*/
+
+// C++ libraries
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "../data_structures/message.hpp"
+#include "../utilities/event_log.hpp"
+
+using namespace std;
+
+int main (int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <event log> <p_id> [p_id ...]" << endl;
+        return 1;
+    }
+
+    try {
+        EventLogReader log(argv[1]);
+        ParticleIndex index(argv[1]);
+        event_record_t record;
+        for (int i = 2; i < argc; ++i) {
+            int p_id = stoi(argv[i]);
+            vector<pair<uint64_t, uint32_t>> records = index.records(p_id);
+            if (records.empty()) cerr << "particle query: no records for p_id " << p_id << endl;
+            for (const pair<uint64_t, uint32_t>& location : records) {
+                log.read(location.first, location.second, record);
+                cout << record.time << " " << logging_message_t(record.subV_id, record.p_id, record.velocity, record.position, (purpose_t)record.purpose) << "\n";
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "particle query: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -9,6 +9,9 @@ Define control tags in a central location
 #define DEBUG_RE false  // responder
 #define DEBUG_TR false  // tracker
 #define DEBUG_SV false  // subV
+#define DEBUG_EL false  // event logger
+#define DEBUG_FR false  // frame recorder
+#define DEBUG_TL false  // trajectory logger
 
 #define CACHE_LOGGING false  // whether or now to send the cache size to the terminal
 
@@ -0,0 +1,111 @@
+#!/bin/python3
+
+'''
+Decoder for the compact trajectory logs written by the trajectory logger (utilities/trajectory.hpp, config key
+trajectory_log). The file holds the velocity changes of every particle; positions that were not stored are
+reconstructed as position + velocity * (time - previous time) in float32, like subV does.
+
+iter_trajectory(filename) yields one event per logged message: [time, p_id, subV_id, purpose, [pos], [vel]]
+iter_events(filename) yields them in the format of output_tools.parse_msg_file: [time, p_id, [pos], [vel]]
+'''
+
+import sys
+import struct
+import numpy as np
+
+MAGIC = b"TPSTRJ01"
+HEADER = struct.Struct("<8sIIff")
+PURPOSES = ["n/a", "init", "load", "rest", "ri"]  # same order as purpose_t
+PURPOSE_MASK = 0x07
+HAS_POSITION = 0x08
+HAS_SUBV = 0x10
+
+def is_trajectory(filename):
+    try:
+        with open(filename, "rb") as f:
+            return f.read(len(MAGIC)) == MAGIC
+    except OSError:
+        return False
+
+def _varint(data, offset):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7f) << shift
+        if byte < 0x80:
+            return value, offset
+        shift += 7
+
+# llround of the C++ writer (halves away from zero)
+def _round(x):
+    x = float(x)
+    return int(np.floor(abs(x) + 0.5)) * (1 if x >= 0 else -1)
+
+def _zigzag(data, offset):
+    value, offset = _varint(data, offset)
+    return (value >> 1) ^ -(value & 1), offset
+
+def iter_trajectory(filename):
+    with open(filename, "rb") as f:
+        data = f.read()
+    magic, dim, _, velocity_quantum, position_quantum = HEADER.unpack_from(data, 0)
+    if magic != MAGIC:
+        raise ValueError(f"{filename} is not a trajectory log")
+    velocity_quantum = np.float32(velocity_quantum)
+    position_quantum = np.float32(position_quantum)
+    floats = struct.Struct(f"<{dim}f")
+
+    particles = {}  # p_id: [time, position, velocity, velocity quanta] after the particle's last event
+    time_bits, p_id, subV_id = 0, 0, 0
+    offset = HEADER.size
+    while offset < len(data):
+        flags = data[offset]
+        delta, offset = _varint(data, offset + 1)
+        time_bits = (time_bits + delta) & 0xffffffff
+        time = np.uint32(time_bits).view(np.float32)
+        delta, offset = _zigzag(data, offset)
+        p_id += delta
+        if flags & HAS_SUBV:
+            delta, offset = _zigzag(data, offset)
+            subV_id += delta
+
+        known = p_id in particles
+        if not known:
+            particles[p_id] = [np.float32(0), np.zeros(dim, np.float32), np.zeros(dim, np.float32), [0] * dim]
+        particle = particles[p_id]
+        position = particle[1] + particle[2] * np.float32(time - particle[0]) if known else np.zeros(dim, np.float32)
+
+        if velocity_quantum > 0:
+            for i in range(dim):
+                delta, offset = _zigzag(data, offset)
+                particle[3][i] += delta
+            velocity = np.array([np.float32(q) * velocity_quantum for q in particle[3]], np.float32)
+        else:
+            velocity = np.array(floats.unpack_from(data, offset), np.float32)
+            offset += floats.size
+        if flags & HAS_POSITION:
+            if position_quantum > 0:
+                quanta = []
+                for i in range(dim):
+                    delta, offset = _zigzag(data, offset)
+                    quanta.append((_round(position[i] / position_quantum) if known else 0) + delta)
+                position = np.array([np.float32(q) * position_quantum for q in quanta], np.float32)
+            else:
+                position = np.array(floats.unpack_from(data, offset), np.float32)
+                offset += floats.size
+
+        particle[0], particle[1], particle[2] = time, position, velocity
+        yield([float(time), p_id, subV_id, PURPOSES[flags & PURPOSE_MASK], position.tolist(), velocity.tolist()])
+
+def iter_events(filename):
+    for time, p_id, _, _, pos, vel in iter_trajectory(filename):
+        yield([time, p_id, pos, vel])
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2 or '-h' in sys.argv[1]:
+        print('Usage: \n\tpython3 trajectory.py trajectory.bin    #prints every event, of the form [time, p_id, subV_id, type, [pos], [vel]]')
+        exit()
+    for event in iter_trajectory(sys.argv[1]):
+        print(event)
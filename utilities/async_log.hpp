@@ -0,0 +1,263 @@
+#ifndef ASYNC_LOG_HPP
+#define ASYNC_LOG_HPP
+
+/*
+Output stream that hands what is written to it to a background thread which writes it to a file, so that
+the simulation thread never waits on the disk (used as the sink of the Cadmium loggers).
+
+Text is staged on the simulation side and published at every flush of the stream (Cadmium's loggers end
+each line with endl) into a single-producer/single-consumer byte ring. The producer only writes head, the
+writer thread only writes tail, so no locks are required. When the ring is full the line is either
+dropped (and counted) or the simulation thread waits for space, depending on the overflow policy. Lines
+are never split by a drop.
+
+drain() waits until everything published so far is on disk, it is meant to be called at the end of
+run_until. Only one thread may write to a stream.
+
+With an index interval, the offsets of the time lines of Cadmium's global time loggers (lines holding
+only a number) are written to a sidecar index (see utilities/time_index.hpp), one per block of
+simulation time.
+*/
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <streambuf>
+#include <memory>
+#include <stdexcept>
+#include <algorithm>  // min
+#include <cstdio>
+#include <cstdint>
+#include <cstring>  // memcpy, strerror
+#include <cerrno>
+#include <cstdlib>  // strtod
+#include <cctype>  // isdigit
+
+#include "time_index.hpp"
+
+using namespace std;
+
+enum class log_overflow_t {block, drop};
+
+// "block" or "drop"
+inline log_overflow_t parse_log_overflow (const string& policy) {
+    if (policy == "block") return log_overflow_t::block;
+    if (policy == "drop") return log_overflow_t::drop;
+    throw invalid_argument("unknown log overflow policy: " + policy + " (expected \"block\" or \"drop\")");
+}
+
+class AsyncLogBuf : public streambuf {
+    public:
+        static constexpr size_t default_capacity = 1 << 22;  // bytes
+
+        AsyncLogBuf () : file(NULL), capacity(0), policy(log_overflow_t::block), dropped_lines(0) {}
+
+        AsyncLogBuf (const AsyncLogBuf&) = delete;
+        AsyncLogBuf& operator= (const AsyncLogBuf&) = delete;
+
+        ~AsyncLogBuf () {
+            close();
+        }
+
+        // capacity is rounded up to a power of two, an index interval of 0 writes no index
+        void open (const string& path, size_t capacity = default_capacity, log_overflow_t overflow = log_overflow_t::block, double index_interval = 0) {
+            if (is_open()) close();
+            file = fopen(path.c_str(), "w");
+            if (file == NULL) throw runtime_error("AsyncLogBuf: cannot open " + path + ": " + strerror(errno));
+            this->capacity = 1;
+            while (this->capacity < max<size_t>(capacity, 2)) this->capacity <<= 1;
+            policy = overflow;
+            ring.assign(this->capacity, 0);
+            staging.assign(256, 0);
+            setp(staging.data(), staging.data() + staging.size());
+            head.store(0);
+            tail.store(0);
+            flush_requested.store(0);
+            flush_done.store(0);
+            stop.store(false);
+            dropped_lines = 0;
+            if (index_interval > 0) time_index.reset(new TimeIndexWriter(path + ".idx", index_interval));
+            writer = thread(&AsyncLogBuf::write_loop, this);
+        }
+
+        bool is_open () const {
+            return file != NULL;
+        }
+
+        // wait until everything written so far is on disk
+        void drain () {
+            if (!is_open()) return;
+            sync();
+            if (time_index) time_index->flush();
+            uint64_t request = flush_requested.fetch_add(1) + 1;
+            while (flush_done.load(memory_order_acquire) < request) wait();
+        }
+
+        void close () {
+            if (!is_open()) return;
+            sync();
+            stop.store(true, memory_order_release);
+            writer.join();
+            fclose(file);
+            file = NULL;
+            time_index.reset();
+        }
+
+        // lines lost to a full ring with log_overflow_t::drop
+        uint64_t dropped () const {
+            return dropped_lines;
+        }
+
+    protected:
+        // the staging area is full, grow it so that a line is always published whole
+        int_type overflow (int_type c) override {
+            if (!is_open()) return traits_type::eof();
+            size_t used = pptr() - pbase();
+            staging.resize(staging.size() * 2);
+            setp(staging.data(), staging.data() + staging.size());
+            pbump(used);
+            if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                *pptr() = traits_type::to_char_type(c);
+                pbump(1);
+            }
+            return traits_type::not_eof(c);
+        }
+
+        // publish the staged text to the writer thread
+        int sync () override {
+            if (!is_open()) return -1;
+            uint64_t offset = head.load(memory_order_relaxed);
+            double time;
+            bool index = time_index && time_line(pbase(), pptr() - pbase(), time) && time_index->due(time);
+            if (publish(pbase(), pptr() - pbase()) && index) time_index->add(time, offset);
+            setp(staging.data(), staging.data() + staging.size());
+            return 0;
+        }
+
+    private:
+        FILE* file;
+        size_t capacity;
+        log_overflow_t policy;
+        uint64_t dropped_lines;
+        vector<char> ring;
+        vector<char> staging;  // text written since the last flush of the stream
+        alignas(64) atomic<uint64_t> head;  // bytes published, written by the producer only
+        alignas(64) atomic<uint64_t> tail;  // bytes written to the file, written by the writer thread only
+        atomic<uint64_t> flush_requested;
+        atomic<uint64_t> flush_done;
+        atomic<bool> stop;
+        thread writer;
+        unique_ptr<TimeIndexWriter> time_index;
+
+        // returns false if the text was dropped
+        bool publish (const char* data, size_t size) {
+            uint64_t h = head.load(memory_order_relaxed);
+            if (policy == log_overflow_t::drop && size > capacity - (h - tail.load(memory_order_acquire))) {
+                ++dropped_lines;
+                return false;
+            }
+            // with log_overflow_t::block, lines longer than the ring go through in pieces
+            while (size > 0) {
+                size_t space = capacity - (h - tail.load(memory_order_acquire));
+                if (space == 0) {
+                    wait();
+                    continue;
+                }
+                size_t n = min(size, space);
+                copy_in(h, data, n);
+                h += n;
+                head.store(h, memory_order_release);
+                data += n;
+                size -= n;
+            }
+            return true;
+        }
+
+        // whether the text is a single line holding only a number (a time line of the global time loggers)
+        static bool time_line (const char* data, size_t size, double& time) {
+            char line[64];
+            if (size < 2 || size >= sizeof(line) || !isdigit((unsigned char)data[0]) || data[size - 1] != '\n') return false;
+            memcpy(line, data, size - 1);
+            line[size - 1] = '\0';
+            char* end;
+            time = strtod(line, &end);
+            return *end == '\0';
+        }
+
+        void copy_in (uint64_t at, const char* data, size_t size) {
+            size_t offset = at & (capacity - 1);
+            size_t first = min(size, capacity - offset);
+            memcpy(&ring[offset], data, first);
+            memcpy(&ring[0], data + first, size - first);
+        }
+
+        void write_loop () {
+            while (true) {
+                uint64_t t = tail.load(memory_order_relaxed);
+                uint64_t h = head.load(memory_order_acquire);
+                if (h != t) {
+                    size_t offset = t & (capacity - 1);
+                    size_t n = min<uint64_t>(h - t, capacity - offset);  // up to the end of the ring
+                    fwrite(&ring[offset], 1, n, file);
+                    tail.store(t + n, memory_order_release);
+                    continue;
+                }
+                uint64_t request = flush_requested.load(memory_order_acquire);
+                if (request != flush_done.load(memory_order_relaxed)) {
+                    // a drain is requested after publishing, so this sees everything it waits for
+                    if (head.load(memory_order_acquire) != t) continue;
+                    fflush(file);
+                    flush_done.store(request, memory_order_release);
+                    continue;
+                }
+                if (stop.load(memory_order_acquire)) {
+                    if (head.load(memory_order_acquire) != t) continue;
+                    fflush(file);
+                    return;
+                }
+                wait();
+            }
+        }
+
+        static void wait () {
+            this_thread::sleep_for(chrono::microseconds(50));
+        }
+};
+
+class AsyncLogStream : public ostream {
+    public:
+        AsyncLogStream () : ostream(&buffer) {}
+
+        AsyncLogStream (const string& path, size_t capacity = AsyncLogBuf::default_capacity, log_overflow_t overflow = log_overflow_t::block, double index_interval = 0) : ostream(&buffer) {
+            open(path, capacity, overflow, index_interval);
+        }
+
+        void open (const string& path, size_t capacity = AsyncLogBuf::default_capacity, log_overflow_t overflow = log_overflow_t::block, double index_interval = 0) {
+            buffer.open(path, capacity, overflow, index_interval);
+            clear();
+        }
+
+        bool is_open () const {
+            return buffer.is_open();
+        }
+
+        void drain () {
+            buffer.drain();
+        }
+
+        void close () {
+            buffer.close();
+        }
+
+        uint64_t dropped () const {
+            return buffer.dropped();
+        }
+
+    private:
+        AsyncLogBuf buffer;
+};
+
+#endif
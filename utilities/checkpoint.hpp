@@ -0,0 +1,215 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+/*
+Binary checkpoints of a simulation: the state of the particle store and of every model between two steps,
+from which a run is restarted (config key restart) and continues exactly like the uninterrupted run.
+
+Layout (native byte order): magic "TPSCKP01", the time the restored simulation starts at (float64), then
+one section per model (and one for the particle store): its name (string) followed by the values it saved,
+read back in the same order. Values of trivially copyable types are stored as their bytes, vectors and
+strings as a uint64 count followed by their elements.
+
+Restored models also need the times of their last and next transitions, see utilities/checkpoint_clock.hpp.
+*/
+
+#include <string>
+#include <vector>
+#include <utility>  // pair
+#include <stdexcept>
+#include <type_traits>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>  // memcmp, strerror
+#include <cerrno>
+
+#include "../data_structures/message.hpp"
+
+using namespace std;
+
+static const char CHECKPOINT_MAGIC[8] = {'T', 'P', 'S', 'C', 'K', 'P', '0', '1'};
+
+class CheckpointWriter {
+    public:
+        // the checkpoint is written next to path and only replaces it on commit, so a crash while writing keeps the previous one
+        CheckpointWriter (const string& path, double start_time) : path(path), temp_path(path + ".tmp") {
+            file = fopen(temp_path.c_str(), "wb");
+            if (file == NULL) throw runtime_error("CheckpointWriter: cannot open " + temp_path + ": " + strerror(errno));
+            write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+            put(start_time);
+        }
+
+        CheckpointWriter (const CheckpointWriter&) = delete;
+        CheckpointWriter& operator= (const CheckpointWriter&) = delete;
+
+        ~CheckpointWriter () {
+            if (file != NULL) {
+                fclose(file);
+                remove(temp_path.c_str());
+            }
+        }
+
+        void section (const string& name) {
+            put(name);
+        }
+
+        template <typename T>
+        void put (const T& value) {
+            static_assert(is_trivially_copyable<T>::value, "CheckpointWriter: type needs its own put");
+            write(&value, sizeof(T));
+        }
+
+        template <typename T>
+        void put (const vector<T>& values) {
+            put(uint64_t(values.size()));
+            if constexpr (is_trivially_copyable<T>::value) {
+                write(values.data(), values.size() * sizeof(T));
+            }
+            else {
+                for (const T& value : values) put(value);
+            }
+        }
+
+        template <typename A, typename B>
+        void put (const pair<A, B>& value) {
+            put(value.first);
+            put(value.second);
+        }
+
+        void put (const string& value) {
+            put(uint64_t(value.size()));
+            write(value.data(), value.size());
+        }
+
+        void put (const id_list_t& ids) {
+            put(vector<int>(ids.begin(), ids.end()));
+        }
+
+        void put (const message_t& msg) {
+            put(msg.data);
+            put(msg.particle_ids);
+            put(msg.purpose);
+        }
+
+        void put (const tracker_message_t& msg) {
+            put(static_cast<const message_t&>(msg));
+            put(msg.subV_ids);
+        }
+
+        // replace the previous checkpoint
+        void commit () {
+            bool failed = fflush(file) != 0 || ferror(file);
+            fclose(file);
+            file = NULL;
+            if (failed || rename(temp_path.c_str(), path.c_str()) != 0) {
+                remove(temp_path.c_str());
+                throw runtime_error("CheckpointWriter: cannot write " + path);
+            }
+        }
+
+    private:
+        FILE* file;
+        string path;
+        string temp_path;
+
+        void write (const void* data, size_t size) {
+            if (size > 0 && fwrite(data, 1, size, file) != size) throw runtime_error("CheckpointWriter: cannot write " + temp_path);
+        }
+};
+
+class CheckpointReader {
+    public:
+        CheckpointReader (const string& path) : path(path) {
+            file = fopen(path.c_str(), "rb");
+            if (file == NULL) throw runtime_error("CheckpointReader: cannot open " + path + ": " + strerror(errno));
+            char magic[sizeof(CHECKPOINT_MAGIC)];
+            read(magic, sizeof(magic));
+            if (memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0) throw runtime_error("CheckpointReader: " + path + " is not a checkpoint");
+            get(start);
+        }
+
+        CheckpointReader (const CheckpointReader&) = delete;
+        CheckpointReader& operator= (const CheckpointReader&) = delete;
+
+        ~CheckpointReader () {
+            fclose(file);
+        }
+
+        double start_time () const {
+            return start;
+        }
+
+        // the next section must be the one called name
+        void section (const string& name) {
+            string saved;
+            get(saved);
+            if (saved != name) throw runtime_error("CheckpointReader: expected the state of " + name + " in " + path + ", found " + saved);
+        }
+
+        template <typename T>
+        void get (T& value) {
+            static_assert(is_trivially_copyable<T>::value, "CheckpointReader: type needs its own get");
+            read(&value, sizeof(T));
+        }
+
+        template <typename T>
+        void get (vector<T>& values) {
+            values.resize(get_count());
+            if constexpr (is_trivially_copyable<T>::value) {
+                read(values.data(), values.size() * sizeof(T));
+            }
+            else {
+                for (T& value : values) get(value);
+            }
+        }
+
+        template <typename A, typename B>
+        void get (pair<A, B>& value) {
+            get(value.first);
+            get(value.second);
+        }
+
+        void get (string& value) {
+            value.resize(get_count());
+            read(&value[0], value.size());
+        }
+
+        void get (id_list_t& ids) {
+            vector<int> values;
+            get(values);
+            ids = id_list_t(values);
+        }
+
+        void get (message_t& msg) {
+            get(msg.data);
+            get(msg.particle_ids);
+            get(msg.purpose);
+        }
+
+        void get (tracker_message_t& msg) {
+            get(static_cast<message_t&>(msg));
+            get(msg.subV_ids);
+        }
+
+        // every section has been read
+        void finish () {
+            if (fgetc(file) != EOF) throw runtime_error("CheckpointReader: " + path + " holds more state than this simulation has");
+        }
+
+    private:
+        FILE* file;
+        string path;
+        double start;
+
+        uint64_t get_count () {
+            uint64_t count;
+            get(count);
+            return count;
+        }
+
+        void read (void* data, size_t size) {
+            if (size > 0 && fread(data, 1, size, file) != size) throw runtime_error("CheckpointReader: " + path + " is truncated");
+        }
+};
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef CHECKPOINT_CLOCK_HPP
+#define CHECKPOINT_CLOCK_HPP
+
+/*
+Times needed to restart models from a checkpoint (see utilities/checkpoint.hpp).
+*/
+
+#include <cadmium/logger/common_loggers.hpp>
+
+#include <type_traits>
+#include <limits>
+#include <cmath>  // nextafter, isinf
+
+using namespace std;
+
+/*
+Cadmium logger recording the time of every step, which the models cannot see but a checkpoint needs (every
+transition of a model reads it, see resume_t). Add it to the loggers of the runner when checkpointing or restarting.
+Only the logger_global_time source is used, which the runner logs once per step before the step, and the log call
+may give the types of its parameters or let them be deduced. runCheckpointed checks that every step was reported.
+*/
+template <typename TIME>
+struct CheckpointClock {
+    static inline TIME now = TIME();  // time of the step being simulated
+
+    template <typename DECLARED_SOURCE, typename FORMATTER_PARAMETER, typename... PARAMs>
+    static void log (const PARAMs&... ps) {
+        if constexpr (is_same<DECLARED_SOURCE, cadmium::logger::logger_global_time>::value) step(ps...);
+    }
+
+    private:
+        static void step (const TIME& time) {
+            now = time;
+        }
+
+        template <typename... PARAMs>
+        static void step (const PARAMs&... ps) {}
+};
+
+/*
+Times of the last and next transitions of a model, as saved in a checkpoint. Every transition of the model calls
+transition(), which keeps the time of the step (from CheckpointClock) as the time of its last transition.
+It also bridges the first transition of a model restored from a checkpoint. Cadmium starts the restored simulation
+with every model at start, so until the model's first transition:
+- its time advance is measured from start (advance() lands exactly on the next internal time it had)
+- the elapsed time Cadmium gives an external transition is measured from start (elapsed() gives the time
+  since the model's last transition instead)
+runCheckpointed checks that the first step of the restored simulation is the earliest restored next time.
+*/
+template <typename TIME>
+struct resume_t {
+    bool active = false;
+    TIME start = TIME();  // time the restored simulation starts at
+    TIME last = TIME();  // time of the last transition (before the checkpoint until the first transition after a restart)
+    TIME next = TIME();  // time of the next internal transition
+
+    void set (TIME start, TIME last, TIME next) {
+        active = true;
+        this->start = start;
+        this->last = last;
+        this->next = next;
+    }
+
+    // time advance that Cadmium adds to start to get next (it adds in TIME, so the difference may need adjusting)
+    TIME advance () const {
+        if (isinf(next)) return next;
+        TIME advance = next - start;
+        while (TIME(start + advance) < next) advance = nextafter(advance, numeric_limits<TIME>::infinity());
+        while (TIME(start + advance) > next) advance = nextafter(advance, -numeric_limits<TIME>::infinity());
+        return advance;
+    }
+
+    TIME elapsed () const {
+        return CheckpointClock<TIME>::now - last;
+    }
+
+    // called by every transition of the model (after elapsed() if the transition uses it)
+    void transition () {
+        active = false;
+        last = CheckpointClock<TIME>::now;
+    }
+
+    // called by a model whose next internal time changes between two steps without a transition (ex. when particles
+    // are handed between domains), its time advance is measured from last again
+    void reschedule () {
+        active = false;
+    }
+
+    // time of the next internal transition of a model with a time advance of advance
+    TIME next_time (TIME advance) const {
+        return active ? next : TIME(last + advance);
+    }
+};
+
+#endif
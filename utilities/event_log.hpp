@@ -0,0 +1,403 @@
+#ifndef EVENT_LOG_HPP
+#define EVENT_LOG_HPP
+
+/*
+Binary columnar log of particle events (the logging messages of subV), read by event_log.py.
+
+Layout (native byte order):
+- header: magic "TPSEVL01" (8 bytes), dim (uint32), reserved (uint32)
+- chunks of up to chunk_size events, each: count (uint32), reserved (uint32), then the columns
+    time      count float64
+    event     count uint32   (index of the bag of messages the record arrived in, records of one bag share a time)
+    p_id      count int32
+    subV_id   count int32
+    position  count * dim float32
+    velocity  count * dim float32
+    purpose   count uint8    (purpose_t)
+  followed by zero padding to a multiple of 8 bytes so that every chunk starts aligned
+Records are written in the order they are received, so their times never decrease.
+
+With an index interval, a chunk is started at every block of simulation time, indexed in "<log>.idx" (see
+utilities/time_index.hpp) along with a keyframe in "<log>.keys" holding the last record of every particle
+logged before the block:
+- header: magic "TPSKEY01" (8 bytes), dim (uint32), reserved (uint32)
+- keyframes, each: count (uint32), reserved (uint32), then the columns
+    time      count float64
+    p_id      count int32
+    position  count * dim float32
+    velocity  count * dim float32
+  followed by zero padding to a multiple of 8 bytes
+
+With a particle index, "<log>.pidx" lists where every record of every particle is, so that the history of
+one particle is read in time proportional to its number of records (see EventLogReader and ParticleIndex).
+It is written when the log is closed (EventLogWriter::close, or its destructor):
+- header: magic "TPSPID01" (8 bytes), number of particles (uint32), reserved (uint32),
+          number of chunks (uint64), number of records (uint64)
+- chunk offsets: uint64 per chunk, in file order
+- particles: {p_id (int32), number of records (uint32), first record location (uint64)}, sorted by p_id
+- record locations: {chunk (uint32), row in the chunk (uint32)}, grouped by particle in the order written
+*/
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>  // memcpy, strerror
+#include <cerrno>
+#include <memory>
+#include <algorithm>  // sort, lower_bound
+
+#include <fcntl.h>  // open
+#include <sys/mman.h>  // mmap
+#include <sys/stat.h>
+#include <unistd.h>  // close
+
+#include "time_index.hpp"
+
+using namespace std;
+
+struct event_log_header_t {
+    char magic[8];
+    uint32_t dim;
+    uint32_t reserved;
+};
+
+static const char EVENT_LOG_MAGIC[8] = {'T', 'P', 'S', 'E', 'V', 'L', '0', '1'};
+static const char KEYFRAME_MAGIC[8] = {'T', 'P', 'S', 'K', 'E', 'Y', '0', '1'};
+static const char PARTICLE_INDEX_MAGIC[8] = {'T', 'P', 'S', 'P', 'I', 'D', '0', '1'};
+
+struct particle_index_header_t {
+    char magic[8];
+    uint32_t particles;
+    uint32_t reserved;
+    uint64_t chunks;
+    uint64_t records;
+};
+
+struct particle_index_entry_t {
+    int32_t p_id;
+    uint32_t count;
+    uint64_t first;
+};
+
+struct record_location_t {
+    uint32_t chunk;
+    uint32_t row;
+};
+
+// one record of an event log
+struct event_record_t {
+    double time;
+    uint32_t event;
+    int32_t p_id;
+    int32_t subV_id;
+    uint8_t purpose;
+    vector<float> position;
+    vector<float> velocity;
+};
+
+class EventLogWriter {
+    public:
+        // an index interval of 0 writes no index or keyframes
+        EventLogWriter (const string& path, int dim, size_t chunk_size = 4096, double index_interval = 0, bool particle_index = false)
+                : path(path), dim(dim), chunk_size(chunk_size), count(0), keys(NULL), particle_index(particle_index) {
+            file = fopen(path.c_str(), "wb");
+            if (file == NULL) throw runtime_error("EventLogWriter: cannot open " + path + ": " + strerror(errno));
+            event_log_header_t header;
+            memcpy(header.magic, EVENT_LOG_MAGIC, sizeof(header.magic));
+            header.dim = dim;
+            header.reserved = 0;
+            fwrite(&header, sizeof(header), 1, file);
+
+            times.resize(chunk_size);
+            events.resize(chunk_size);
+            p_ids.resize(chunk_size);
+            subV_ids.resize(chunk_size);
+            positions.resize(chunk_size * dim);
+            velocities.resize(chunk_size * dim);
+            purposes.resize(chunk_size);
+
+            if (index_interval > 0) {
+                time_index.reset(new TimeIndexWriter(path + ".idx", index_interval));
+                keys = fopen((path + ".keys").c_str(), "wb");
+                if (keys == NULL) throw runtime_error("EventLogWriter: cannot open " + path + ".keys: " + strerror(errno));
+                memcpy(header.magic, KEYFRAME_MAGIC, sizeof(header.magic));
+                fwrite(&header, sizeof(header), 1, keys);
+            }
+        }
+
+        EventLogWriter (const EventLogWriter&) = delete;
+        EventLogWriter& operator= (const EventLogWriter&) = delete;
+
+        // a log that was not closed is closed here, but errors can only be printed
+        ~EventLogWriter () {
+            try {
+                close();
+            }
+            catch (const exception& e) {
+                fprintf(stderr, "%s\n", e.what());
+            }
+        }
+
+        // write the events buffered so far and the particle index, and close the files
+        // throws runtime_error if the log could not be written
+        void close () {
+            if (file == NULL) return;
+            flush();
+            bool failed = ferror(file) != 0;
+            failed = fclose(file) != 0 || failed;
+            file = NULL;
+            if (keys != NULL) {
+                failed = ferror(keys) != 0 || failed;
+                failed = fclose(keys) != 0 || failed;
+                keys = NULL;
+            }
+            if (failed) throw runtime_error("EventLogWriter: cannot write " + path);
+            if (particle_index) write_particle_index();
+        }
+
+        // position and velocity hold dim values each
+        void write (double time, uint32_t event, int32_t p_id, int32_t subV_id, uint8_t purpose, const float* position, const float* velocity) {
+            if (time_index && time_index->due(time)) {
+                flush();
+                time_index->add(time, ftell(file), write_keyframe());
+            }
+            if (time_index) update_keyframe(time, p_id, position, velocity);
+            if (particle_index) {
+                if (p_id >= (int)locations.size()) locations.resize(p_id + 1);
+                locations[p_id].push_back({(uint32_t)chunk_offsets.size(), (uint32_t)count});
+            }
+
+            times[count] = time;
+            events[count] = event;
+            p_ids[count] = p_id;
+            subV_ids[count] = subV_id;
+            memcpy(&positions[count * dim], position, dim * sizeof(float));
+            memcpy(&velocities[count * dim], velocity, dim * sizeof(float));
+            purposes[count] = purpose;
+            if (++count == chunk_size) flush();
+        }
+
+        // write the events buffered so far as a chunk
+        void flush () {
+            if (count == 0) return;
+            if (particle_index) chunk_offsets.push_back(ftell(file));
+            uint32_t chunk_header[2] = {(uint32_t)count, 0};
+            fwrite(chunk_header, sizeof(chunk_header), 1, file);
+            fwrite(times.data(), sizeof(double), count, file);
+            fwrite(events.data(), sizeof(uint32_t), count, file);
+            fwrite(p_ids.data(), sizeof(int32_t), count, file);
+            fwrite(subV_ids.data(), sizeof(int32_t), count, file);
+            fwrite(positions.data(), sizeof(float), count * dim, file);
+            fwrite(velocities.data(), sizeof(float), count * dim, file);
+            fwrite(purposes.data(), sizeof(uint8_t), count, file);
+            static const char padding[8] = {};
+            size_t column_bytes = count * (sizeof(double) + 3 * sizeof(int32_t) + 2 * dim * sizeof(float) + sizeof(uint8_t));
+            fwrite(padding, 1, (8 - column_bytes % 8) % 8, file);
+            fflush(file);
+            if (time_index) {
+                time_index->flush();
+                fflush(keys);
+            }
+            count = 0;
+        }
+
+    private:
+        string path;
+        FILE* file;
+        int dim;
+        size_t chunk_size;
+        size_t count;  // events in the current chunk
+        vector<double> times;
+        vector<uint32_t> events;
+        vector<int32_t> p_ids;
+        vector<int32_t> subV_ids;
+        vector<float> positions;
+        vector<float> velocities;
+        vector<uint8_t> purposes;
+
+        // last record of every particle, in the order particles were first logged
+        unique_ptr<TimeIndexWriter> time_index;
+        FILE* keys;
+        vector<int> key_index;  // index of every particle ID (-1 for IDs not logged yet)
+        vector<double> key_times;
+        vector<int32_t> key_p_ids;
+        vector<float> key_positions;
+        vector<float> key_velocities;
+
+        void update_keyframe (double time, int32_t p_id, const float* position, const float* velocity) {
+            if (p_id >= (int)key_index.size()) key_index.resize(p_id + 1, -1);
+            if (key_index[p_id] == -1) {
+                key_index[p_id] = key_p_ids.size();
+                key_p_ids.push_back(p_id);
+                key_times.push_back(time);
+                key_positions.resize(key_positions.size() + dim);
+                key_velocities.resize(key_velocities.size() + dim);
+            }
+            size_t i = key_index[p_id];
+            key_times[i] = time;
+            memcpy(&key_positions[i * dim], position, dim * sizeof(float));
+            memcpy(&key_velocities[i * dim], velocity, dim * sizeof(float));
+        }
+
+        // returns the offset of the keyframe
+        uint64_t write_keyframe () {
+            uint64_t offset = ftell(keys);
+            uint32_t keyframe_header[2] = {(uint32_t)key_p_ids.size(), 0};
+            fwrite(keyframe_header, sizeof(keyframe_header), 1, keys);
+            fwrite(key_times.data(), sizeof(double), key_times.size(), keys);
+            fwrite(key_p_ids.data(), sizeof(int32_t), key_p_ids.size(), keys);
+            fwrite(key_positions.data(), sizeof(float), key_positions.size(), keys);
+            fwrite(key_velocities.data(), sizeof(float), key_velocities.size(), keys);
+            static const char padding[8] = {};
+            size_t column_bytes = key_p_ids.size() * (sizeof(double) + sizeof(int32_t) + 2 * dim * sizeof(float));
+            fwrite(padding, 1, (8 - column_bytes % 8) % 8, keys);
+            return offset;
+        }
+
+        // records of every particle (kept in memory until the log is closed)
+        bool particle_index;
+        vector<uint64_t> chunk_offsets;
+        vector<vector<record_location_t>> locations;  // indexed by particle ID
+
+        void write_particle_index () {
+            FILE* index = fopen((path + ".pidx").c_str(), "wb");
+            if (index == NULL) throw runtime_error("EventLogWriter: cannot open " + path + ".pidx: " + strerror(errno));
+            vector<particle_index_entry_t> particles;
+            uint64_t records = 0;
+            for (size_t p_id = 0; p_id < locations.size(); ++p_id) {
+                if (locations[p_id].empty()) continue;
+                particles.push_back({(int32_t)p_id, (uint32_t)locations[p_id].size(), records});
+                records += locations[p_id].size();
+            }
+            particle_index_header_t header;
+            memcpy(header.magic, PARTICLE_INDEX_MAGIC, sizeof(header.magic));
+            header.particles = particles.size();
+            header.reserved = 0;
+            header.chunks = chunk_offsets.size();
+            header.records = records;
+            fwrite(&header, sizeof(header), 1, index);
+            fwrite(chunk_offsets.data(), sizeof(uint64_t), chunk_offsets.size(), index);
+            fwrite(particles.data(), sizeof(particle_index_entry_t), particles.size(), index);
+            for (const particle_index_entry_t& p : particles) {
+                fwrite(locations[p.p_id].data(), sizeof(record_location_t), p.count, index);
+            }
+            bool failed = ferror(index) != 0;
+            if (fclose(index) != 0 || failed) throw runtime_error("EventLogWriter: cannot write " + path + ".pidx");
+        }
+};
+
+// read-only memory mapping of a whole file
+class MappedFile {
+    public:
+        MappedFile (const string& path) {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) throw runtime_error("MappedFile: cannot open " + path + ": " + strerror(errno));
+            struct stat info;
+            fstat(fd, &info);
+            map_size = info.st_size;
+            map = (map_size > 0) ? mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+            close(fd);
+            if (map == MAP_FAILED) throw runtime_error("MappedFile: mmap failed for " + path + ": " + strerror(errno));
+        }
+
+        MappedFile (const MappedFile&) = delete;
+        MappedFile& operator= (const MappedFile&) = delete;
+
+        ~MappedFile () {
+            if (map != NULL) munmap(map, map_size);
+        }
+
+        const uint8_t* data () const {
+            return (const uint8_t*)map;
+        }
+
+        size_t size () const {
+            return map_size;
+        }
+
+    private:
+        void* map;
+        size_t map_size;
+};
+
+// random access to the records of an event log, each record is read from its chunk without reading the others
+class EventLogReader {
+    public:
+        EventLogReader (const string& path) : file(path) {
+            event_log_header_t header;
+            if (file.size() < sizeof(header)) throw runtime_error("EventLogReader: cannot read " + path);
+            memcpy(&header, file.data(), sizeof(header));
+            if (memcmp(header.magic, EVENT_LOG_MAGIC, sizeof(header.magic)) != 0) throw runtime_error("EventLogReader: " + path + " is not an event log");
+            dim = header.dim;
+        }
+
+        int dimensions () const {
+            return dim;
+        }
+
+        // row of the chunk starting at chunk_offset
+        void read (uint64_t chunk_offset, uint32_t row, event_record_t& record) const {
+            const uint8_t* chunk = file.data() + chunk_offset;
+            uint32_t count;
+            memcpy(&count, chunk, sizeof(count));
+            if (row >= count) throw out_of_range("EventLogReader: row outside of its chunk");
+            const uint8_t* column = chunk + 2 * sizeof(uint32_t);
+            memcpy(&record.time, column + row * sizeof(double), sizeof(double));
+            column += count * sizeof(double);
+            memcpy(&record.event, column + row * sizeof(uint32_t), sizeof(uint32_t));
+            column += count * sizeof(uint32_t);
+            memcpy(&record.p_id, column + row * sizeof(int32_t), sizeof(int32_t));
+            column += count * sizeof(int32_t);
+            memcpy(&record.subV_id, column + row * sizeof(int32_t), sizeof(int32_t));
+            column += count * sizeof(int32_t);
+            record.position.resize(dim);
+            memcpy(record.position.data(), column + row * dim * sizeof(float), dim * sizeof(float));
+            column += count * dim * sizeof(float);
+            record.velocity.resize(dim);
+            memcpy(record.velocity.data(), column + row * dim * sizeof(float), dim * sizeof(float));
+            column += count * dim * sizeof(float);
+            record.purpose = column[row];
+        }
+
+    private:
+        MappedFile file;
+        int dim;
+};
+
+// the particle index of an event log ("<log>.pidx")
+class ParticleIndex {
+    public:
+        ParticleIndex (const string& log_path) : file(log_path + ".pidx") {
+            if (file.size() < sizeof(header)) throw runtime_error("ParticleIndex: cannot read " + log_path + ".pidx");
+            memcpy(&header, file.data(), sizeof(header));
+            if (memcmp(header.magic, PARTICLE_INDEX_MAGIC, sizeof(header.magic)) != 0) throw runtime_error("ParticleIndex: " + log_path + ".pidx is not a particle index");
+            chunk_offsets = (const uint64_t*)(file.data() + sizeof(header));
+            particles = (const particle_index_entry_t*)(chunk_offsets + header.chunks);
+            locations = (const record_location_t*)(particles + header.particles);
+        }
+
+        // chunk offset and row of every record of a particle (none for unknown particles)
+        vector<pair<uint64_t, uint32_t>> records (int p_id) const {
+            vector<pair<uint64_t, uint32_t>> result;
+            const particle_index_entry_t* end = particles + header.particles;
+            const particle_index_entry_t* p = lower_bound(particles, end, p_id,
+                [](const particle_index_entry_t& entry, int p_id) { return entry.p_id < p_id; });
+            if (p == end || p->p_id != p_id) return result;
+            result.reserve(p->count);
+            for (uint64_t i = p->first; i < p->first + p->count; ++i) {
+                result.push_back(make_pair(chunk_offsets[locations[i].chunk], locations[i].row));
+            }
+            return result;
+        }
+
+    private:
+        MappedFile file;
+        particle_index_header_t header;
+        const uint64_t* chunk_offsets;
+        const particle_index_entry_t* particles;
+        const record_location_t* locations;
+};
+
+#endif
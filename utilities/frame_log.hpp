@@ -0,0 +1,76 @@
+#ifndef FRAME_LOG_HPP
+#define FRAME_LOG_HPP
+
+/*
+Binary log of particle positions sampled at regular times (frames), read by frame_log.py.
+
+Layout (native byte order):
+- header: magic "TPSFRM01" (8 bytes), dim (uint32), number of particles n (uint32)
+- particle IDs: n int32, followed by zero padding to a multiple of 8 bytes
+- frames, each: time (float64), positions (n * dim float32, in the order of the IDs), followed by zero
+  padding to a multiple of 8 bytes
+Every frame has the same size, so frame k starts at a fixed offset.
+*/
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>  // memcpy, strerror
+#include <cerrno>
+
+using namespace std;
+
+struct frame_log_header_t {
+    char magic[8];
+    uint32_t dim;
+    uint32_t particles;
+};
+
+static const char FRAME_LOG_MAGIC[8] = {'T', 'P', 'S', 'F', 'R', 'M', '0', '1'};
+
+class FrameLogWriter {
+    public:
+        FrameLogWriter (const string& path, const vector<int>& p_ids, int dim) : positions_size(p_ids.size() * dim) {
+            file = fopen(path.c_str(), "wb");
+            if (file == NULL) throw runtime_error("FrameLogWriter: cannot open " + path + ": " + strerror(errno));
+            frame_log_header_t header;
+            memcpy(header.magic, FRAME_LOG_MAGIC, sizeof(header.magic));
+            header.dim = dim;
+            header.particles = p_ids.size();
+            fwrite(&header, sizeof(header), 1, file);
+            vector<int32_t> ids(p_ids.begin(), p_ids.end());
+            fwrite(ids.data(), sizeof(int32_t), ids.size(), file);
+            pad(ids.size() * sizeof(int32_t));
+        }
+
+        FrameLogWriter (const FrameLogWriter&) = delete;
+        FrameLogWriter& operator= (const FrameLogWriter&) = delete;
+
+        ~FrameLogWriter () {
+            fclose(file);
+        }
+
+        // positions holds dim values per particle, in the order of the IDs given to the constructor
+        void write (double time, const float* positions) {
+            fwrite(&time, sizeof(time), 1, file);
+            fwrite(positions, sizeof(float), positions_size, file);
+            pad(positions_size * sizeof(float));
+        }
+
+        void flush () {
+            fflush(file);
+        }
+
+    private:
+        FILE* file;
+        size_t positions_size;  // floats per frame
+
+        void pad (size_t bytes) {
+            static const char padding[8] = {};
+            fwrite(padding, 1, (8 - bytes % 8) % 8, file);
+        }
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef IMPULSE_TAPE_HPP
+#define IMPULSE_TAPE_HPP
+
+/*
+Binary tape of the impulses sent by a random impulse model, used to replay exactly the same impulses
+in another run.
+
+Layout (native byte order):
+- header: magic "RITAPE01" (8 bytes), dim (uint32), reserved (uint32)
+- records: time (double), particle ID (int32), impulse (dim floats)
+Records are written in the order the impulses are sent, so their times never decrease. The time is the
+time the impulse was scheduled for.
+*/
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>  // memcpy, memcmp, strerror
+#include <cerrno>
+
+#include <fcntl.h>  // open
+#include <sys/mman.h>  // mmap
+#include <sys/stat.h>
+#include <unistd.h>  // close
+
+using namespace std;
+
+struct impulse_tape_header_t {
+    char magic[8];
+    uint32_t dim;
+    uint32_t reserved;
+};
+
+static const char IMPULSE_TAPE_MAGIC[8] = {'R', 'I', 'T', 'A', 'P', 'E', '0', '1'};
+
+class ImpulseTapeWriter {
+    public:
+        ImpulseTapeWriter (const string& path, int dim) : dim(dim) {
+            file = fopen(path.c_str(), "wb");
+            if (file == NULL) throw runtime_error("ImpulseTapeWriter: cannot open " + path + ": " + strerror(errno));
+            impulse_tape_header_t header;
+            memcpy(header.magic, IMPULSE_TAPE_MAGIC, sizeof(header.magic));
+            header.dim = dim;
+            header.reserved = 0;
+            fwrite(&header, sizeof(header), 1, file);
+        }
+
+        ImpulseTapeWriter (const ImpulseTapeWriter&) = delete;
+        ImpulseTapeWriter& operator= (const ImpulseTapeWriter&) = delete;
+
+        ~ImpulseTapeWriter () {
+            fclose(file);
+        }
+
+        void write (double time, int32_t p_id, const vector<float>& impulse) {
+            if ((int)impulse.size() != dim) throw runtime_error("ImpulseTapeWriter: impulse does not match the dimensions of the tape");
+            fwrite(&time, sizeof(time), 1, file);
+            fwrite(&p_id, sizeof(p_id), 1, file);
+            fwrite(impulse.data(), sizeof(float), dim, file);
+        }
+
+    private:
+        FILE* file;  // buffered by stdio
+        int dim;
+};
+
+// read-only view of a tape mapped into memory
+class ImpulseTapeReader {
+    public:
+        ImpulseTapeReader (const string& path) : data(NULL), map_size(0) {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) throw runtime_error("ImpulseTapeReader: cannot open " + path + ": " + strerror(errno));
+            struct stat info;
+            fstat(fd, &info);
+            map_size = info.st_size;
+            if (map_size < sizeof(impulse_tape_header_t)) {
+                close(fd);
+                throw runtime_error("ImpulseTapeReader: " + path + " is not an impulse tape");
+            }
+            void* addr = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (addr == MAP_FAILED) throw runtime_error("ImpulseTapeReader: mmap failed for " + path + ": " + strerror(errno));
+            madvise(addr, map_size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(addr);
+
+            impulse_tape_header_t header;
+            memcpy(&header, data, sizeof(header));
+            if (memcmp(header.magic, IMPULSE_TAPE_MAGIC, sizeof(header.magic)) != 0) {
+                munmap(addr, map_size);
+                throw runtime_error("ImpulseTapeReader: " + path + " is not an impulse tape");
+            }
+            dim = header.dim;
+            record_size = sizeof(double) + sizeof(int32_t) + dim * sizeof(float);
+            num_records = (map_size - sizeof(impulse_tape_header_t)) / record_size;
+        }
+
+        ImpulseTapeReader (const ImpulseTapeReader&) = delete;
+        ImpulseTapeReader& operator= (const ImpulseTapeReader&) = delete;
+
+        ~ImpulseTapeReader () {
+            if (data != NULL) munmap(const_cast<char*>(data), map_size);
+        }
+
+        size_t size () const {
+            return num_records;
+        }
+
+        int dimensions () const {
+            return dim;
+        }
+
+        double time (size_t index) const {
+            double result;
+            memcpy(&result, record(index), sizeof(result));
+            return result;
+        }
+
+        int32_t particle_id (size_t index) const {
+            int32_t result;
+            memcpy(&result, record(index) + sizeof(double), sizeof(result));
+            return result;
+        }
+
+        vector<float> impulse (size_t index) const {
+            vector<float> result(dim);
+            memcpy(result.data(), record(index) + sizeof(double) + sizeof(int32_t), dim * sizeof(float));
+            return result;
+        }
+
+    private:
+        const char* data;
+        size_t map_size;
+        int dim;
+        size_t record_size;
+        size_t num_records;
+
+        const char* record (size_t index) const {
+            return data + sizeof(impulse_tape_header_t) + index * record_size;
+        }
+};
+
+#endif
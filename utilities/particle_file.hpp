@@ -0,0 +1,197 @@
+#ifndef PARTICLE_FILE_HPP
+#define PARTICLE_FILE_HPP
+
+/*
+Binary particle input, converted from a JSON config with PARTICLE_CONVERT and accepted by ITER_1_TEST in
+place of the config (ParticleStore::load tells them apart by the magic). The file is mapped into memory
+and its records are copied into the store's columns without parsing anything but the small config text.
+
+Layout (native byte order):
+- header: magic "TPSPRT01" (8 bytes), dim (uint32), number of species (uint32),
+          number of particles (uint64), size of the config text (uint64)
+- config text: the rest of the config (without "particles" and "species") as JSON, padded with spaces to a
+  multiple of 8 bytes
+- species: {name (char[32], zero padded), mass, radius, tau, mean, shape (float32), reserved (uint32)}
+- particles: {p_id (int32), species (int32, index in the species table), position (dim float32),
+              velocity (dim float32)}
+Particles are in store order (the order of the particles of the JSON config once parsed), and keep it when
+loaded.
+*/
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>  // memcpy, memcmp, strerror
+#include <cerrno>
+
+#include <fcntl.h>  // open
+#include <sys/mman.h>  // mmap
+#include <sys/stat.h>
+#include <unistd.h>  // close
+
+#include "../data_structures/particle_store.hpp"
+
+using namespace std;
+
+struct particle_file_header_t {
+    char magic[8];
+    uint32_t dim;
+    uint32_t num_species;
+    uint64_t num_particles;
+    uint64_t config_size;
+};
+
+struct particle_file_species_t {
+    char name[32];
+    float mass;
+    float radius;
+    float tau;
+    float mean;
+    float shape;
+    uint32_t reserved;
+};
+
+static const char PARTICLE_FILE_MAGIC[8] = {'T', 'P', 'S', 'P', 'R', 'T', '0', '1'};
+
+// whether path is a particle file rather than a JSON config
+inline bool is_particle_file (const string& path) {
+    char magic[sizeof(PARTICLE_FILE_MAGIC)];
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) return false;
+    bool result = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, PARTICLE_FILE_MAGIC, sizeof(magic)) == 0;
+    fclose(file);
+    return result;
+}
+
+// the particles of store (with their initial velocities) and the config text they run with
+inline void write_particle_file (const string& path, const ParticleStore& store, const string& config_text) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == NULL) throw runtime_error("write_particle_file: cannot open " + path + ": " + strerror(errno));
+
+    const vector<species_t>& species = store.species_table();
+    string text = config_text;
+    text.resize((text.size() + 7) / 8 * 8, ' ');
+    particle_file_header_t header;
+    memcpy(header.magic, PARTICLE_FILE_MAGIC, sizeof(header.magic));
+    header.dim = store.dimensions();
+    header.num_species = species.size();
+    header.num_particles = store.size();
+    header.config_size = text.size();
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(text.data(), 1, text.size(), file);
+
+    for (const species_t& entry : species) {
+        particle_file_species_t record = {};
+        if (entry.name.size() >= sizeof(record.name)) {
+            fclose(file);
+            remove(path.c_str());
+            throw runtime_error("write_particle_file: species name " + entry.name + " is longer than 31 characters");
+        }
+        memcpy(record.name, entry.name.data(), entry.name.size());
+        record.mass = entry.mass;
+        record.radius = entry.radius;
+        record.tau = entry.tau;
+        record.mean = entry.mean;
+        record.shape = entry.shape;
+        fwrite(&record, sizeof(record), 1, file);
+    }
+
+    for (int p_id : store.ids()) {
+        int32_t fields[2] = {p_id, store.species_of(p_id)};
+        fwrite(fields, sizeof(int32_t), 2, file);
+        fwrite(store.position(p_id).data(), sizeof(float), header.dim, file);
+        fwrite(store.velocity(p_id).data(), sizeof(float), header.dim, file);
+    }
+
+    bool failed = fflush(file) != 0 || ferror(file);
+    fclose(file);
+    if (failed) throw runtime_error("write_particle_file: cannot write " + path);
+}
+
+// read-only view of a particle file mapped into memory
+class ParticleFileReader {
+    public:
+        ParticleFileReader (const string& path) : data(NULL), map_size(0) {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) throw runtime_error("ParticleFileReader: cannot open " + path + ": " + strerror(errno));
+            struct stat info;
+            fstat(fd, &info);
+            map_size = info.st_size;
+            if (map_size < sizeof(particle_file_header_t)) {
+                close(fd);
+                throw runtime_error("ParticleFileReader: " + path + " is not a particle file");
+            }
+            void* addr = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (addr == MAP_FAILED) throw runtime_error("ParticleFileReader: mmap failed for " + path + ": " + strerror(errno));
+            madvise(addr, map_size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(addr);
+
+            memcpy(&header, data, sizeof(header));
+            if (memcmp(header.magic, PARTICLE_FILE_MAGIC, sizeof(header.magic)) != 0) {
+                munmap(addr, map_size);
+                throw runtime_error("ParticleFileReader: " + path + " is not a particle file");
+            }
+            record_size = 2 * sizeof(int32_t) + 2 * header.dim * sizeof(float);
+            species_offset = sizeof(header) + header.config_size;
+            particles_offset = species_offset + header.num_species * sizeof(particle_file_species_t);
+            if (header.config_size > map_size || particles_offset + header.num_particles * record_size != map_size) {
+                munmap(addr, map_size);
+                throw runtime_error("ParticleFileReader: " + path + " is truncated");
+            }
+        }
+
+        ParticleFileReader (const ParticleFileReader&) = delete;
+        ParticleFileReader& operator= (const ParticleFileReader&) = delete;
+
+        ~ParticleFileReader () {
+            if (data != NULL) munmap(const_cast<char*>(data), map_size);
+        }
+
+        size_t size () const {
+            return header.num_particles;
+        }
+
+        int dimensions () const {
+            return header.dim;
+        }
+
+        string config_text () const {
+            return string(data + sizeof(header), header.config_size);
+        }
+
+        vector<species_t> species () const {
+            vector<species_t> result(header.num_species);
+            for (size_t i = 0; i < result.size(); ++i) {
+                particle_file_species_t record;
+                memcpy(&record, data + species_offset + i * sizeof(record), sizeof(record));
+                record.name[sizeof(record.name) - 1] = '\0';
+                result[i] = {record.name, record.mass, record.radius, record.tau, record.mean, record.shape};
+            }
+            return result;
+        }
+
+        // the records split into columns of size() (ids, species) and size() * dimensions() values (positions, velocities)
+        void copy_columns (int* ids, int* species, float* positions, float* velocities) const {
+            size_t vector_size = header.dim * sizeof(float);
+            const char* record = data + particles_offset;
+            for (size_t i = 0; i < header.num_particles; ++i, record += record_size) {
+                memcpy(&ids[i], record, sizeof(int32_t));
+                memcpy(&species[i], record + sizeof(int32_t), sizeof(int32_t));
+                memcpy(&positions[i * header.dim], record + 2 * sizeof(int32_t), vector_size);
+                memcpy(&velocities[i * header.dim], record + 2 * sizeof(int32_t) + vector_size, vector_size);
+            }
+        }
+
+    private:
+        const char* data;
+        size_t map_size;
+        particle_file_header_t header;
+        size_t record_size;
+        size_t species_offset;
+        size_t particles_offset;
+};
+
+#endif
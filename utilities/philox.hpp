@@ -0,0 +1,86 @@
+#ifndef PHILOX_HPP
+#define PHILOX_HPP
+
+/*
+Counter-based random numbers (Philox4x32-10, Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3").
+
+Every block of four 32-bit numbers is a pure function of a 128-bit counter and a 64-bit key, so a
+stream can be identified by part of the counter (ex. a particle ID) and the numbers it produces do
+not depend on how many other streams exist or on the order in which they are used.
+*/
+
+#include <array>
+#include <cstdint>
+#include <limits>
+
+using namespace std;
+
+class Philox4x32 {
+    public:
+        using counter_t = array<uint32_t, 4>;
+        using key_t = array<uint32_t, 2>;
+
+        static counter_t generate (counter_t counter, key_t key) {
+            for (int round = 0; round < 10; ++round) {
+                uint64_t product0 = uint64_t(M0) * counter[0];
+                uint64_t product1 = uint64_t(M1) * counter[2];
+                counter = {
+                    uint32_t(product1 >> 32) ^ counter[1] ^ key[0],
+                    uint32_t(product1),
+                    uint32_t(product0 >> 32) ^ counter[3] ^ key[1],
+                    uint32_t(product0)
+                };
+                key[0] += W0;
+                key[1] += W1;
+            }
+            return counter;
+        }
+
+    private:
+        static constexpr uint32_t M0 = 0xD2511F53;
+        static constexpr uint32_t M1 = 0xCD9E8D57;
+        static constexpr uint32_t W0 = 0x9E3779B9;  // golden ratio
+        static constexpr uint32_t W1 = 0xBB67AE85;  // sqrt(3) - 1
+};
+
+/*
+One independent stream of a Philox generator, usable wherever a standard engine is (it satisfies
+UniformRandomBitGenerator). The stream is identified by (id, sub_id) and the position in the stream
+is the last two counter words.
+*/
+class PhiloxStream {
+    public:
+        using result_type = uint32_t;
+
+        PhiloxStream () : PhiloxStream(0, 0, 0) {}
+        PhiloxStream (uint64_t seed, uint32_t id, uint32_t sub_id) : id(id), sub_id(sub_id), block(0), next(4) {
+            key = {uint32_t(seed), uint32_t(seed >> 32)};
+        }
+
+        static constexpr result_type min () { return 0; }
+        static constexpr result_type max () { return numeric_limits<result_type>::max(); }
+
+        result_type operator() () {
+            if (next == 4) {
+                values = Philox4x32::generate({id, sub_id, uint32_t(block), uint32_t(block >> 32)}, key);
+                ++block;
+                next = 0;
+            }
+            return values[next++];
+        }
+
+        // uniform float in [0, 1) built from the top 24 bits (all that a float can represent)
+        float uniform () {
+            return ((*this)() >> 8) * (1.0f / 16777216.0f);
+        }
+
+    private:
+        Philox4x32::key_t key;
+        uint32_t id;
+        uint32_t sub_id;
+        uint64_t block;  // blocks generated so far
+        Philox4x32::counter_t values;  // current block
+        int next;  // index of the next unused value of the current block
+};
+
+#endif
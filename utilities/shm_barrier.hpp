@@ -0,0 +1,151 @@
+#ifndef SHM_BARRIER_HPP
+#define SHM_BARRIER_HPP
+
+/*
+Barrier shared between the processes of a domain-decomposed run.
+
+Every participant reports a value and then blocks until all participants have arrived. Each participant is
+then released with the minimum of the reported values (the domain driver reports the time of its next event,
+which bounds how far every domain may safely advance, see test/main_domain_test.cpp).
+
+A participant that fails aborts the barrier: every wait, current or later, then throws instead of waiting for
+a participant that will never arrive.
+*/
+
+#include <string>
+#include <stdexcept>
+#include <limits>
+#include <cstring>  // strerror
+#include <cerrno>
+
+#include <fcntl.h>  // O_* constants
+#include <pthread.h>
+#include <sys/mman.h>  // shm_open, mmap
+#include <unistd.h>  // ftruncate, close
+
+using namespace std;
+
+class ShmBarrier {
+    public:
+        ShmBarrier () : shared(NULL), owner(false) {}
+
+        // create the barrier for a fixed number of participants (call before forking)
+        static ShmBarrier create (const string& name, int participants) {
+            int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+            if (fd < 0) throw runtime_error("ShmBarrier: shm_open failed for " + name + ": " + strerror(errno));
+            if (ftruncate(fd, sizeof(shared_t)) != 0) {
+                close(fd);
+                throw runtime_error("ShmBarrier: ftruncate failed for " + name + ": " + strerror(errno));
+            }
+            void* addr = mmap(NULL, sizeof(shared_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (addr == MAP_FAILED) throw runtime_error("ShmBarrier: mmap failed for " + name + ": " + strerror(errno));
+
+            ShmBarrier barrier;
+            barrier.shared = static_cast<shared_t*>(addr);
+            barrier.name = name;
+            barrier.owner = true;
+
+            pthread_mutexattr_t mutex_attr;
+            pthread_mutexattr_init(&mutex_attr);
+            pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+            pthread_mutex_init(&barrier.shared->mutex, &mutex_attr);
+            pthread_mutexattr_destroy(&mutex_attr);
+
+            pthread_condattr_t cond_attr;
+            pthread_condattr_init(&cond_attr);
+            pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+            pthread_cond_init(&barrier.shared->cond, &cond_attr);
+            pthread_condattr_destroy(&cond_attr);
+
+            barrier.shared->participants = participants;
+            barrier.shared->arrived = 0;
+            barrier.shared->generation = 0;
+            barrier.shared->pending_min = numeric_limits<double>::infinity();
+            barrier.shared->released_min = numeric_limits<double>::infinity();
+            barrier.shared->aborted = false;
+            return barrier;
+        }
+
+        ShmBarrier (ShmBarrier&& other) : ShmBarrier() { swap_with(other); }
+        ShmBarrier& operator= (ShmBarrier&& other) { swap_with(other); return *this; }
+        ShmBarrier (const ShmBarrier&) = delete;
+        ShmBarrier& operator= (const ShmBarrier&) = delete;
+
+        ~ShmBarrier () {
+            if (shared == NULL) return;
+            // after an abort participants may have died waiting or holding the mutex, and destroying the condition
+            // would wait for them forever (the segment is unlinked either way)
+            if (owner && !shared->aborted) {
+                pthread_cond_destroy(&shared->cond);
+                pthread_mutex_destroy(&shared->mutex);
+            }
+            munmap(shared, sizeof(shared_t));
+            if (owner) shm_unlink(name.c_str());
+        }
+
+        // block until every participant has arrived, returns the minimum local_time reported this round
+        // throws runtime_error if the barrier is aborted
+        double wait (double local_time) {
+            pthread_mutex_lock(&shared->mutex);
+            if (shared->aborted) {
+                pthread_mutex_unlock(&shared->mutex);
+                throw runtime_error("ShmBarrier: aborted by another participant");
+            }
+            unsigned long generation = shared->generation;
+            if (local_time < shared->pending_min) shared->pending_min = local_time;
+            if (++shared->arrived == shared->participants) {
+                // last to arrive publishes the result and opens the next round
+                shared->released_min = shared->pending_min;
+                shared->pending_min = numeric_limits<double>::infinity();
+                shared->arrived = 0;
+                ++shared->generation;
+                pthread_cond_broadcast(&shared->cond);
+            }
+            else {
+                while (generation == shared->generation && !shared->aborted) {
+                    pthread_cond_wait(&shared->cond, &shared->mutex);
+                }
+                if (generation == shared->generation) {
+                    pthread_mutex_unlock(&shared->mutex);
+                    throw runtime_error("ShmBarrier: aborted by another participant");
+                }
+            }
+            double result = shared->released_min;
+            pthread_mutex_unlock(&shared->mutex);
+            return result;
+        }
+
+        // release every participant waiting now or later (with an exception), called by a participant that cannot
+        // go on or by the creator when a participant has died
+        void abort () {
+            pthread_mutex_lock(&shared->mutex);
+            shared->aborted = true;
+            pthread_cond_broadcast(&shared->cond);
+            pthread_mutex_unlock(&shared->mutex);
+        }
+
+    private:
+        struct shared_t {
+            pthread_mutex_t mutex;
+            pthread_cond_t cond;
+            int participants;
+            int arrived;
+            unsigned long generation;
+            double pending_min;  // minimum of the times reported so far in the current round
+            double released_min;  // result of the last completed round
+            bool aborted;  // set once by abort, never cleared
+        };
+
+        shared_t* shared;
+        string name;
+        bool owner;  // the creator destroys the primitives and unlinks the segment
+
+        void swap_with (ShmBarrier& other) {
+            swap(shared, other.shared);
+            swap(name, other.name);
+            swap(owner, other.owner);
+        }
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef SHM_RING_HPP
+#define SHM_RING_HPP
+
+/*
+Single-producer/single-consumer ring buffer living in POSIX shared memory.
+
+Used to pass fixed-size records (ex. boundary-crossing particles) between the processes of a
+domain-decomposed run. The producer only writes head, the consumer only writes tail, so no locks
+are required. Records must be trivially copyable since they are copied byte-for-byte into the
+shared segment.
+*/
+
+#include <atomic>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>  // strerror
+#include <cerrno>
+
+#include <fcntl.h>  // O_* constants
+#include <sys/mman.h>  // shm_open, mmap
+#include <sys/stat.h>
+#include <unistd.h>  // ftruncate, close
+
+using namespace std;
+
+template <typename T>
+class ShmRing {
+    static_assert(is_trivially_copyable<T>::value, "ShmRing records must be trivially copyable");
+
+    public:
+        ShmRing () : header(NULL), slots(NULL), map_size(0), owner(false) {}
+
+        // create (or truncate) a named segment able to hold capacity records
+        static ShmRing create (const string& name, uint64_t capacity) {
+            int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+            if (fd < 0) throw runtime_error("ShmRing: shm_open failed for " + name + ": " + strerror(errno));
+            size_t size = sizeof(header_t) + capacity * sizeof(T);
+            if (ftruncate(fd, size) != 0) {
+                close(fd);
+                throw runtime_error("ShmRing: ftruncate failed for " + name + ": " + strerror(errno));
+            }
+            ShmRing ring = map(fd, size, name);
+            ring.header->head.store(0);
+            ring.header->tail.store(0);
+            ring.header->capacity = capacity;
+            ring.owner = true;
+            return ring;
+        }
+
+        // attach to a segment previously made by create
+        static ShmRing open (const string& name) {
+            int fd = shm_open(name.c_str(), O_RDWR, 0600);
+            if (fd < 0) throw runtime_error("ShmRing: shm_open failed for " + name + ": " + strerror(errno));
+            struct stat info;
+            fstat(fd, &info);
+            return map(fd, info.st_size, name);
+        }
+
+        ShmRing (ShmRing&& other) : ShmRing() { swap_with(other); }
+        ShmRing& operator= (ShmRing&& other) { swap_with(other); return *this; }
+        ShmRing (const ShmRing&) = delete;
+        ShmRing& operator= (const ShmRing&) = delete;
+
+        ~ShmRing () {
+            if (header != NULL) munmap(header, map_size);
+            if (owner) shm_unlink(name.c_str());
+        }
+
+        // returns false if the ring is full
+        bool push (const T& record) {
+            uint64_t head = header->head.load(memory_order_relaxed);
+            if (head - header->tail.load(memory_order_acquire) == header->capacity) return false;
+            slots[head % header->capacity] = record;
+            header->head.store(head + 1, memory_order_release);
+            return true;
+        }
+
+        // returns false if the ring is empty
+        bool pop (T& record) {
+            uint64_t tail = header->tail.load(memory_order_relaxed);
+            if (tail == header->head.load(memory_order_acquire)) return false;
+            record = slots[tail % header->capacity];
+            header->tail.store(tail + 1, memory_order_release);
+            return true;
+        }
+
+        uint64_t size () const {
+            return header->head.load(memory_order_acquire) - header->tail.load(memory_order_acquire);
+        }
+
+        uint64_t capacity () const {
+            return header->capacity;
+        }
+
+    private:
+        // head and tail are kept on separate cache lines so producer and consumer do not contend
+        struct header_t {
+            alignas(64) atomic<uint64_t> head;
+            alignas(64) atomic<uint64_t> tail;
+            uint64_t capacity;
+        };
+
+        header_t* header;
+        T* slots;
+        size_t map_size;
+        string name;
+        bool owner;  // the creator unlinks the segment on destruction
+
+        static ShmRing map (int fd, size_t size, const string& name) {
+            void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (addr == MAP_FAILED) throw runtime_error("ShmRing: mmap failed for " + name + ": " + strerror(errno));
+            ShmRing ring;
+            ring.header = static_cast<header_t*>(addr);
+            ring.slots = reinterpret_cast<T*>(static_cast<char*>(addr) + sizeof(header_t));
+            ring.map_size = size;
+            ring.name = name;
+            return ring;
+        }
+
+        void swap_with (ShmRing& other) {
+            swap(header, other.header);
+            swap(slots, other.slots);
+            swap(map_size, other.map_size);
+            swap(name, other.name);
+            swap(owner, other.owner);
+        }
+};
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef TEXT_FORMAT_HPP
+#define TEXT_FORMAT_HPP
+
+/*
+Text buffer used by the message and state printers. Numbers are written with to_chars (no locale, no
+temporary strings) into a buffer that is reused from one call to the next. Floats are written like
+to_string (printf "%f"), so the logs do not change and output_tools.py and visualizer/Parser.py keep
+reading them.
+
+Every thread has its own buffer (local()). A printer appends to the end of the buffer, then hands what it
+appended to its stream with flush_to (or take), which also removes it from the buffer. Printers can
+therefore call other printers while sharing the buffer.
+*/
+
+#include <charconv>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cstring>  // strlen
+#include <type_traits>
+#include <algorithm>  // max
+
+using namespace std;
+
+class TextBuffer {
+    public:
+        // buffer of the calling thread
+        static TextBuffer& local () {
+            static thread_local TextBuffer buffer;
+            return buffer;
+        }
+
+        size_t size () const {
+            return length;
+        }
+
+        TextBuffer& append (const char* s, size_t n) {
+            memcpy(reserve(n), s, n);
+            length += n;
+            return *this;
+        }
+
+        TextBuffer& operator<< (const char* s) { return append(s, strlen(s)); }
+        TextBuffer& operator<< (const string& s) { return append(s.data(), s.size()); }
+        TextBuffer& operator<< (char c) { return append(&c, 1); }
+
+        template <typename T, typename = enable_if_t<is_integral_v<T> && !is_same_v<T, char> && !is_same_v<T, bool>>>
+        TextBuffer& operator<< (T value) {
+            char* first = reserve(max_integer_chars);
+            length = to_chars(first, first + max_integer_chars, value).ptr - text.data();
+            return *this;
+        }
+
+        // same text as to_string: fixed notation with 6 decimals, "inf", "-inf", "nan" or "-nan"
+        TextBuffer& operator<< (double value) {
+            char* first = reserve(max_float_chars);
+            length = to_chars(first, first + max_float_chars, value, chars_format::fixed, 6).ptr - text.data();
+            return *this;
+        }
+
+        TextBuffer& operator<< (float value) {
+            return *this << double(value);  // to_string(float) promotes to double as well
+        }
+
+        // values separated by spaces, between < and > with brackets (the format of VectorUtils::get_string)
+        template <typename T>
+        TextBuffer& append_values (const T* first, const T* last, bool brackets) {
+            if (brackets) *this << '<';
+            for (const T* value = first; value != last; ++value) {
+                if (value != first) *this << ' ';
+                *this << *value;
+            }
+            if (brackets) *this << '>';
+            return *this;
+        }
+
+        // write the text appended since start to os and remove it from the buffer
+        void flush_to (ostream& os, size_t start) {
+            os.write(text.data() + start, length - start);
+            length = start;
+        }
+
+        // the text appended since start, removed from the buffer
+        string take (size_t start) {
+            string result(text.data() + start, length - start);
+            length = start;
+            return result;
+        }
+
+    private:
+        static constexpr size_t max_integer_chars = 24;
+        static constexpr size_t max_float_chars = 320;  // "-", 309 integer digits (DBL_MAX), "." and 6 decimals
+
+        vector<char> text;
+        size_t length = 0;
+
+        // room for n more characters
+        char* reserve (size_t n) {
+            if (length + n > text.size()) text.resize(max(2 * text.size(), length + n));
+            return text.data() + length;
+        }
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef TIME_INDEX_HPP
+#define TIME_INDEX_HPP
+
+/*
+Sidecar index of a log ("<log>.idx") giving the file offset at which each block of simulation time starts,
+so that readers can jump to a time with a binary search instead of scanning the log
+(see read_index in event_log.py).
+
+Layout (native byte order): magic "TPSIDX01" (8 bytes), then fixed-size entries sorted by time:
+    time      float64  first time logged in the block
+    offset    uint64   offset in the log of the first record at that time
+    keyframe  uint64   offset in "<log>.keys" of the full state before that record (NO_KEYFRAME if the log
+                       has no keyframes)
+An entry is added for the first time logged and then for the first time logged in every later block of
+length interval ([k * interval, (k + 1) * interval)).
+*/
+
+#include <string>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>  // floor
+#include <cstring>  // strerror
+#include <cerrno>
+
+using namespace std;
+
+struct time_index_entry_t {
+    double time;
+    uint64_t offset;
+    uint64_t keyframe;
+};
+
+static const char TIME_INDEX_MAGIC[8] = {'T', 'P', 'S', 'I', 'D', 'X', '0', '1'};
+static const uint64_t NO_KEYFRAME = UINT64_MAX;
+
+class TimeIndexWriter {
+    public:
+        TimeIndexWriter (const string& path, double interval) : interval(interval), next_block(-INFINITY) {
+            if (!(interval > 0)) throw invalid_argument("TimeIndexWriter: interval must be positive");
+            file = fopen(path.c_str(), "wb");
+            if (file == NULL) throw runtime_error("TimeIndexWriter: cannot open " + path + ": " + strerror(errno));
+            fwrite(TIME_INDEX_MAGIC, 1, sizeof(TIME_INDEX_MAGIC), file);
+        }
+
+        TimeIndexWriter (const TimeIndexWriter&) = delete;
+        TimeIndexWriter& operator= (const TimeIndexWriter&) = delete;
+
+        ~TimeIndexWriter () {
+            fclose(file);
+        }
+
+        // whether a record at time starts a new block (times must not decrease)
+        bool due (double time) const {
+            return time >= next_block;
+        }
+
+        void add (double time, uint64_t offset, uint64_t keyframe = NO_KEYFRAME) {
+            time_index_entry_t entry = {time, offset, keyframe};
+            fwrite(&entry, sizeof(entry), 1, file);
+            next_block = (floor(time / interval) + 1) * interval;
+        }
+
+        void flush () {
+            fflush(file);
+        }
+
+    private:
+        FILE* file;
+        double interval;
+        double next_block;  // start of the block after the last entry
+};
+
+#endif
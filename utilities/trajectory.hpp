@@ -0,0 +1,362 @@
+#ifndef TRAJECTORY_HPP
+#define TRAJECTORY_HPP
+
+/*
+Compact trajectory log: the velocity changes of every particle (the logging messages of subV), from which
+positions are reconstructed. Read with TrajectoryReader or trajectory.py.
+
+Between events a particle moves in a straight line, so a position is only stored when it cannot be
+reconstructed from the particle's previous event as position + velocity * (time - previous time) (the
+arithmetic of subV, in float). Every field is stored relative to the previous record or to the particle's
+previous event and written as a (zigzag) varint.
+
+Layout (fixed width values little endian, whatever the byte order of the writing host):
+- header: magic "TPSTRJ01" (8 bytes), dim (uint32), reserved (uint32),
+          velocity quantum (float32), position quantum (float32)
+- records, each:
+    flags       1 byte: purpose_t (bits 0-2), position stored (bit 3), subV ID stored (bit 4)
+    time        varint, difference between the float32 bit patterns of the time and of the previous
+                record's time (times never decrease, so neither do their bit patterns)
+    p_id        zigzag varint, difference with the previous record's p_id
+    subV_id     zigzag varint, only if it differs from the previous record's
+    velocity    dim float32, or with a velocity quantum: dim zigzag varints, difference (in quanta) with
+                the particle's previous velocity
+    position    only if stored: dim float32, or with a position quantum: dim zigzag varints, difference
+                (in quanta) with the reconstructed position
+A quantum of 0 stores the values exactly. With a position quantum, a position is stored when the
+reconstruction is off by more than half a quantum in any dimension.
+*/
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>  // memcpy, strerror
+#include <cerrno>
+#include <cmath>  // llround, abs
+
+using namespace std;
+
+struct trajectory_header_t {
+    char magic[8];
+    uint32_t dim;
+    uint32_t reserved;
+    float velocity_quantum;
+    float position_quantum;
+};
+
+static const char TRAJECTORY_MAGIC[8] = {'T', 'P', 'S', 'T', 'R', 'J', '0', '1'};
+
+#define TRAJECTORY_PURPOSE_MASK 0x07
+#define TRAJECTORY_HAS_POSITION 0x08
+#define TRAJECTORY_HAS_SUBV 0x10
+
+// one velocity change of a particle, with its position at that time
+struct trajectory_event_t {
+    float time;
+    int p_id;
+    int subV_id;
+    uint8_t purpose;  // purpose_t
+    vector<float> position;
+    vector<float> velocity;
+};
+
+namespace TrajectoryCodec {
+    inline uint64_t zigzag (int64_t value) {
+        return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    }
+
+    inline int64_t unzigzag (uint64_t value) {
+        return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+    }
+
+    inline void put_varint (vector<uint8_t>& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((uint8_t)value);
+    }
+
+    inline uint64_t get_varint (const uint8_t*& in, const uint8_t* end) {
+        uint64_t value = 0;
+        for (int shift = 0; in < end && shift < 64; shift += 7) {
+            uint8_t byte = *in++;
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) return value;
+        }
+        throw runtime_error("trajectory: truncated varint");
+    }
+
+    inline uint32_t float_bits (float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    inline float bits_float (uint32_t bits) {
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // fixed width values are stored little endian whatever the byte order of the host
+    inline void put_uint32 (vector<uint8_t>& out, uint32_t value) {
+        for (int i = 0; i < 4; ++i) out.push_back((uint8_t)(value >> (8 * i)));
+    }
+
+    inline uint32_t get_uint32 (const uint8_t*& in, const uint8_t* end) {
+        if (end - in < 4) throw runtime_error("trajectory: truncated value");
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) value |= (uint32_t)*in++ << (8 * i);
+        return value;
+    }
+
+    inline void put_float (vector<uint8_t>& out, float value) {
+        put_uint32(out, float_bits(value));
+    }
+
+    inline float get_float (const uint8_t*& in, const uint8_t* end) {
+        return bits_float(get_uint32(in, end));
+    }
+
+    inline void put_header (vector<uint8_t>& out, const trajectory_header_t& header) {
+        out.insert(out.end(), header.magic, header.magic + sizeof(header.magic));
+        put_uint32(out, header.dim);
+        put_uint32(out, header.reserved);
+        put_float(out, header.velocity_quantum);
+        put_float(out, header.position_quantum);
+    }
+
+    inline trajectory_header_t get_header (const uint8_t*& in, const uint8_t* end) {
+        trajectory_header_t header;
+        if (end - in < (ptrdiff_t)sizeof(header.magic)) throw runtime_error("trajectory: truncated header");
+        memcpy(header.magic, in, sizeof(header.magic));
+        in += sizeof(header.magic);
+        header.dim = get_uint32(in, end);
+        header.reserved = get_uint32(in, end);
+        header.velocity_quantum = get_float(in, end);
+        header.position_quantum = get_float(in, end);
+        return header;
+    }
+}
+
+/*
+What both the writer and the reader know about a particle after its last event: the writer encodes against
+the reader's view (including the rounding of quantized values) so that errors never accumulate.
+*/
+class TrajectoryState {
+    public:
+        struct particle_t {
+            bool known = false;
+            float time = 0;
+            vector<float> position;
+            vector<float> velocity;
+            vector<int64_t> velocity_quanta;
+        };
+
+        TrajectoryState (int dim = 0, float velocity_quantum = 0, float position_quantum = 0)
+            : dim(dim), velocity_quantum(velocity_quantum), position_quantum(position_quantum), time(0), p_id(0), subV_id(0) {}
+
+        particle_t& particle (int p_id) {
+            if (p_id < 0) throw runtime_error("trajectory: negative particle ID");
+            if (p_id >= (int)particles.size()) particles.resize(p_id + 1);
+            particle_t& result = particles[p_id];
+            if (!result.known) {
+                result.position.assign(dim, 0);
+                result.velocity.assign(dim, 0);
+                result.velocity_quanta.assign(dim, 0);
+            }
+            return result;
+        }
+
+        // where the particle is at time according to its last event (same arithmetic as subV)
+        void reconstruct (const particle_t& p, float time, vector<float>& out) const {
+            float dt = time - p.time;
+            for (int i = 0; i < dim; ++i) out[i] = p.position[i] + p.velocity[i] * dt;
+        }
+
+    protected:
+        int dim;
+        float velocity_quantum;
+        float position_quantum;
+        float time;  // of the previous record
+        int p_id;
+        int subV_id;
+        vector<particle_t> particles;  // indexed by particle ID
+};
+
+class TrajectoryWriter : public TrajectoryState {
+    public:
+        // quanta of 0 store velocities and positions exactly
+        TrajectoryWriter (const string& path, int dim, float velocity_quantum = 0, float position_quantum = 0)
+                : TrajectoryState(dim, velocity_quantum, position_quantum), reconstructed(dim) {
+            file = fopen(path.c_str(), "wb");
+            if (file == NULL) throw runtime_error("TrajectoryWriter: cannot open " + path + ": " + strerror(errno));
+            trajectory_header_t header;
+            memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+            header.dim = dim;
+            header.reserved = 0;
+            header.velocity_quantum = velocity_quantum;
+            header.position_quantum = position_quantum;
+            TrajectoryCodec::put_header(buffer, header);
+            flush();
+        }
+
+        TrajectoryWriter (const TrajectoryWriter&) = delete;
+        TrajectoryWriter& operator= (const TrajectoryWriter&) = delete;
+
+        ~TrajectoryWriter () {
+            flush();
+            fclose(file);
+        }
+
+        // position and velocity hold dim values each, times must not decrease
+        void write (float time, int p_id, int subV_id, uint8_t purpose, const float* position, const float* velocity) {
+            using namespace TrajectoryCodec;
+            if (time < this->time) throw runtime_error("TrajectoryWriter: time went backwards");
+            particle_t& p = particle(p_id);
+            if (p.known) {
+                reconstruct(p, time, reconstructed);
+            } else {
+                reconstructed.assign(dim, 0);
+            }
+
+            bool store_position = !p.known;
+            for (int i = 0; i < dim && !store_position; ++i) {
+                if (position_quantum > 0) store_position = abs(position[i] - reconstructed[i]) > position_quantum / 2;
+                else store_position = float_bits(position[i]) != float_bits(reconstructed[i]);
+            }
+
+            uint8_t flags = purpose & TRAJECTORY_PURPOSE_MASK;
+            if (store_position) flags |= TRAJECTORY_HAS_POSITION;
+            if (subV_id != this->subV_id) flags |= TRAJECTORY_HAS_SUBV;
+            buffer.push_back(flags);
+            put_varint(buffer, float_bits(time) - float_bits(this->time));
+            put_varint(buffer, zigzag((int64_t)p_id - this->p_id));
+            if (flags & TRAJECTORY_HAS_SUBV) put_varint(buffer, zigzag((int64_t)subV_id - this->subV_id));
+
+            for (int i = 0; i < dim; ++i) {
+                if (velocity_quantum > 0) {
+                    int64_t quanta = llround(velocity[i] / velocity_quantum);
+                    put_varint(buffer, zigzag(quanta - p.velocity_quanta[i]));
+                    p.velocity_quanta[i] = quanta;
+                    p.velocity[i] = quanta * velocity_quantum;
+                } else {
+                    put_float(buffer, velocity[i]);
+                    p.velocity[i] = velocity[i];
+                }
+            }
+            for (int i = 0; i < dim; ++i) {
+                if (!store_position) {
+                    p.position[i] = reconstructed[i];
+                } else if (position_quantum > 0) {
+                    int64_t quanta = llround(position[i] / position_quantum);
+                    put_varint(buffer, zigzag(quanta - llround(reconstructed[i] / position_quantum)));
+                    p.position[i] = quanta * position_quantum;
+                } else {
+                    put_float(buffer, position[i]);
+                    p.position[i] = position[i];
+                }
+            }
+
+            p.known = true;
+            p.time = time;
+            this->time = time;
+            this->p_id = p_id;
+            this->subV_id = subV_id;
+            if (buffer.size() >= (1 << 16)) flush();
+        }
+
+        void flush () {
+            fwrite(buffer.data(), 1, buffer.size(), file);
+            fflush(file);
+            buffer.clear();
+        }
+
+    private:
+        FILE* file;
+        vector<uint8_t> buffer;
+        vector<float> reconstructed;
+};
+
+class TrajectoryReader : public TrajectoryState {
+    public:
+        TrajectoryReader (const string& path) {
+            FILE* file = fopen(path.c_str(), "rb");
+            if (file == NULL) throw runtime_error("TrajectoryReader: cannot open " + path + ": " + strerror(errno));
+            fseek(file, 0, SEEK_END);
+            data.resize(ftell(file));
+            fseek(file, 0, SEEK_SET);
+            size_t read = fread(data.data(), 1, data.size(), file);
+            fclose(file);
+
+            if (read != data.size()) throw runtime_error("TrajectoryReader: cannot read " + path);
+            const uint8_t* in = data.data();
+            trajectory_header_t header = TrajectoryCodec::get_header(in, data.data() + data.size());
+            if (memcmp(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic)) != 0) throw runtime_error("TrajectoryReader: " + path + " is not a trajectory log");
+            dim = header.dim;
+            velocity_quantum = header.velocity_quantum;
+            position_quantum = header.position_quantum;
+            next_record = in;
+        }
+
+        int dimensions () const {
+            return dim;
+        }
+
+        // false once every event has been read
+        bool next (trajectory_event_t& event) {
+            using namespace TrajectoryCodec;
+            const uint8_t* in = next_record;
+            const uint8_t* end = data.data() + data.size();
+            if (in == end) return false;
+
+            uint8_t flags = *in++;
+            time = bits_float(float_bits(time) + (uint32_t)get_varint(in, end));
+            p_id += unzigzag(get_varint(in, end));
+            if (flags & TRAJECTORY_HAS_SUBV) subV_id += unzigzag(get_varint(in, end));
+
+            particle_t& p = particle(p_id);
+            event.time = time;
+            event.p_id = p_id;
+            event.subV_id = subV_id;
+            event.purpose = flags & TRAJECTORY_PURPOSE_MASK;
+            event.position.resize(dim);
+            event.velocity.resize(dim);
+            if (p.known) reconstruct(p, time, event.position);
+
+            for (int i = 0; i < dim; ++i) {
+                if (velocity_quantum > 0) {
+                    p.velocity_quanta[i] += unzigzag(get_varint(in, end));
+                    p.velocity[i] = p.velocity_quanta[i] * velocity_quantum;
+                } else {
+                    p.velocity[i] = get_float(in, end);
+                }
+            }
+            if (flags & TRAJECTORY_HAS_POSITION) {
+                for (int i = 0; i < dim; ++i) {
+                    if (position_quantum > 0) {
+                        int64_t base = p.known ? llround(event.position[i] / position_quantum) : 0;
+                        event.position[i] = (base + unzigzag(get_varint(in, end))) * position_quantum;
+                    } else {
+                        event.position[i] = get_float(in, end);
+                    }
+                }
+            }
+
+            p.position = event.position;
+            event.velocity = p.velocity;
+            p.known = true;
+            p.time = time;
+            next_record = in;
+            return true;
+        }
+
+    private:
+        vector<uint8_t> data;
+        const uint8_t* next_record;
+};
+
+#endif
@@ -5,12 +5,38 @@
 #include <cmath>
 #include <limits>
 #include <string>
+#include <iterator>  // data, size
+#include <type_traits>
+
+#include "text_format.hpp"  // TextBuffer
 
 using namespace std;
 
 // type of value that makes a vector
 using COMPONENT = float;
 
+// read-only view of contiguous components (ex. the position of a particle in a column of the particle store)
+// it does not own the components, convert it to a vector<COMPONENT> to keep a copy
+class vector_view_t {
+    public:
+        vector_view_t (const COMPONENT* first, size_t count) : first(first), count(count) {}
+
+        // any container of contiguous components (vector<COMPONENT>, inline_vector_t)
+        template <typename CONTAINER, typename = enable_if_t<is_convertible_v<decltype(std::data(declval<const CONTAINER&>())), const COMPONENT*>>>
+        vector_view_t (const CONTAINER& values) : first(std::data(values)), count(std::size(values)) {}
+
+        const COMPONENT* data () const { return first; }
+        const COMPONENT* begin () const { return first; }
+        const COMPONENT* end () const { return first + count; }
+        size_t size () const { return count; }
+        COMPONENT operator[] (size_t i) const { return first[i]; }
+        operator vector<COMPONENT> () const { return vector<COMPONENT>(begin(), end()); }
+
+    private:
+        const COMPONENT* first;
+        size_t count;
+};
+
 class VectorUtils {
 
     public:
@@ -91,21 +117,17 @@ class VectorUtils {
             return v1;
         }
 
+        // components as formatted by to_string, separated by spaces (between < and > with brackets)
         template <typename T>
-        static string get_string (vector<T> v, bool brackets) {
-            string result = "";
-            for (unsigned int i = 0; i < v.size(); ++i) {
-                result += to_string(v[i]);
-                if (i != v.size() - 1) {
-                    result += " ";
-                }
-            }
-            if (brackets) return "<" + result + ">";
-            return result;
+        static string get_string (const vector<T>& v, bool brackets) {
+            TextBuffer& text = TextBuffer::local();
+            size_t start = text.size();
+            text.append_values(v.data(), v.data() + v.size(), brackets);
+            return text.take(start);
         }
 
         template <typename T>
-        static string get_string (vector<T> v) {
+        static string get_string (const vector<T>& v) {
             return get_string<T>(v, false);
         }
 
@@ -3,8 +3,12 @@
 # Parser, prepares data for use
 
 from Snapshot import Snapshot
+from pathlib import Path
+import sys
 import re
 import json
+import struct
+import bisect
 
 class Parser:
 
@@ -47,13 +51,16 @@ class Parser:
 
     # get and prepare data for the visualizer
     # args:
-    #     messageLogFilename: name of message log file
+    #     messageLogFilename: name of message log file or binary event log
     #     configFilename: name of (Cadmium model's) configuration file
     # return:
     #     dictionary containing data for visualization
     @staticmethod
     def getData (messageLogFilename, configFilename):
-        result = Parser.UnifiedParser.parseLog(Parser.importRaw(messageLogFilename))
+        if (Parser.EventLogParser.isEventLog(messageLogFilename)):
+            result = Parser.EventLogParser.parseLog(messageLogFilename)
+        else:
+            result = Parser.UnifiedParser.parseLog(Parser.importRaw(messageLogFilename))
         return {
             "events" : result,
             "properties" : Parser.ConfigParser.parseParticleProperties(Parser.importJSON(configFilename))
@@ -178,16 +185,22 @@ class Parser:
     # ------------------------------------------------
     # Index and access information related to Cadmium's state log
     # Avoid storing more of the file than what is required
+    # If the simulator wrote a sidecar index (log_index_interval), only the block holding a time is read
     # ------------------------------------------------
 
     class FileIndex:
 
         def __init__ (self, filename):
             self.filename = filename
-            self.index = Parser.FileIndex.indexFile(filename)  # of format: {{key, loc}, {key, loc}, ...}
+            self.blocks = Parser.FileIndex.readBlocks(filename)  # of format: ([time, time, ...], [loc, loc, ...]) or None
+            self.complete = self.blocks is None
+            self.index = Parser.FileIndex.indexFile(filename) if self.complete else {}  # of format: {{key, loc}, {key, loc}, ...}
 
         # define the [] operator
         def __getitem__ (self, key):
+            if (key not in self.index and not self.complete):
+                self.index.update(Parser.FileIndex.indexBlock(self.filename, self.blocks, float(key)))
+
             if (key not in self.index):
                 print(f"KeyError: FileIndex could not find key: {key} ({type(key)})")
                 return KeyError
@@ -201,6 +214,9 @@ class Parser:
 
         # for iteration
         def __iter__ (self):
+            if (not self.complete):
+                self.index = Parser.FileIndex.indexFile(self.filename)
+                self.complete = True
             return iter(self.index)
 
         # for iteration
@@ -234,6 +250,58 @@ class Parser:
 
             return result
 
+        # read the sidecar index of a log (see utilities/time_index.hpp)
+        # args:
+        #     filename: name of the log
+        # return:
+        #     times and file positions of the blocks, None if there is no index
+        @staticmethod
+        def readBlocks (filename):
+            try:
+                with open(filename + ".idx", "rb") as f:
+                    data = f.read()
+            except OSError:
+                return None
+            if (data[:8] != b"TPSIDX01"):
+                return None
+            entries = list(struct.iter_unpack("=dQQ", data[8:8 + (len(data) - 8) // 24 * 24]))
+            return ([entry[0] for entry in entries], [entry[1] for entry in entries])
+
+        # index the important lines of the block holding a time
+        # args:
+        #     filename: name of the file to be indexed
+        #     blocks: sidecar index of the file
+        #     time: time to look for
+        # return:
+        #     dictionary of times and positions in the file for the block
+        @staticmethod
+        def indexBlock (filename, blocks, time):
+            result = {}
+            times, positions = blocks
+            block = bisect.bisect_right(times, time) - 1
+            if (block < 0):
+                return result
+            end = positions[block + 1] if (block + 1 < len(positions)) else None
+            with open(filename, "r") as f:
+                f.seek(positions[block], 0)
+                line = "_"
+                time = -1
+                while (line and (end is None or f.tell() < end)):
+                    position = f.tell()
+                    line = f.readline()
+
+                    try:
+                        float(line)
+                        time = line.rstrip("\n")
+                        continue
+                    except ValueError:
+                        pass
+
+                    if (line.find("subV") >= 0):
+                        result[time] = position
+
+            return result
+
     # --------------------------------------------------
     # Parse information related to Cadmium's message log
     # --------------------------------------------------
@@ -381,4 +449,66 @@ class Parser:
                     )
                 )
 
-            return result
\ No newline at end of file
+            return result
+
+    # ------------------------------------------
+    # Read binary event logs (see event_log.py)
+    # ------------------------------------------
+
+    class EventLogParser:
+
+        # the type of a group of events, in order of precedence (same as UnifiedParser)
+        eventTypes = [("ri", "impulse"), ("load", "loading"), ("rest", "restitution"), ("init", "initialization")]
+
+        def __init__ (self):
+            print("WARNING: treat EventLogParser class as static")
+            raise Exception
+
+        @staticmethod
+        def isEventLog (filename):
+            with open(filename, "rb") as f:
+                return f.read(8) == b"TPSEVL01"
+
+        # parse log into the same format as UnifiedParser (one entry per bag of logging messages)
+        # args:
+        #     filename: name of the event log
+        # return:
+        #     dictionary of labelled times and events
+        @staticmethod
+        def parseLog (filename):
+            sys.path.append(str(Path(__file__).resolve().parent.parent))  # event_log.py is in the repository root
+            import event_log
+
+            log = event_log.read_event_log(filename)
+            times = log["time"].tolist()
+            bags = log["event"].tolist()
+            subV_ids = log["subV_id"].tolist()
+            p_ids = log["p_id"].tolist()
+            positions = log["position"].tolist()
+            velocities = log["velocity"].tolist()
+            purposes = [event_log.PURPOSES[x] for x in log["purpose"].tolist()]
+
+            result = {}
+            prevTime = None
+            timeTag = 0  # label for duplicates
+            start = 0
+            while (start < len(times)):
+                end = start
+                while (end < len(times) and bags[end] == bags[start]):
+                    end += 1
+
+                time = f"{times[start]:g}"
+                if (time != prevTime):
+                    prevTime = time
+                    timeTag = 0
+
+                eventType = next((label for purpose, label in Parser.EventLogParser.eventTypes if purpose in purposes[start:end]), None)
+                if (eventType is not None):
+                    result[time + f" ({timeTag})"] = {
+                        "type" : eventType,
+                        "snapshots" : [Snapshot(subV_id=subV_ids[i], p_id=p_ids[i], pos=positions[i], vel=velocities[i]) for i in range(start, end)]
+                    }
+                    timeTag += 1
+                start = end
+
+            return result